@@ -25,6 +25,16 @@ lib.add_order.argtypes = [ctypes.c_int, ctypes.c_double, ctypes.c_double, ctypes
 lib.get_orders_log.argtypes = []
 lib.get_orders_log.restype = ctypes.c_char_p
 lib.reset_system.argtypes = []
+lib.connect_order_daemon.argtypes = [ctypes.c_char_p]
+lib.daemon_add_order.argtypes = [ctypes.c_int, ctypes.c_double, ctypes.c_double, ctypes.c_bool]
+lib.daemon_add_order.restype = ctypes.c_char_p
+lib.get_daemon_status.argtypes = []
+
+# With LOGISTICS_DAEMON=/path/to/socket every worker process shares the order
+# book of one order_daemon instead of keeping its own
+_daemon_socket = os.environ.get("LOGISTICS_DAEMON")
+if _daemon_socket and lib.connect_order_daemon(_daemon_socket.encode()) != 0:
+    print(f"order daemon not reachable at {_daemon_socket}; retrying per request", file=sys.stderr)
 
 
 @app.route("/")
@@ -43,10 +53,19 @@ def process_order():
     order_id = random.randint(1000, 9999)
 
     # Call C++ Logic
-    lib.reset_system()
-    lib.add_order(order_id, weight, distance, urgent)
-
-    raw_bytes = lib.get_orders_log()
+    if _daemon_socket:
+        raw_bytes = lib.daemon_add_order(order_id, weight, distance, urgent)
+        status = lib.get_daemon_status()
+        # The daemon sheds load rather than queueing it; pass that on fast
+        if raw_bytes is None and status == -2:
+            return jsonify({"error": "over capacity"}), 503
+        if raw_bytes is None and status == -3:
+            return jsonify({"error": "rate limited"}), 429
+        raw_bytes = raw_bytes or b"Order daemon unavailable"
+    else:
+        lib.reset_system()
+        lib.add_order(order_id, weight, distance, urgent)
+        raw_bytes = lib.get_orders_log()
     log_str = raw_bytes.decode("utf-8").strip()
 
     # Parse Result
@@ -0,0 +1,116 @@
+// Throughput of the branching factory path against the branchless table kernel
+// on a mixed order stream. Built as a single translation unit with the library:
+//   g++ -std=c++17 -O3 -march=native bench/classify_bench.cpp -o classify_bench
+
+#include "../order_logic.cpp"
+
+#include <chrono>
+#include <random>
+
+namespace
+{
+  struct Orders
+  {
+    vector<int> ids;
+    vector<double> weights;
+    vector<double> distances;
+    vector<char> urgent;
+  };
+
+  // Roughly 70% truck, 20% ship and 10% air, with thresholds well populated
+  Orders make_orders(size_t n)
+  {
+    mt19937_64 rng(42);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    lognormal_distribution<double> parcel(2.5, 1.2);
+    Orders o;
+    for (size_t i = 0; i < n; ++i)
+    {
+      double pick = unit(rng);
+      double weight = parcel(rng);
+      double distance = 50.0 + unit(rng) * 1900.0;
+      if (pick < 0.10)
+        weight = unit(rng) * 20.0, distance = 500.0 + unit(rng) * 1500.0;
+      else if (pick < 0.20)
+        distance = 2000.0 + unit(rng) * 8000.0;
+      else if (pick < 0.30)
+        weight = 1000.0 * (0.9 + unit(rng) * 0.2);
+      o.ids.push_back(static_cast<int>(i));
+      o.weights.push_back(weight);
+      o.distances.push_back(distance);
+      o.urgent.push_back(unit(rng) < 0.3);
+    }
+    return o;
+  }
+
+  template <class F>
+  double best_seconds(int runs, F &&f)
+  {
+    double best = 1e30;
+    for (int r = 0; r < runs; ++r)
+    {
+      auto t0 = chrono::steady_clock::now();
+      f();
+      best = min(best, chrono::duration<double>(chrono::steady_clock::now() - t0).count());
+    }
+    return best;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 4000000;
+  Orders o = make_orders(n);
+  const bool *urgent = reinterpret_cast<const bool *>(o.urgent.data());
+
+  // Branching: factory decision, virtual ETA and packing per order
+  vector<uint32_t> branching(n);
+  double t_factory = best_seconds(3, [&]
+  {
+    for (size_t i = 0; i < n; ++i)
+    {
+      OrderDetails d{o.ids[i], o.weights[i], o.distances[i], urgent[i]};
+      branching[i] = PackedOrder::pack(d, *TransportFactory::create_transport(d)).meta;
+    }
+  });
+
+  // Branchless: quantize into columns and classify through the outcome table
+  OrderManager manager;
+  double t_batch = best_seconds(3, [&]
+  {
+    manager.clear();
+    manager.process_batch(o.ids.data(), o.weights.data(), o.distances.data(), urgent, n);
+  });
+
+  // Kernel alone over columns that are already quantized
+  vector<int32_t> w(n), d(n);
+  vector<uint32_t> input(n), meta(n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    PackedOrder r = manager.record(i);
+    w[i] = r.weight_g;
+    d[i] = r.distance_dam;
+    input[i] = r.meta & ((1u << PackedOrder::URGENT_BIT) | (1u << PackedOrder::WEIGHT_FRAC_BIT) |
+                         (1u << PackedOrder::DISTANCE_FRAC_BIT) | (1023u << PackedOrder::ROUTE_SHIFT));
+  }
+  double t_kernel = best_seconds(5, [&]
+  {
+    meta = input;
+    classify_columns(w.data(), d.data(), meta.data(), n);
+  });
+
+  size_t mismatches = 0, kinds[3] = {0, 0, 0};
+  for (size_t i = 0; i < n; ++i)
+  {
+    mismatches += manager.record(i).meta != branching[i] || meta[i] != branching[i];
+    ++kinds[static_cast<int>(manager.record(i).kind())];
+  }
+
+  printf("orders: %zu (truck %.1f%%, ship %.1f%%, air %.1f%%)\n", n, 100.0 * kinds[0] / n, 100.0 * kinds[1] / n,
+         100.0 * kinds[2] / n);
+  printf("factory (branching)   %8.1f M orders/s\n", n / t_factory / 1e6);
+  printf("batch ingest (table)  %8.1f M orders/s\n", n / t_batch / 1e6);
+  printf("kernel only (table)   %8.1f M orders/s\n", n / t_kernel / 1e6);
+  printf("mismatches: %zu\n", mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
@@ -1,10 +1,52 @@
 // Instead of using JavaScript, we will implement the order management system in C++. Therefore we won't use the main function, because we will use Python to call the C++ code, and we will wrap the logic in an extern "C" function so that Python can call it. To make this scalable, we move the decision logic (Truck vs. Ship vs. Air) out of the OrderManager and into a dedicated TransportFactory.
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <random>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
-#include <sstream>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define LOGISTICS_IO_URING 1
+#endif
 
 // Use a simplified namespace scope to keep code clean
 using namespace std;
@@ -19,6 +61,60 @@ namespace Config
   constexpr double SHIP_MIN_DIST = 2000.0;
   constexpr double SHIP_MAX_WEIGHT = 1000.0;
   constexpr double TRUCK_HEAVY_THRESHOLD = 200.0;
+
+  // Range covered by the business-day calendar
+  constexpr int CALENDAR_FIRST_YEAR = 2000;
+  constexpr int CALENDAR_LAST_YEAR = 2099;
+
+  // Fixed-point resolution of stored orders: grams and 10-meter steps
+  constexpr double WEIGHT_SCALE = 1000.0;
+  constexpr double DISTANCE_SCALE = 100.0;
+
+  // Rows per columnar segment of the order store
+  constexpr size_t SEGMENT_ROWS = size_t{1} << 16;
+
+  // Retention: with an age limit, segments are sealed every 1/16 of it so
+  // expiry drops whole segments; a couple of dropped segments are recycled
+  constexpr int64_t RETENTION_BUCKETS = 16;
+  constexpr size_t SPARE_SEGMENTS = 2;
+
+  // Streaming aggregation: one-minute tumbling windows, two hours kept
+  constexpr int64_t WINDOW_MS = 60 * 1000;
+  constexpr size_t WINDOW_COUNT = 120;
+
+  // Quantile sketch accuracy (roughly 1.7/k rank error) for history and per window
+  constexpr uint16_t SKETCH_K = 200;
+  constexpr uint16_t WINDOW_SKETCH_K = 64;
+
+  // Distinct counts: 2^12 HyperLogLog registers (~1.6% error), daily sketches for a week
+  constexpr int HLL_PRECISION = 12;
+  constexpr int64_t DAY_MS = 24 * 60 * 60 * 1000;
+  constexpr size_t DISTINCT_DAYS = 7;
+
+  // Entries kept per top-K list
+  constexpr size_t TOP_K = 100;
+
+  // Journal: registered 1 MB buffers written in ring order; the fallback
+  // backend uses a small pool of writer threads
+  constexpr size_t JOURNAL_BUFFER_BYTES = size_t{1} << 20;
+  constexpr size_t JOURNAL_BUFFERS = 8;
+  constexpr unsigned JOURNAL_THREADS = 2;
+
+  // HTTP service limits per request, and output queued per connection
+  // before pipelined requests wait for the client to read
+  constexpr size_t HTTP_MAX_HEADER_BYTES = 8192;
+  constexpr size_t HTTP_MAX_BODY_BYTES = 65536;
+  constexpr size_t HTTP_MAX_PENDING_OUTPUT = size_t{1} << 20;
+
+  // Daemon responses queued per connection before it stops reading
+  // requests, and the most orders of one run admitted together
+  constexpr size_t DAEMON_MAX_PENDING_OUTPUT = size_t{1} << 20;
+  constexpr size_t DAEMON_MAX_BATCH = 1024;
+
+  // Orders the serving layers hold admitted but unclassified before they
+  // shed load, and the client buckets kept before idle ones are dropped
+  constexpr int64_t ADMISSION_MAX_QUEUED = 65536;
+  constexpr size_t ADMISSION_MAX_CLIENTS = 4096;
 }
 
 struct OrderDetails
@@ -27,6 +123,351 @@ struct OrderDetails
   double weight_kg;
   double distance_km;
   bool urgent;
+  uint64_t customer_id = 0;    // 0 = unknown
+  uint64_t destination_id = 0; // 0 = unknown; distinct routes are counted by destination
+};
+
+// ==========================================
+// Business Calendar 📅
+// ==========================================
+
+// Dates are handled as day numbers since 1970-01-01 (proleptic Gregorian).
+struct CivilDate
+{
+  int year;
+  unsigned month;
+  unsigned day;
+};
+
+inline int days_from_civil(int y, unsigned m, unsigned d)
+{
+  y -= m <= 2;
+  const int era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<int>(doe) - 719468;
+}
+
+inline bool is_leap_year(int y) { return y % 4 == 0 && (y % 100 != 0 || y % 400 == 0); }
+
+// True for a real calendar date; days_from_civil() would roll 02-30 into March
+inline bool valid_civil(int y, unsigned m, unsigned d)
+{
+  static const unsigned month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  return m >= 1 && m <= 12 && d >= 1 && d <= month_days[m - 1] + (m == 2 && is_leap_year(y));
+}
+
+inline CivilDate civil_from_days(int z)
+{
+  z += 719468;
+  const int era = (z >= 0 ? z : z - 146096) / 146097;
+  const unsigned doe = static_cast<unsigned>(z - era * 146097);
+  const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+  const unsigned d = doy - (153 * mp + 2) / 5 + 1;
+  const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+  return {static_cast<int>(yoe) + era * 400 + (m <= 2), m, d};
+}
+
+inline string format_date(int day)
+{
+  CivilDate c = civil_from_days(day);
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%04d-%02u-%02u", c.year, c.month, c.day);
+  return buf;
+}
+
+// Weekends plus per-region holidays. Each region keeps a holiday bitset and
+// prefix counts of business days, so adding N business days is two lookups.
+class BusinessCalendar
+{
+  struct Region
+  {
+    string name;
+    vector<uint64_t> holidays;     // one bit per day since first_day_
+    vector<uint32_t> rank;         // business days strictly before each day
+    vector<int32_t> business_days; // day number of the k-th business day
+  };
+
+  int first_day_;
+  int span_;
+  vector<Region> regions_;
+
+  bool is_weekend(int day) const
+  {
+    int weekday = (day + 4) % 7; // 1970-01-01 was a Thursday, Sunday = 0
+    return weekday == 0 || weekday == 6;
+  }
+
+  void build(Region &region) const
+  {
+    region.holidays.resize((span_ + 63) / 64, 0);
+    region.rank.assign(span_ + 1, 0);
+    region.business_days.clear();
+    for (int i = 0; i < span_; ++i)
+    {
+      region.rank[i] = static_cast<uint32_t>(region.business_days.size());
+      bool holiday = (region.holidays[i / 64] >> (i % 64)) & 1;
+      if (!holiday && !is_weekend(first_day_ + i))
+        region.business_days.push_back(first_day_ + i);
+    }
+    region.rank[span_] = static_cast<uint32_t>(region.business_days.size());
+  }
+
+public:
+  BusinessCalendar()
+      : first_day_(days_from_civil(Config::CALENDAR_FIRST_YEAR, 1, 1)),
+        span_(days_from_civil(Config::CALENDAR_LAST_YEAR + 1, 1, 1) - first_day_)
+  {
+    regions_.push_back({"", {}, {}, {}});
+    build(regions_[0]);
+  }
+
+  // Loads "REGION YYYY-MM-DD" lines ('#' starts a comment) and replaces every
+  // previously loaded region. Returns the number of holidays, or -1 if the
+  // file cannot be read.
+  int load(const string &path)
+  {
+    ifstream in(path);
+    if (!in)
+      return -1;
+
+    regions_.resize(1);
+    int loaded = 0;
+    string line;
+    while (getline(in, line))
+    {
+      line = line.substr(0, line.find('#'));
+      char name[64];
+      int y;
+      unsigned m, d;
+      if (sscanf(line.c_str(), "%63s %d-%u-%u", name, &y, &m, &d) != 4 || !valid_civil(y, m, d))
+        continue;
+
+      int offset = days_from_civil(y, m, d) - first_day_;
+      if (offset < 0 || offset >= span_)
+        continue;
+
+      int idx = region_index(name);
+      if (idx <= 0)
+      {
+        regions_.push_back({name, vector<uint64_t>((span_ + 63) / 64, 0), {}, {}});
+        idx = static_cast<int>(regions_.size()) - 1;
+      }
+      regions_[idx].holidays[offset / 64] |= uint64_t{1} << (offset % 64);
+      ++loaded;
+    }
+
+    for (size_t i = 1; i < regions_.size(); ++i)
+      build(regions_[i]);
+    return loaded;
+  }
+
+  // 0 is the weekends-only default region, -1 means unknown
+  int region_index(const string &name) const
+  {
+    if (name.empty())
+      return 0;
+    for (size_t i = 1; i < regions_.size(); ++i)
+      if (regions_[i].name == name)
+        return static_cast<int>(i);
+    return -1;
+  }
+
+  bool contains(int day) const { return day >= first_day_ && day < first_day_ + span_; }
+
+  // Day number of the n-th business day after `day`, or -1 outside the calendar
+  int add_business_days(int region, int day, int n) const
+  {
+    if (region < 0 || region >= static_cast<int>(regions_.size()) || !contains(day))
+      return -1;
+    if (n <= 0)
+      return day;
+
+    const Region &r = regions_[region];
+    size_t k = static_cast<size_t>(r.rank[day - first_day_ + 1]) + static_cast<size_t>(n) - 1;
+    return k < r.business_days.size() ? r.business_days[k] : -1;
+  }
+};
+
+// ==========================================
+// Packed Order Records 📦
+// ==========================================
+
+enum class TransportKind : uint8_t
+{
+  Truck = 0,
+  Ship = 1,
+  Air = 2
+};
+
+class ITransport;
+
+// A stored order in 16 bytes: id, fixed-point weight and distance, and the
+// transport decision packed into one word. Unpacking rebuilds a transport
+// whose info() and ETA match the original for every route within +-1023
+// minutes (any truck distance above -52650 km); longer routes saturate.
+// Weight and distance keep their fixed-point grid, not the input doubles.
+struct PackedOrder
+{
+  int32_t id;
+  int32_t weight_g;
+  int32_t distance_dam;
+  uint32_t meta;
+
+  // meta layout; bit 31 is spare
+  static constexpr int KIND_SHIFT = 0; // 2 bits
+  static constexpr int URGENT_BIT = 2;
+  static constexpr int HEAVY_BIT = 3;
+  static constexpr int RESERVED_BIT = 4;
+  static constexpr int EXPRESS_BIT = 5;
+  static constexpr int CLEARANCE_SHIFT = 6; // 4 bits
+  static constexpr int ETA_SHIFT = 10;      // 8 bits
+  static constexpr int ROUTE_SHIFT = 18;    // 10 bits, whole minutes
+  static constexpr int WEIGHT_FRAC_BIT = 28;
+  static constexpr int DISTANCE_FRAC_BIT = 29;
+  static constexpr int ROUTE_NEGATIVE_BIT = 30; // route field holds the magnitude
+
+  // Rounding rule of the compact numeric mode: values are floored onto the
+  // fixed-point grid and `frac` records a dropped remainder, so ceil = q + frac.
+  // Every Config threshold T lies on the grid at Tq, hence "v < T" is exactly
+  // "q < Tq" and "v > T" is exactly "q + frac > Tq". The fix-ups below keep
+  // that true where the product v * scale rounds onto a threshold.
+  static int32_t quantize(double value, double scale, initializer_list<double> thresholds, bool &frac)
+  {
+    double scaled = floor(value * scale);
+    frac = value * scale != scaled;
+    if (!(scaled < 2147483646.0)) // saturate, leaving room for q + frac; NaN lands here too
+      scaled = 2147483646.0, frac = false;
+    if (scaled < -2147483647.0)
+      scaled = -2147483647.0, frac = false;
+    int32_t q = static_cast<int32_t>(scaled);
+
+    for (double t : thresholds)
+    {
+      int32_t tq = static_cast<int32_t>(t * scale);
+      if (value < t && q >= tq)
+        q = tq - 1, frac = true;
+      else if (value > t && q == tq)
+        frac = true;
+    }
+    return q;
+  }
+
+  static int32_t quantize_weight(double kg, bool &frac)
+  {
+    return quantize(kg, Config::WEIGHT_SCALE,
+                    {Config::AIR_MAX_WEIGHT, Config::SHIP_MAX_WEIGHT, Config::TRUCK_HEAVY_THRESHOLD}, frac);
+  }
+
+  static int32_t quantize_distance(double km, bool &frac)
+  {
+    return quantize(km, Config::DISTANCE_SCALE, {Config::AIR_MIN_DIST, Config::SHIP_MIN_DIST}, frac);
+  }
+
+  // Saturates `value` into a `bits`-wide field
+  static uint32_t field(int value, int bits, int shift)
+  {
+    int max = (1 << bits) - 1;
+    return static_cast<uint32_t>(value < 0 ? 0 : (value > max ? max : value)) << shift;
+  }
+
+  // Truck route minutes as stored: truncated, signed, saturated at 1023;
+  // NaN stores as 0
+  static uint32_t route_field(double minutes)
+  {
+    double magnitude = min(fabs(minutes), 1023.0);
+    if (!(magnitude >= 0))
+      return 0;
+    return field(static_cast<int>(magnitude), 10, ROUTE_SHIFT) | field(minutes <= -1, 1, ROUTE_NEGATIVE_BIT);
+  }
+
+  uint32_t get(int bits, int shift) const { return (meta >> shift) & ((1u << bits) - 1); }
+  bool flag(int bit) const { return (meta >> bit) & 1; }
+
+  TransportKind kind() const { return static_cast<TransportKind>(get(2, KIND_SHIFT)); }
+  bool urgent() const { return flag(URGENT_BIT); }
+  bool heavy() const { return flag(HEAVY_BIT); }
+  bool reserved() const { return flag(RESERVED_BIT); }
+  bool express() const { return flag(EXPRESS_BIT); }
+  int clearance_days() const { return static_cast<int>(get(4, CLEARANCE_SHIFT)); }
+  // Truck days follow from the signed route and the load, as in
+  // TruckTransport, so routes under -60 minutes keep their negative days;
+  // the unsigned ETA field holds them clamped at 0 and serves the classifier
+  int eta_days() const
+  {
+    if (kind() == TransportKind::Truck)
+      return 1 + route_minutes() / 60 + (heavy() ? 1 : 0);
+    return static_cast<int>(get(8, ETA_SHIFT));
+  }
+  int route_minutes() const
+  {
+    int minutes = static_cast<int>(get(10, ROUTE_SHIFT));
+    return flag(ROUTE_NEGATIVE_BIT) ? -minutes : minutes;
+  }
+  double weight_kg() const { return weight_g / Config::WEIGHT_SCALE; }
+  double distance_km() const { return distance_dam / Config::DISTANCE_SCALE; }
+
+  static PackedOrder pack(const OrderDetails &order, const ITransport &transport);
+  unique_ptr<ITransport> unpack() const;
+};
+static_assert(sizeof(PackedOrder) == 16, "PackedOrder must stay at 16 bytes");
+
+// ==========================================
+// Presentation Tables 🏷️
+// ==========================================
+
+// Fixed texts are string literals, so they can be handed to C callers as-is.
+namespace Text
+{
+  constexpr string_view KIND_NAMES[] = {"Truck", "Ship", "Air"};
+  constexpr string_view SHIP_INFO[] = {"Ship (Reserved: No)", "Ship (Reserved: Yes)"};
+  constexpr string_view AIR_INFO[] = {"Air (Express: No)", "Air (Express: Yes)"};
+  constexpr string_view AIR_ETA[] = {"Air: 2 days", "Air: 1 day (Express)"};
+}
+
+// Stack buffer for the numeric parts of a line; never allocates and
+// silently truncates past its capacity.
+class TextBuffer
+{
+  char data_[128];
+  size_t len_ = 0;
+
+public:
+  TextBuffer &append(string_view text)
+  {
+    size_t n = min(text.size(), sizeof(data_) - 1 - len_);
+    memcpy(data_ + len_, text.data(), n);
+    len_ += n;
+    data_[len_] = '\0';
+    return *this;
+  }
+
+  TextBuffer &append(int value, int min_digits = 1)
+  {
+    char digits[16];
+    auto res = to_chars(digits, digits + sizeof(digits), value);
+    for (int pad = min_digits - static_cast<int>(res.ptr - digits); pad > 0; --pad)
+      append("0");
+    return append(string_view(digits, static_cast<size_t>(res.ptr - digits)));
+  }
+
+  TextBuffer &append_date(int day)
+  {
+    CivilDate c = civil_from_days(day);
+    append(c.year, 4).append("-").append(static_cast<int>(c.month), 2);
+    return append("-").append(static_cast<int>(c.day), 2);
+  }
+
+  void clear()
+  {
+    len_ = 0;
+    data_[0] = '\0';
+  }
+  const char *c_str() const { return data_; }
+  string_view view() const { return {data_, len_}; }
 };
 
 // ==========================================
@@ -37,8 +478,19 @@ class ITransport
 {
 public:
   virtual ~ITransport() = default;
+  virtual int transit_days() const = 0;
   virtual string calculate_delivery_time() const = 0;
   virtual string info() const = 0;
+  // Writes the kind and transport-specific fields into a packed record
+  virtual void pack(PackedOrder &record) const = 0;
+
+  // ETA with transit days counted as business days from the dispatch date
+  string calculate_delivery_time(const BusinessCalendar &calendar, int region, int dispatch_day) const
+  {
+    int due = calendar.add_business_days(region, dispatch_day, transit_days());
+    string eta = calculate_delivery_time();
+    return due < 0 ? eta : eta + ", due " + format_date(due);
+  }
 };
 
 class TruckTransport : public ITransport
@@ -50,17 +502,35 @@ public:
   TruckTransport(double minutes, bool heavy)
       : route_minutes_(minutes), heavy_load_(heavy) {}
 
-  string calculate_delivery_time() const override
+  // Whole minutes, saturating; NaN counts as 0
+  int whole_minutes() const
+  {
+    return route_minutes_ == route_minutes_ ? static_cast<int>(clamp(route_minutes_, -1e9, 1e9)) : 0;
+  }
+
+  int transit_days() const override
   {
-    int days = 1 + static_cast<int>(route_minutes_ / 60);
+    int days = 1 + whole_minutes() / 60;
     if (heavy_load_)
       days += 1;
-    return "Truck: " + to_string(days) + " days";
+    return days;
+  }
+
+  string calculate_delivery_time() const override
+  {
+    return "Truck: " + to_string(transit_days()) + " days";
   }
 
   string info() const override
   {
-    return "Truck (Route: " + to_string(static_cast<int>(route_minutes_)) + "m)";
+    return "Truck (Route: " + to_string(whole_minutes()) + "m)";
+  }
+
+  void pack(PackedOrder &record) const override
+  {
+    record.meta |= PackedOrder::field(static_cast<int>(TransportKind::Truck), 2, PackedOrder::KIND_SHIFT) |
+                   PackedOrder::field(heavy_load_, 1, PackedOrder::HEAVY_BIT) |
+                   PackedOrder::route_field(route_minutes_);
   }
 };
 
@@ -73,17 +543,29 @@ public:
   ShipTransport(bool reserved, int clearance)
       : reserved_(reserved), clearance_days_(clearance) {}
 
-  string calculate_delivery_time() const override
+  int transit_days() const override
   {
     int days = 10 + clearance_days_;
     if (!reserved_)
       days += 3;
-    return "Ship: " + to_string(days) + " days";
+    return days;
+  }
+
+  string calculate_delivery_time() const override
+  {
+    return "Ship: " + to_string(transit_days()) + " days";
   }
 
   string info() const override
   {
-    return "Ship (Reserved: " + string(reserved_ ? "Yes" : "No") + ")";
+    return string(Text::SHIP_INFO[reserved_]);
+  }
+
+  void pack(PackedOrder &record) const override
+  {
+    record.meta |= PackedOrder::field(static_cast<int>(TransportKind::Ship), 2, PackedOrder::KIND_SHIFT) |
+                   PackedOrder::field(reserved_, 1, PackedOrder::RESERVED_BIT) |
+                   PackedOrder::field(clearance_days_, 4, PackedOrder::CLEARANCE_SHIFT);
   }
 };
 
@@ -94,17 +576,76 @@ class AirTransport : public ITransport
 public:
   explicit AirTransport(bool express) : express_(express) {}
 
+  int transit_days() const override { return express_ ? 1 : 2; }
+
   string calculate_delivery_time() const override
   {
-    return express_ ? "Air: 1 day (Express)" : "Air: 2 days";
+    return string(Text::AIR_ETA[express_]);
   }
 
   string info() const override
   {
-    return "Air (Express: " + string(express_ ? "Yes" : "No") + ")";
+    return string(Text::AIR_INFO[express_]);
+  }
+
+  void pack(PackedOrder &record) const override
+  {
+    record.meta |= PackedOrder::field(static_cast<int>(TransportKind::Air), 2, PackedOrder::KIND_SHIFT) |
+                   PackedOrder::field(express_, 1, PackedOrder::EXPRESS_BIT);
   }
 };
 
+inline PackedOrder PackedOrder::pack(const OrderDetails &order, const ITransport &transport)
+{
+  bool weight_frac, distance_frac;
+  PackedOrder record{order.id,
+                     quantize_weight(order.weight_kg, weight_frac),
+                     quantize_distance(order.distance_km, distance_frac),
+                     field(order.urgent, 1, URGENT_BIT)};
+  record.meta |= field(weight_frac, 1, WEIGHT_FRAC_BIT) | field(distance_frac, 1, DISTANCE_FRAC_BIT);
+  transport.pack(record);
+  record.meta |= field(transport.transit_days(), 8, ETA_SHIFT);
+  return record;
+}
+
+inline unique_ptr<ITransport> PackedOrder::unpack() const
+{
+  switch (kind())
+  {
+  case TransportKind::Ship:
+    return make_unique<ShipTransport>(reserved(), clearance_days());
+  case TransportKind::Air:
+    return make_unique<AirTransport>(express());
+  default:
+    return make_unique<TruckTransport>(route_minutes(), heavy());
+  }
+}
+
+// Record texts without building a transport. Fixed variants return a table
+// entry; numeric ones are formatted into `buf`.
+inline string_view format_info(const PackedOrder &r, TextBuffer &buf)
+{
+  switch (r.kind())
+  {
+  case TransportKind::Ship:
+    return Text::SHIP_INFO[r.reserved()];
+  case TransportKind::Air:
+    return Text::AIR_INFO[r.express()];
+  default:
+    buf.clear();
+    return buf.append("Truck (Route: ").append(r.route_minutes()).append("m)").view();
+  }
+}
+
+inline string_view format_eta(const PackedOrder &r, TextBuffer &buf)
+{
+  if (r.kind() == TransportKind::Air)
+    return Text::AIR_ETA[r.express()];
+  buf.clear();
+  buf.append(Text::KIND_NAMES[static_cast<int>(r.kind())]).append(": ").append(r.eta_days()).append(" days");
+  return buf.view();
+}
+
 // ==========================================
 // Transport Factory (The Scalable Part) later, we only change the Factory, not the entire Manager.
 // ==========================================
@@ -127,79 +668,7182 @@ public:
     }
 
     // Rule 3: Truck Transport (Default)
+    double base_mins = route_minutes(order);
+    bool is_heavy = order.weight_kg > Config::TRUCK_HEAVY_THRESHOLD;
+    return make_unique<TruckTransport>(base_mins, is_heavy);
+  }
+
+  static double route_minutes(const OrderDetails &order)
+  {
     double base_mins = 30.0 + (order.distance_km / 50.0);
     if (order.urgent)
       base_mins *= 0.8;
-
-    bool is_heavy = order.weight_kg > Config::TRUCK_HEAVY_THRESHOLD;
-    return make_unique<TruckTransport>(base_mins, is_heavy);
+    return base_mins;
   }
 };
 
 // ==========================================
-// Order Manager
+// Column Codecs 🗜️
 // ==========================================
 
-class OrderManager
+// Light encodings for the 32-bit columns of order files, decision frames and
+// order frames.
+// An encoded column is a 24-byte header and a payload padded to 8 bytes; the
+// encoder keeps whichever of these is smallest:
+//   RAW    plain values
+//   FOR    frame of reference: value - minimum, bit-packed (weights, distances)
+//   DELTA  frame of reference over successive differences (sequential ids)
+//   RLE    (value, run length) pairs (transport kind, sorted files)
+// Packed values are read with one unaligned 64-bit load, a shift and a mask,
+// without branches, so the decode loops vectorize.
+struct ColumnHeader
+{
+  uint8_t codec;
+  uint8_t width; // bits per packed value
+  uint16_t reserved;
+  uint32_t count; // values, or runs for RLE
+  int32_t base;   // FOR minimum, or first value for DELTA
+  int32_t step;   // smallest difference for DELTA
+  uint32_t length; // payload bytes
+  uint32_t pad;
+};
+static_assert(sizeof(ColumnHeader) == 24, "column header is 24 bytes");
+
+namespace Codec
 {
-  struct Record
+  constexpr uint8_t RAW = 0;
+  constexpr uint8_t FOR = 1;
+  constexpr uint8_t DELTA = 2;
+  constexpr uint8_t RLE = 3;
+
+  // Packed payloads carry 8 bytes of slack for the final 64-bit load
+  inline size_t packed_bytes(size_t n, int width) { return width ? (n * static_cast<size_t>(width) + 7) / 8 + 8 : 0; }
+
+  inline int width_of(uint64_t range) { return range ? 64 - __builtin_clzll(range) : 0; }
+
+  inline void pack(char *out, const uint32_t *values, size_t n, int width)
   {
-    int id;
-    unique_ptr<ITransport> transport;
-  };
-  vector<Record> records_;
+    if (!width)
+      return;
+    for (size_t i = 0; i < n; ++i)
+    {
+      size_t bit = i * static_cast<size_t>(width);
+      uint64_t word;
+      memcpy(&word, out + bit / 8, 8);
+      word |= static_cast<uint64_t>(values[i]) << (bit & 7);
+      memcpy(out + bit / 8, &word, 8);
+    }
+  }
 
-public:
-  void process(const OrderDetails &details)
+  inline void unpack(const char *in, uint32_t *values, size_t n, int width)
   {
-    auto transport = TransportFactory::create_transport(details);
-    records_.push_back({details.id, std::move(transport)});
+    uint64_t mask = (uint64_t{1} << width) - 1;
+    if (!width)
+    {
+      fill(values, values + n, 0u);
+      return;
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+      size_t bit = i * static_cast<size_t>(width);
+      uint64_t word;
+      memcpy(&word, in + bit / 8, 8);
+      values[i] = static_cast<uint32_t>((word >> (bit & 7)) & mask);
+    }
   }
+}
 
-  // Generates a summary string for Python to read
-  string get_summary() const
+// Appends the smallest encoding of n values
+inline void encode_column(string &out, const uint32_t *values, size_t n)
+{
+  ColumnHeader h{};
+  h.count = static_cast<uint32_t>(n);
+
+  int32_t lo = INT32_MAX, hi = INT32_MIN;
+  int64_t step_lo = INT64_MAX, step_hi = INT64_MIN;
+  size_t runs = n ? 1 : 0;
+  for (size_t i = 0; i < n; ++i)
   {
-    stringstream ss;
-    for (const auto &r : records_)
+    int32_t v = static_cast<int32_t>(values[i]);
+    lo = min(lo, v);
+    hi = max(hi, v);
+    if (i)
     {
-      ss << "[Order #" << r.id << "] "
-         << r.transport->info() << " -> ETA: "
-         << r.transport->calculate_delivery_time() << "\n";
+      int64_t d = static_cast<int64_t>(v) - static_cast<int32_t>(values[i - 1]);
+      step_lo = min(step_lo, d);
+      step_hi = max(step_hi, d);
+      runs += values[i] != values[i - 1];
     }
-    return ss.str();
   }
+  int for_width = n ? Codec::width_of(static_cast<uint64_t>(static_cast<int64_t>(hi) - lo)) : 0;
+  bool delta_ok = n > 1 && static_cast<uint64_t>(step_hi - step_lo) <= UINT32_MAX;
+  int delta_width = delta_ok ? Codec::width_of(static_cast<uint64_t>(step_hi - step_lo)) : 0;
 
-  void clear() { records_.clear(); }
-};
+  size_t raw = 4 * n;
+  size_t by_for = Codec::packed_bytes(n, for_width);
+  size_t by_delta = delta_ok ? Codec::packed_bytes(n - 1, delta_width) : SIZE_MAX;
+  size_t by_rle = 8 * runs;
+  size_t best = min({raw, by_for, by_delta, by_rle});
 
-// ==========================================
-// C Interface for Python (Extern C)
-// ==========================================
+  vector<uint32_t> scratch;
+  if (best == raw)
+    h.codec = Codec::RAW;
+  else if (best == by_for)
+  {
+    h.codec = Codec::FOR;
+    h.width = static_cast<uint8_t>(for_width);
+    h.base = lo;
+    scratch.resize(n);
+    for (size_t i = 0; i < n; ++i)
+      scratch[i] = values[i] - static_cast<uint32_t>(lo);
+  }
+  else if (best == by_delta)
+  {
+    h.codec = Codec::DELTA;
+    h.width = static_cast<uint8_t>(delta_width);
+    h.base = static_cast<int32_t>(values[0]);
+    h.step = static_cast<int32_t>(step_lo);
+    scratch.resize(n - 1);
+    for (size_t i = 1; i < n; ++i)
+      scratch[i - 1] = values[i] - values[i - 1] - static_cast<uint32_t>(h.step);
+  }
+  else
+  {
+    h.codec = Codec::RLE;
+    h.count = static_cast<uint32_t>(runs);
+    for (size_t i = 0; i < n; ++i)
+      if (i == 0 || values[i] != values[i - 1])
+        scratch.insert(scratch.end(), {values[i], 1});
+      else
+        ++scratch.back();
+  }
+  h.length = static_cast<uint32_t>(best);
 
-// Global instances to persist state between Python calls
-static OrderManager manager_instance;
-static string last_output_buffer;
+  size_t at = out.size();
+  out.resize(at + sizeof h + (best + 7) / 8 * 8, '\0');
+  memcpy(&out[at], &h, sizeof h);
+  char *payload = &out[at + sizeof h];
+  if (h.codec == Codec::RAW)
+    memcpy(payload, values, raw);
+  else if (h.codec == Codec::RLE)
+    memcpy(payload, scratch.data(), best);
+  else
+    Codec::pack(payload, scratch.data(), scratch.size(), h.width);
+}
 
-extern "C"
+// Bytes an encoded column takes, header included, or 0 if `h` is malformed
+inline size_t encoded_size(const ColumnHeader &h, size_t n)
 {
-  // Add an order to the system
-  void add_order(int id, double weight, double distance, bool urgent)
+  size_t expected;
+  switch (h.codec)
   {
-    OrderDetails d{id, weight, distance, urgent};
-    manager_instance.process(d);
+  case Codec::RAW: expected = 4 * n; break;
+  case Codec::FOR: expected = Codec::packed_bytes(n, h.width); break;
+  case Codec::DELTA: expected = n ? Codec::packed_bytes(n - 1, h.width) : SIZE_MAX; break;
+  case Codec::RLE:
+    // Each run covers at least one value, so a damaged count cannot ask for
+    // more payload than n values need
+    if (h.count > n || (h.count == 0 && n > 0))
+      return 0;
+    expected = 8 * size_t{h.count};
+    break;
+  default: return 0;
   }
+  if (h.width > 32 || h.length != expected || (h.codec != Codec::RLE && h.count != n))
+    return 0;
+  return sizeof h + (expected + 7) / 8 * 8;
+}
 
-  // Get the formatted log of all orders
-  const char *get_orders_log()
+// Decodes a column of n values from a payload checked with encoded_size;
+// false if RLE runs do not add up to n
+inline bool decode_column(const ColumnHeader &h, const char *payload, uint32_t *values, size_t n)
+{
+  switch (h.codec)
   {
-    last_output_buffer = manager_instance.get_summary();
-    return last_output_buffer.c_str();
+  case Codec::RAW:
+    memcpy(values, payload, 4 * n);
+    return true;
+  case Codec::FOR:
+    Codec::unpack(payload, values, n, h.width);
+    for (size_t i = 0; i < n; ++i)
+      values[i] += static_cast<uint32_t>(h.base);
+    return true;
+  case Codec::DELTA:
+  {
+    Codec::unpack(payload, values + 1, n - 1, h.width);
+    uint32_t v = static_cast<uint32_t>(h.base);
+    values[0] = v;
+    for (size_t i = 1; i < n; ++i)
+      values[i] = v += values[i] + static_cast<uint32_t>(h.step);
+    return true;
   }
+  default:
+  {
+    size_t at = 0;
+    for (uint32_t r = 0; r < h.count; ++r)
+    {
+      uint32_t run[2];
+      memcpy(run, payload + 8 * r, sizeof run);
+      if (run[1] > n - at)
+        return false;
+      fill(values + at, values + at + run[1], run[0]);
+      at += run[1];
+    }
+    return at == n;
+  }
+  }
+}
 
-  // Clear memory/reset Allows Python to clear the list without restarting the process.
-  void reset_system()
+// Encoded record blocks (order files, decision frames) store five columns:
+// id, weight, distance, the decision word without its transport kind, and
+// the kind on its own, which is a 2-bit FOR column or, once sorted, a handful
+// of RLE runs
+namespace Codec
+{
+  constexpr int RECORD_COLUMNS = 5;
+  constexpr uint32_t KIND_MASK = 3u << PackedOrder::KIND_SHIFT;
+}
+
+inline void encode_records(string &out, const int32_t *ids, const int32_t *weight_g, const int32_t *distance_dam,
+                           const uint32_t *meta, size_t n)
+{
+  static thread_local vector<uint32_t> rest, kind;
+  rest.resize(n);
+  kind.resize(n);
+  for (size_t i = 0; i < n; ++i)
   {
-    manager_instance.clear();
-    last_output_buffer.clear();
+    rest[i] = meta[i] & ~Codec::KIND_MASK;
+    kind[i] = (meta[i] & Codec::KIND_MASK) >> PackedOrder::KIND_SHIFT;
+  }
+  const uint32_t *columns[] = {reinterpret_cast<const uint32_t *>(ids), reinterpret_cast<const uint32_t *>(weight_g),
+                               reinterpret_cast<const uint32_t *>(distance_dam), rest.data(), kind.data()};
+  for (const uint32_t *column : columns)
+    encode_column(out, column, n);
+}
+
+// Folds the decoded kind column back into the decision words
+inline bool merge_kind(uint32_t *meta, const uint32_t *kind, size_t n)
+{
+  uint32_t bad = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    bad |= kind[i] >> 2 | (meta[i] & Codec::KIND_MASK);
+    meta[i] |= kind[i] << PackedOrder::KIND_SHIFT;
+  }
+  return !bad;
+}
+
+// ==========================================
+// Segment Files 💾
+// ==========================================
+
+// A sealed segment on disk: a 64-byte header, then the id, weight, distance
+// and meta columns, rows * 4 bytes each. Readers map the file and use the
+// columns in place. An order file (export, sort output) is a sequence of such
+// blocks, at most SEGMENT_ROWS rows each; there the columns may be stored
+// with the column codecs instead (encoding = ENCODED, see encode_records).
+// A checkpoint is an
+// order file whose headers carry the journal offset it covers.
+struct SegmentFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t rows;
+  uint32_t seq;
+  uint32_t encoding;
+  int64_t bucket;
+  int64_t last_ms;
+  int64_t journal_offset;
+  uint8_t pad[16];
+};
+static_assert(sizeof(SegmentFileHeader) == 64, "segment file header is 64 bytes");
+
+namespace SegmentFile
+{
+  constexpr char MAGIC[8] = {'O', 'R', 'D', 'S', 'E', 'G', '0', '1'};
+  constexpr uint32_t VERSION = 1;
+  constexpr int COLUMNS = 4;
+  constexpr uint32_t RAW = 0;
+  constexpr uint32_t ENCODED = 1;
+}
+
+// write() until everything is out; false on error
+inline bool write_all(int fd, const void *data, size_t length)
+{
+  const char *p = static_cast<const char *>(data);
+  while (length)
+  {
+    ssize_t n = ::write(fd, p, length);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    length -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// write_all for sockets: a peer that went away fails the call instead of
+// raising SIGPIPE in the caller's process
+inline bool send_all(int fd, const void *data, size_t length)
+{
+  const char *p = static_cast<const char *>(data);
+  while (length)
+  {
+    ssize_t n = ::send(fd, p, length, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    length -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// read() until `length` bytes arrived; returns the count, short only at EOF or on error
+inline size_t read_all(int fd, void *data, size_t length)
+{
+  char *p = static_cast<char *>(data);
+  size_t got = 0;
+  while (got < length)
+  {
+    ssize_t n = ::read(fd, p + got, length - got);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    got += static_cast<size_t>(n);
+  }
+  return got;
+}
+
+inline SegmentFileHeader segment_header(size_t rows, uint32_t seq, int64_t bucket = 0, int64_t last_ms = 0)
+{
+  SegmentFileHeader header{};
+  memcpy(header.magic, SegmentFile::MAGIC, sizeof header.magic);
+  header.version = SegmentFile::VERSION;
+  header.rows = static_cast<uint32_t>(rows);
+  header.seq = seq;
+  header.bucket = bucket;
+  header.last_ms = last_ms;
+  return header;
+}
+
+// Appends one block from four column arrays of header.rows values
+inline bool write_segment_block(int fd, const SegmentFileHeader &header, const void *const columns[])
+{
+  if (header.encoding == SegmentFile::ENCODED)
+  {
+    string block(reinterpret_cast<const char *>(&header), sizeof header);
+    encode_records(block, static_cast<const int32_t *>(columns[0]), static_cast<const int32_t *>(columns[1]),
+                   static_cast<const int32_t *>(columns[2]), static_cast<const uint32_t *>(columns[3]), header.rows);
+    return write_all(fd, block.data(), block.size());
+  }
+  bool ok = write_all(fd, &header, sizeof header);
+  for (int c = 0; ok && c < SegmentFile::COLUMNS; ++c)
+    ok = write_all(fd, columns[c], header.rows * sizeof(int32_t));
+  return ok;
+}
+
+inline bool write_segment_file(const string &path, const SegmentFileHeader &header, const void *const columns[])
+{
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0)
+    return false;
+  bool ok = write_segment_block(fd, header, columns);
+  return ::close(fd) == 0 && ok;
+}
+
+// Column buffers for one block of an order file
+struct OrderBlock
+{
+  SegmentFileHeader header{};
+  vector<int32_t> ids;
+  vector<int32_t> weight_g;
+  vector<int32_t> distance_dam;
+  vector<uint32_t> meta;
+
+  size_t size() const { return ids.size(); }
+
+  void resize(size_t n)
+  {
+    ids.resize(n);
+    weight_g.resize(n);
+    distance_dam.resize(n);
+    meta.resize(n);
+  }
+
+  void append(const PackedOrder &r)
+  {
+    ids.push_back(r.id);
+    weight_g.push_back(r.weight_g);
+    distance_dam.push_back(r.distance_dam);
+    meta.push_back(r.meta);
+  }
+
+  PackedOrder row(size_t i) const { return {ids[i], weight_g[i], distance_dam[i], meta[i]}; }
+};
+
+// Reads an order file block by block; each block is four large reads
+class SegmentReader
+{
+  int fd_ = -1;
+  string payload_;
+  vector<uint32_t> kind_;
+
+  bool read_encoded(uint32_t *values, size_t n)
+  {
+    ColumnHeader h;
+    if (read_all(fd_, &h, sizeof h) != sizeof h)
+      return false;
+    size_t size = encoded_size(h, n);
+    if (!size)
+      return false;
+    payload_.resize(size - sizeof h);
+    return read_all(fd_, &payload_[0], payload_.size()) == payload_.size() &&
+           decode_column(h, payload_.data(), values, n);
+  }
+
+public:
+  SegmentReader() = default;
+  SegmentReader(const SegmentReader &) = delete;
+  SegmentReader &operator=(const SegmentReader &) = delete;
+  ~SegmentReader() { close(); }
+
+  bool open(const string &path)
+  {
+    close();
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ >= 0)
+      ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return fd_ >= 0;
+  }
+
+  void close()
+  {
+    if (fd_ >= 0)
+      ::close(fd_);
+    fd_ = -1;
+  }
+
+  // 1 with the next block in `block`, 0 at end of file, -1 if the file is damaged
+  int next(OrderBlock &block)
+  {
+    size_t got = read_all(fd_, &block.header, sizeof block.header);
+    if (got == 0)
+      return 0;
+    const SegmentFileHeader &h = block.header;
+    if (got != sizeof h || memcmp(h.magic, SegmentFile::MAGIC, sizeof h.magic) != 0 ||
+        h.version != SegmentFile::VERSION || h.rows > Config::SEGMENT_ROWS || h.encoding > SegmentFile::ENCODED)
+      return -1;
+    block.resize(h.rows);
+    kind_.resize(h.rows);
+    void *columns[] = {block.ids.data(), block.weight_g.data(), block.distance_dam.data(), block.meta.data(),
+                       kind_.data()};
+    if (h.encoding != SegmentFile::ENCODED)
+    {
+      for (int c = 0; c < SegmentFile::COLUMNS; ++c)
+        if (read_all(fd_, columns[c], h.rows * sizeof(int32_t)) != h.rows * sizeof(int32_t))
+          return -1;
+      return 1;
+    }
+    for (void *column : columns)
+      if (!read_encoded(static_cast<uint32_t *>(column), h.rows))
+        return -1;
+    return merge_kind(block.meta.data(), kind_.data(), h.rows) ? 1 : -1;
+  }
+};
+
+// Writes an order file, buffering one full block between writes
+class SegmentWriter
+{
+  int fd_ = -1;
+  OrderBlock block_;
+  uint32_t blocks_ = 0;
+  bool ok_ = true;
+  bool encoded_ = false;
+  int64_t journal_offset_ = 0;
+
+  SegmentFileHeader header(size_t rows, int64_t bucket = 0, int64_t last_ms = 0)
+  {
+    SegmentFileHeader h = segment_header(rows, blocks_++, bucket, last_ms);
+    h.encoding = encoded_ && rows ? SegmentFile::ENCODED : SegmentFile::RAW;
+    h.journal_offset = journal_offset_;
+    return h;
+  }
+
+public:
+  SegmentWriter() = default;
+  SegmentWriter(const SegmentWriter &) = delete;
+  SegmentWriter &operator=(const SegmentWriter &) = delete;
+  ~SegmentWriter() { close(); }
+
+  bool open(const string &path)
+  {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ok_ = fd_ >= 0;
+    return ok_;
+  }
+
+  // Blocks written from now on use the column codecs
+  void set_encoded(bool encoded) { encoded_ = encoded; }
+
+  // Stamped into every block header from now on
+  void set_journal_offset(int64_t offset) { journal_offset_ = offset; }
+
+  void append(const PackedOrder &r)
+  {
+    block_.append(r);
+    if (block_.size() == Config::SEGMENT_ROWS)
+      flush();
+  }
+
+  // Writes columns that are already laid out, as whole blocks
+  void append_columns(const int32_t *ids, const int32_t *weight_g, const int32_t *distance_dam, const uint32_t *meta,
+                      size_t n, int64_t bucket = 0, int64_t last_ms = 0)
+  {
+    flush();
+    for (size_t i = 0; i < n && ok_; i += Config::SEGMENT_ROWS)
+    {
+      size_t rows = min(n - i, Config::SEGMENT_ROWS);
+      const void *columns[] = {ids + i, weight_g + i, distance_dam + i, meta + i};
+      ok_ = write_segment_block(fd_, header(rows, bucket, last_ms), columns);
+    }
+  }
+
+  void flush()
+  {
+    if (block_.size() == 0 || !ok_)
+      return;
+    const void *columns[] = {block_.ids.data(), block_.weight_g.data(), block_.distance_dam.data(), block_.meta.data()};
+    ok_ = write_segment_block(fd_, header(block_.size()), columns);
+    block_.resize(0);
+  }
+
+  // False if any write failed. An empty file still gets one (empty) block, so
+  // every order file starts with a header; `sync` makes the file durable.
+  bool close(bool sync = false)
+  {
+    if (fd_ < 0)
+      return ok_;
+    flush();
+    if (blocks_ == 0 && ok_)
+    {
+      const void *columns[SegmentFile::COLUMNS] = {};
+      ok_ = write_segment_block(fd_, header(0), columns);
+    }
+    if (sync && ok_)
+      ok_ = ::fdatasync(fd_) == 0;
+    ok_ = ::close(fd_) == 0 && ok_;
+    fd_ = -1;
+    return ok_;
+  }
+};
+
+// Read-only mapping of a segment file; pages are loaded on first touch and
+// can be dropped by the kernel under memory pressure
+class SegmentMapping
+{
+  const char *base_ = nullptr;
+  size_t length_ = 0;
+
+public:
+  SegmentMapping() = default;
+  SegmentMapping(const SegmentMapping &) = delete;
+  SegmentMapping &operator=(const SegmentMapping &) = delete;
+  ~SegmentMapping() { close(); }
+
+  // False if the file is unreadable, truncated or not a segment file
+  bool open(const string &path)
+  {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    void *addr = MAP_FAILED;
+    if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(SegmentFileHeader))
+      addr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+      return false;
+    base_ = static_cast<const char *>(addr);
+    length_ = static_cast<size_t>(st.st_size);
+    const SegmentFileHeader &h = header();
+    if (memcmp(h.magic, SegmentFile::MAGIC, sizeof h.magic) != 0 || h.version != SegmentFile::VERSION ||
+        h.encoding != SegmentFile::RAW ||
+        length_ < sizeof h + size_t{h.rows} * sizeof(int32_t) * SegmentFile::COLUMNS)
+    {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close()
+  {
+    if (base_)
+      ::munmap(const_cast<char *>(base_), length_);
+    base_ = nullptr;
+    length_ = 0;
+  }
+
+  const SegmentFileHeader &header() const { return *reinterpret_cast<const SegmentFileHeader *>(base_); }
+  size_t rows() const { return header().rows; }
+
+  template <class T>
+  const T *column(int c) const
+  {
+    return reinterpret_cast<const T *>(base_ + sizeof(SegmentFileHeader) + c * rows() * sizeof(int32_t));
+  }
+};
+
+// ==========================================
+// Columnar Order Store 🗄️
+// ==========================================
+
+// Fixed-capacity column chunk. Rows are addressed globally as
+// (seq << 16) | local index. Row ids are 32-bit, so before seq runs out the
+// manager renumbers the live segments from 0 (OrderStore::renumber) and
+// shifts its indexes to match; ids stay unique while fewer than 65536
+// segments are live. Sealed segments can be spilled: the columns move to a
+// mapped file and the vectors are freed.
+struct OrderSegment
+{
+  uint32_t seq = 0;
+  size_t first_ordinal = 0; // arrival number of the first row
+  int64_t bucket = 0;       // retention time bucket
+  int64_t last_ms = 0;      // arrival time of the newest row
+  vector<int32_t> ids;
+  vector<int32_t> weight_g;
+  vector<int32_t> distance_dam;
+  vector<uint32_t> meta;
+  unique_ptr<SegmentMapping> spilled;
+
+  size_t size() const { return spilled ? spilled->rows() : ids.size(); }
+  bool full() const { return size() == Config::SEGMENT_ROWS; }
+
+  const int32_t *id_data() const { return spilled ? spilled->column<int32_t>(0) : ids.data(); }
+  const int32_t *weight_data() const { return spilled ? spilled->column<int32_t>(1) : weight_g.data(); }
+  const int32_t *distance_data() const { return spilled ? spilled->column<int32_t>(2) : distance_dam.data(); }
+  const uint32_t *meta_data() const { return spilled ? spilled->column<uint32_t>(3) : meta.data(); }
+
+  void append(const PackedOrder &r)
+  {
+    ids.push_back(r.id);
+    weight_g.push_back(r.weight_g);
+    distance_dam.push_back(r.distance_dam);
+    meta.push_back(r.meta);
+  }
+
+  PackedOrder row(size_t i) const
+  {
+    if (spilled)
+      return {id_data()[i], weight_data()[i], distance_data()[i], meta_data()[i]};
+    return {ids[i], weight_g[i], distance_dam[i], meta[i]};
+  }
+
+  // Moves the columns to `path` and maps them back; the file is unlinked
+  // once mapped, so it goes away with the mapping. False leaves the segment
+  // untouched.
+  bool spill(const string &path)
+  {
+    SegmentFileHeader header = segment_header(size(), seq, bucket, last_ms);
+    const void *columns[] = {ids.data(), weight_g.data(), distance_dam.data(), meta.data()};
+    auto mapping = make_unique<SegmentMapping>();
+    bool ok = write_segment_file(path, header, columns) && mapping->open(path);
+    ::unlink(path.c_str());
+    if (!ok)
+      return false;
+    spilled = std::move(mapping);
+    vector<int32_t>().swap(ids);
+    vector<int32_t>().swap(weight_g);
+    vector<int32_t>().swap(distance_dam);
+    vector<uint32_t>().swap(meta);
+    return true;
+  }
+
+  // Empties the columns but keeps their capacity
+  void reset()
+  {
+    spilled.reset();
+    ids.clear();
+    weight_g.clear();
+    distance_dam.clear();
+    meta.clear();
+  }
+};
+
+// How much history the store keeps; 0 means no limit
+struct RetentionPolicy
+{
+  size_t max_orders = 0;
+  int64_t max_age_ms = 0;
+};
+
+// Segments form a queue: new rows go to the tail, and retention drops whole
+// segments from the front, so memory stays bounded by the policy plus one
+// segment (or one age bucket). A count limit keeps between max_orders and
+// max_orders + SEGMENT_ROWS - 1 rows once reached: the front segment goes
+// only when the rows behind it already cover the limit.
+class OrderStore
+{
+  deque<unique_ptr<OrderSegment>> segments_;
+  vector<unique_ptr<OrderSegment>> spare_;
+  RetentionPolicy retention_;
+  size_t size_ = 0;
+  size_t resident_ = 0; // rows still held in vectors
+  size_t budget_ = 0;   // bytes; 0 = never spill
+  string spill_dir_;
+  size_t spilled_files_ = 0;
+  size_t first_resident_ = 0; // segments before it are all spilled
+  size_t retry_ordinal_ = 0;  // no spill attempt before this arrival after a failure
+  size_t next_ordinal_ = 0;
+  uint32_t next_seq_ = 0;
+
+  int64_t bucket_of(int64_t at_ms) const
+  {
+    if (!retention_.max_age_ms)
+      return 0;
+    return at_ms / max<int64_t>(1, retention_.max_age_ms / Config::RETENTION_BUCKETS);
+  }
+
+public:
+  // Segment with room for at least one more row arriving at `at_ms`
+  OrderSegment &tail(int64_t at_ms)
+  {
+    int64_t bucket = bucket_of(at_ms);
+    if (segments_.empty() || segments_.back()->full() || segments_.back()->bucket != bucket)
+    {
+      unique_ptr<OrderSegment> seg;
+      if (spare_.empty())
+        seg = make_unique<OrderSegment>();
+      else
+      {
+        seg = std::move(spare_.back());
+        spare_.pop_back();
+      }
+      seg->seq = next_seq_++;
+      seg->first_ordinal = next_ordinal_;
+      seg->bucket = bucket;
+      seg->last_ms = at_ms;
+      segments_.push_back(std::move(seg));
+    }
+    return *segments_.back();
+  }
+
+  // Returns the row id of the appended order
+  uint32_t append(const PackedOrder &r, int64_t at_ms)
+  {
+    OrderSegment &seg = tail(at_ms);
+    seg.append(r);
+    commit(1, at_ms);
+    return (seg.seq << 16) | static_cast<uint32_t>(seg.size() - 1);
+  }
+
+  // Accounts for rows written directly into tail()
+  void commit(size_t rows, int64_t at_ms)
+  {
+    size_ += rows;
+    resident_ += rows;
+    next_ordinal_ += rows;
+    segments_.back()->last_ms = max(segments_.back()->last_ms, at_ms);
+  }
+
+  void set_retention(const RetentionPolicy &policy) { retention_ = policy; }
+
+  // Oldest segment if the policy lets it go at `now`; the tail always stays,
+  // so a count limit below SEGMENT_ROWS still keeps the whole tail
+  const OrderSegment *expired_front(int64_t now) const
+  {
+    if (segments_.size() < 2)
+      return nullptr;
+    const OrderSegment &front = *segments_.front();
+    bool over_count = retention_.max_orders && size_ - front.size() >= retention_.max_orders;
+    bool over_age = retention_.max_age_ms && front.last_ms < now - retention_.max_age_ms;
+    return over_count || over_age ? &front : nullptr;
+  }
+
+  // Drops the oldest segment; its buffers are kept for reuse
+  void drop_front()
+  {
+    unique_ptr<OrderSegment> seg = std::move(segments_.front());
+    segments_.pop_front();
+    first_resident_ -= first_resident_ > 0;
+    size_ -= seg->size();
+    if (!seg->spilled)
+      resident_ -= seg->size();
+    if (spare_.size() < Config::SPARE_SEGMENTS)
+    {
+      seg->reset();
+      spare_.push_back(std::move(seg));
+    }
+  }
+
+  // True once the next new segment would overflow the 16-bit seq space
+  bool seq_exhausted() const { return next_seq_ > 0xFFFF; }
+
+  // Renumbers the live segments so the front one has seq 0; returns the
+  // amount every row id's high half moved down by
+  uint32_t renumber()
+  {
+    uint32_t by = segments_.empty() ? next_seq_ : segments_.front()->seq;
+    for (auto &seg : segments_)
+      seg->seq -= by;
+    next_seq_ -= by;
+    return by;
+  }
+
+  void set_spill(size_t max_bytes, const string &dir)
+  {
+    budget_ = max_bytes;
+    spill_dir_ = dir;
+    retry_ordinal_ = 0;
+  }
+
+  // True if a sealed segment is still resident and no failed write is
+  // backing off; cheap enough to check on every ingest
+  bool can_spill() const
+  {
+    return budget_ && first_resident_ + 1 < segments_.size() && next_ordinal_ >= retry_ordinal_;
+  }
+
+  // Spills sealed segments, oldest first, until the resident rows plus
+  // `other_bytes` (indexes and sketches) fit the budget. Only the resident
+  // segments are visited. After a failed write the next attempt waits for
+  // another SEGMENT_ROWS arrivals. Returns segments spilled.
+  size_t spill(size_t other_bytes)
+  {
+    size_t count = 0;
+    while (can_spill() && resident_ * sizeof(PackedOrder) + other_bytes > budget_)
+    {
+      OrderSegment &seg = *segments_[first_resident_];
+      string path = spill_dir_ + "/orders-" + to_string(::getpid()) + "-" + to_string(spilled_files_) + ".seg";
+      if (!seg.spill(path))
+      {
+        retry_ordinal_ = next_ordinal_ + Config::SEGMENT_ROWS;
+        break;
+      }
+      ++spilled_files_;
+      ++first_resident_;
+      resident_ -= seg.size();
+      ++count;
+    }
+    return count;
+  }
+
+  size_t size() const { return size_; }
+  size_t resident() const { return resident_; }
+  const deque<unique_ptr<OrderSegment>> &segments() const { return segments_; }
+
+  // Segment and offset of a live row; index counts live rows, oldest first
+  pair<const OrderSegment *, size_t> locate(size_t index) const
+  {
+    size_t ordinal = segments_.front()->first_ordinal + index;
+    auto it = upper_bound(segments_.begin(), segments_.end(), ordinal,
+                          [](size_t o, const unique_ptr<OrderSegment> &seg) { return o < seg->first_ordinal; });
+    const OrderSegment *seg = (it - 1)->get();
+    return {seg, ordinal - seg->first_ordinal};
+  }
+
+  PackedOrder row(size_t index) const
+  {
+    auto at = locate(index);
+    return at.first->row(at.second);
+  }
+
+  // Position of the row's segment in segments_ (modulo the 16-bit seq space)
+  size_t segment_of(uint32_t row_id) const
+  {
+    return static_cast<uint16_t>((row_id >> 16) - segments_.front()->seq);
+  }
+
+  bool is_live(uint32_t row_id) const
+  {
+    if (segments_.empty())
+      return false;
+    size_t s = segment_of(row_id);
+    return s < segments_.size() && (row_id & 0xFFFF) < segments_[s]->size();
+  }
+
+  PackedOrder row_by_id(uint32_t row_id) const { return segments_[segment_of(row_id)]->row(row_id & 0xFFFF); }
+
+  template <class F>
+  void for_each(F &&f) const
+  {
+    for (const auto &seg : segments_)
+      for (size_t i = 0; i < seg->size(); ++i)
+        f(seg->row(i));
+  }
+
+  // Drops every row; retention and spill settings stay
+  void clear()
+  {
+    segments_.clear();
+    spare_.clear();
+    size_ = 0;
+    resident_ = 0;
+    next_ordinal_ = 0;
+    next_seq_ = 0;
+    first_resident_ = 0;
+    retry_ordinal_ = 0;
+  }
+};
+
+// ==========================================
+// Branchless Classification Kernel 🧮
+// ==========================================
+
+// The factory rules only look at six predicates, so every decision is one of
+// 64 outcomes. The kernel turns each row into a predicate mask and reads the
+// outcome from a table; only the truck ETA still depends on the row, and that
+// part is plain arithmetic.
+namespace Predicate
+{
+  constexpr uint32_t URGENT = 1;
+  constexpr uint32_t AIR_WEIGHT = 2;  // weight < AIR_MAX_WEIGHT
+  constexpr uint32_t AIR_DIST = 4;    // distance > AIR_MIN_DIST
+  constexpr uint32_t SHIP_DIST = 8;   // distance > SHIP_MIN_DIST
+  constexpr uint32_t SHIP_WEIGHT = 16; // weight > SHIP_MAX_WEIGHT
+  constexpr uint32_t HEAVY = 32;      // weight > TRUCK_HEAVY_THRESHOLD
+}
+
+inline uint32_t predicate_mask(const OrderDetails &o)
+{
+  return (o.urgent ? Predicate::URGENT : 0) | (o.weight_kg < Config::AIR_MAX_WEIGHT ? Predicate::AIR_WEIGHT : 0) |
+         (o.distance_km > Config::AIR_MIN_DIST ? Predicate::AIR_DIST : 0) |
+         (o.distance_km > Config::SHIP_MIN_DIST ? Predicate::SHIP_DIST : 0) |
+         (o.weight_kg > Config::SHIP_MAX_WEIGHT ? Predicate::SHIP_WEIGHT : 0) |
+         (o.weight_kg > Config::TRUCK_HEAVY_THRESHOLD ? Predicate::HEAVY : 0);
+}
+
+// One meta word per predicate mask: kind and flags, the ETA without the route
+// part, and an all-ones route field for trucks (used as a mask). Filled once by
+// running TransportFactory on one representative order per mask, so the table
+// follows the factory; masks no order can produce stay plain trucks.
+inline const uint32_t *outcome_table()
+{
+  static const array<uint32_t, 64> table = []
+  {
+    using P = PackedOrder;
+    constexpr uint32_t route_field = 1023u << P::ROUTE_SHIFT;
+    constexpr uint32_t eta_field = 255u << P::ETA_SHIFT;
+    constexpr uint32_t row_bits = route_field | eta_field | (1u << P::URGENT_BIT) | (1u << P::WEIGHT_FRAC_BIT) |
+                                  (1u << P::DISTANCE_FRAC_BIT);
+
+    // Each threshold, the midpoints between them and one value beyond either end
+    auto representatives = [](vector<double> t)
+    {
+      sort(t.begin(), t.end());
+      vector<double> v{t.front() - 1, t.back() + 1};
+      for (size_t i = 0; i < t.size(); ++i)
+      {
+        v.push_back(t[i]);
+        if (i + 1 < t.size())
+          v.push_back((t[i] + t[i + 1]) / 2);
+      }
+      return v;
+    };
+
+    array<uint32_t, 64> t;
+    t.fill((1u << P::ETA_SHIFT) | route_field);
+    for (double w : representatives({Config::AIR_MAX_WEIGHT, Config::SHIP_MAX_WEIGHT, Config::TRUCK_HEAVY_THRESHOLD}))
+      for (double d : representatives({Config::AIR_MIN_DIST, Config::SHIP_MIN_DIST}))
+        for (bool urgent : {false, true})
+        {
+          OrderDetails o{0, w, d, urgent};
+          PackedOrder r = P::pack(o, *TransportFactory::create_transport(o));
+          bool truck = r.kind() == TransportKind::Truck;
+          int eta_base = r.eta_days() - (truck ? r.route_minutes() / 60 : 0);
+          t[predicate_mask(o)] = (r.meta & ~row_bits) | P::field(eta_base, 8, P::ETA_SHIFT) | (truck ? route_field : 0);
+        }
+    return t;
+  }();
+  return table.data();
+}
+
+// Batch classifier over quantized columns; on input `meta` holds the urgent
+// and frac bits plus the truck route minutes. 32-bit lanes and no
+// data-dependent branches let the compiler vectorize this at twice the width
+// of the double rules. Decisions match TransportFactory exactly (see
+// PackedOrder::quantize).
+inline void classify_columns(const int32_t *weight_g, const int32_t *distance_dam, uint32_t *meta, size_t n)
+{
+  using P = PackedOrder;
+  constexpr int32_t air_w = static_cast<int32_t>(Config::AIR_MAX_WEIGHT * Config::WEIGHT_SCALE);
+  constexpr int32_t ship_w = static_cast<int32_t>(Config::SHIP_MAX_WEIGHT * Config::WEIGHT_SCALE);
+  constexpr int32_t heavy_w = static_cast<int32_t>(Config::TRUCK_HEAVY_THRESHOLD * Config::WEIGHT_SCALE);
+  constexpr int32_t air_d = static_cast<int32_t>(Config::AIR_MIN_DIST * Config::DISTANCE_SCALE);
+  constexpr int32_t ship_d = static_cast<int32_t>(Config::SHIP_MIN_DIST * Config::DISTANCE_SCALE);
+  constexpr uint32_t route_field = 1023u << P::ROUTE_SHIFT;
+  constexpr uint32_t eta_field = 255u << P::ETA_SHIFT;
+  constexpr uint32_t input_bits = (1u << P::URGENT_BIT) | (1u << P::WEIGHT_FRAC_BIT) | (1u << P::DISTANCE_FRAC_BIT);
+  const uint32_t *outcomes = outcome_table();
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    uint32_t m = meta[i];
+    int32_t w = weight_g[i];
+    int32_t d = distance_dam[i];
+    int32_t w_ceil = w + static_cast<int32_t>((m >> P::WEIGHT_FRAC_BIT) & 1);
+    int32_t d_ceil = d + static_cast<int32_t>((m >> P::DISTANCE_FRAC_BIT) & 1);
+
+    uint32_t mask = ((m >> P::URGENT_BIT) & 1) | static_cast<uint32_t>(w < air_w) << 1 |
+                    static_cast<uint32_t>(d_ceil > air_d) << 2 | static_cast<uint32_t>(d_ceil > ship_d) << 3 |
+                    static_cast<uint32_t>(w_ceil > ship_w) << 4 | static_cast<uint32_t>(w_ceil > heavy_w) << 5;
+    uint32_t outcome = outcomes[mask];
+
+    uint32_t route = m & outcome & route_field;
+    uint32_t eta = (outcome & eta_field) + (((route >> P::ROUTE_SHIFT) / 60) << P::ETA_SHIFT);
+    meta[i] = (m & input_bits) | (outcome & ~(route_field | eta_field)) | eta | route;
+  }
+}
+
+// ==========================================
+// Compressed Bitmaps 🧩
+// ==========================================
+
+// Roaring-style bitmap over 32-bit row ids: one container per 64K chunk,
+// held as a sorted uint16 array while sparse and as a 1024-word bitset once
+// it passes 4096 entries. Appending ids in increasing order is O(1).
+class RoaringBitmap
+{
+  static constexpr size_t ARRAY_MAX = 4096;
+  static constexpr size_t WORDS = 1024;
+
+  struct Container
+  {
+    uint16_t key = 0;
+    uint32_t count = 0;
+    vector<uint16_t> array; // sparse form
+    vector<uint64_t> bits;  // dense form when non-empty
+
+    bool dense() const { return !bits.empty(); }
+
+    void add(uint16_t low)
+    {
+      if (dense())
+      {
+        uint64_t bit = uint64_t{1} << (low % 64);
+        count += (bits[low / 64] & bit) == 0;
+        bits[low / 64] |= bit;
+        return;
+      }
+      if (array.empty() || low > array.back())
+        array.push_back(low);
+      else
+      {
+        auto it = lower_bound(array.begin(), array.end(), low);
+        if (*it == low)
+          return;
+        array.insert(it, low);
+      }
+      ++count;
+      if (array.size() > ARRAY_MAX)
+        bits = words(), array.clear();
+    }
+
+    vector<uint64_t> words() const
+    {
+      if (dense())
+        return bits;
+      vector<uint64_t> w(WORDS, 0);
+      for (uint16_t v : array)
+        w[v / 64] |= uint64_t{1} << (v % 64);
+      return w;
+    }
+
+    // Picks the smaller form for the current cardinality
+    void normalize()
+    {
+      if (dense() && count <= ARRAY_MAX)
+      {
+        array.clear();
+        for (size_t i = 0; i < WORDS; ++i)
+          for (uint64_t w = bits[i]; w; w &= w - 1)
+            array.push_back(static_cast<uint16_t>(i * 64 + __builtin_ctzll(w)));
+        bits.clear();
+      }
+      else if (!dense() && count > ARRAY_MAX)
+      {
+        bits = words();
+        array.clear();
+      }
+    }
+  };
+
+  enum class Op
+  {
+    And,
+    Or,
+    AndNot
+  };
+
+  vector<Container> containers_; // sorted by key
+
+  static Container combine(const Container &a, const Container &b, Op op)
+  {
+    Container out;
+    out.key = a.key;
+    if (!a.dense() && !b.dense())
+    {
+      auto sink = back_inserter(out.array);
+      if (op == Op::And)
+        set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), sink);
+      else if (op == Op::Or)
+        set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), sink);
+      else
+        set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), sink);
+      out.count = static_cast<uint32_t>(out.array.size());
+    }
+    else
+    {
+      vector<uint64_t> wa = a.words(), wb = b.words();
+      out.bits.resize(WORDS);
+      for (size_t i = 0; i < WORDS; ++i)
+      {
+        uint64_t w = op == Op::And ? wa[i] & wb[i] : (op == Op::Or ? wa[i] | wb[i] : wa[i] & ~wb[i]);
+        out.bits[i] = w;
+        out.count += static_cast<uint32_t>(__builtin_popcountll(w));
+      }
+    }
+    out.normalize();
+    return out;
+  }
+
+  static RoaringBitmap merge(const RoaringBitmap &a, const RoaringBitmap &b, Op op)
+  {
+    RoaringBitmap out;
+    auto ia = a.containers_.begin(), ib = b.containers_.begin();
+    auto keep = [&](Container c)
+    {
+      if (c.count)
+        out.containers_.push_back(std::move(c));
+    };
+    while (ia != a.containers_.end() || ib != b.containers_.end())
+    {
+      if (ib == b.containers_.end() || (ia != a.containers_.end() && ia->key < ib->key))
+      {
+        if (op != Op::And)
+          keep(*ia);
+        ++ia;
+      }
+      else if (ia == a.containers_.end() || ib->key < ia->key)
+      {
+        if (op == Op::Or)
+          keep(*ib);
+        ++ib;
+      }
+      else
+        keep(combine(*ia++, *ib++, op));
+    }
+    return out;
+  }
+
+public:
+  void add(uint32_t value)
+  {
+    uint16_t key = static_cast<uint16_t>(value >> 16);
+    if (containers_.empty() || containers_.back().key < key)
+    {
+      containers_.emplace_back();
+      containers_.back().key = key;
+    }
+    auto it = containers_.end() - 1;
+    if (it->key != key)
+    {
+      it = lower_bound(containers_.begin(), containers_.end(), key,
+                       [](const Container &c, uint16_t k) { return c.key < k; });
+      if (it->key != key)
+      {
+        it = containers_.insert(it, Container{});
+        it->key = key;
+      }
+    }
+    it->add(static_cast<uint16_t>(value));
+  }
+
+  size_t cardinality() const
+  {
+    size_t n = 0;
+    for (const auto &c : containers_)
+      n += c.count;
+    return n;
+  }
+
+  template <class F>
+  void for_each(F &&f) const
+  {
+    for (const auto &c : containers_)
+    {
+      uint32_t high = static_cast<uint32_t>(c.key) << 16;
+      if (!c.dense())
+        for (uint16_t v : c.array)
+          f(high | v);
+      else
+        for (size_t i = 0; i < WORDS; ++i)
+          for (uint64_t w = c.bits[i]; w; w &= w - 1)
+            f(high | static_cast<uint32_t>(i * 64 + __builtin_ctzll(w)));
+    }
+  }
+
+  // Removes every value whose high 16 bits are `key` (one store segment)
+  void erase_chunk(uint16_t key)
+  {
+    auto it = lower_bound(containers_.begin(), containers_.end(), key,
+                          [](const Container &c, uint16_t k) { return c.key < k; });
+    if (it != containers_.end() && it->key == key)
+      containers_.erase(it);
+  }
+
+  size_t bytes() const
+  {
+    size_t n = containers_.capacity() * sizeof(Container);
+    for (const auto &c : containers_)
+      n += c.array.capacity() * sizeof(uint16_t) + c.bits.capacity() * sizeof(uint64_t);
+    return n;
+  }
+
+  // Moves every chunk `by` keys down (store renumbering); no chunk may lie
+  // below `by`
+  void shift_keys(uint16_t by)
+  {
+    for (auto &c : containers_)
+      c.key = static_cast<uint16_t>(c.key - by);
+  }
+
+  void clear() { containers_.clear(); }
+
+  friend RoaringBitmap operator&(const RoaringBitmap &a, const RoaringBitmap &b) { return merge(a, b, Op::And); }
+  friend RoaringBitmap operator|(const RoaringBitmap &a, const RoaringBitmap &b) { return merge(a, b, Op::Or); }
+  friend RoaringBitmap and_not(const RoaringBitmap &a, const RoaringBitmap &b) { return merge(a, b, Op::AndNot); }
+};
+
+// Bitmaps kept per transport kind and per decision flag
+namespace Filter
+{
+  constexpr uint32_t TRUCK = 1;
+  constexpr uint32_t SHIP = 2;
+  constexpr uint32_t AIR = 4;
+  constexpr uint32_t URGENT = 8;
+  constexpr uint32_t HEAVY = 16;
+  constexpr uint32_t RESERVED = 32;
+  constexpr uint32_t EXPRESS = 64;
+  constexpr int COUNT = 7;
+
+  inline uint32_t of(const PackedOrder &r)
+  {
+    return (1u << static_cast<int>(r.kind())) | (r.urgent() ? URGENT : 0) | (r.heavy() ? HEAVY : 0) |
+           (r.reserved() ? RESERVED : 0) | (r.express() ? EXPRESS : 0);
+  }
+}
+
+// ==========================================
+// Range Index 📏
+// ==========================================
+
+// LSD radix sort on 16-bit digits; passes where every value shares the digit
+// are skipped, so small or narrow keys cost fewer passes. Short inputs use a
+// comparison sort, since a pass clears a 512 KB histogram.
+inline void radix_sort(vector<uint64_t> &values)
+{
+  if (values.size() < 4096)
+  {
+    sort(values.begin(), values.end());
+    return;
+  }
+  vector<uint64_t> scratch(values.size());
+  vector<size_t> offsets;
+  for (int shift = 0; shift < 64; shift += 16)
+  {
+    offsets.assign(size_t{1} << 16, 0);
+    for (uint64_t v : values)
+      ++offsets[(v >> shift) & 0xFFFF];
+    if (!values.empty() && offsets[(values[0] >> shift) & 0xFFFF] == values.size())
+      continue;
+    size_t sum = 0;
+    for (auto &o : offsets)
+      sum += exchange(o, sum);
+    for (uint64_t v : values)
+      scratch[offsets[(v >> shift) & 0xFFFF]++] = v;
+    values.swap(scratch);
+  }
+}
+
+// Sorted-run index of (key, row id) pairs for range queries on a quantized
+// column. Inserts collect in a small sorted buffer; full buffers and bulk
+// loads become runs, and runs are merged while the newer one is at least half
+// the size of the older, so there are O(log n) runs and a range count is a
+// pair of binary searches per run. Keys and rows live in separate arrays so
+// searches only touch the dense key array. Rows dropped by retention are
+// recorded as runs of their own and subtracted from counts until a purge
+// rewrites the live runs without them.
+class RangeIndex
+{
+  struct Run
+  {
+    vector<int32_t> keys;
+    vector<uint32_t> rows;
+    size_t size() const { return keys.size(); }
+  };
+
+  static constexpr size_t BUFFER_MAX = 1024;
+
+  vector<Run> runs_; // decreasing size
+  Run buffer_;
+  vector<Run> expired_;
+  size_t size_ = 0;
+  size_t expired_size_ = 0;
+
+  static Run merge(const Run &a, const Run &b)
+  {
+    Run out;
+    out.keys.resize(a.size() + b.size());
+    out.rows.resize(a.size() + b.size());
+    size_t i = 0, j = 0, k = 0;
+    while (i < a.size() || j < b.size())
+    {
+      bool take_a = j == b.size() || (i < a.size() && a.keys[i] <= b.keys[j]);
+      const Run &src = take_a ? a : b;
+      size_t &pos = take_a ? i : j;
+      out.keys[k] = src.keys[pos];
+      out.rows[k++] = src.rows[pos++];
+    }
+    return out;
+  }
+
+  static void add_run(vector<Run> &runs, Run run)
+  {
+    runs.push_back(std::move(run));
+    while (runs.size() >= 2 && runs[runs.size() - 2].size() <= 2 * runs.back().size())
+    {
+      Run merged = merge(runs[runs.size() - 2], runs.back());
+      runs.pop_back();
+      runs.back() = std::move(merged);
+    }
+  }
+
+  // Sorts a column slice once into a run
+  static Run sorted_run(const int32_t *keys, uint32_t first_row, size_t n)
+  {
+    // Order-preserving unsigned key in the high half, row offset in the low half
+    vector<uint64_t> packed(n);
+    for (size_t i = 0; i < n; ++i)
+      packed[i] = static_cast<uint64_t>(static_cast<uint32_t>(keys[i]) ^ 0x80000000u) << 32 | i;
+    radix_sort(packed);
+    Run run;
+    run.keys.resize(n);
+    run.rows.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+      run.keys[i] = static_cast<int32_t>(static_cast<uint32_t>(packed[i] >> 32) ^ 0x80000000u);
+      run.rows[i] = first_row + static_cast<uint32_t>(packed[i]);
+    }
+    return run;
+  }
+
+  static size_t count_in(const vector<Run> &runs, int32_t lo, int32_t hi)
+  {
+    size_t n = 0;
+    for (const auto &run : runs)
+    {
+      auto b = bounds(run, lo, hi);
+      n += b.second - b.first;
+    }
+    return n;
+  }
+
+  static pair<size_t, size_t> bounds(const Run &run, int32_t lo, int32_t hi)
+  {
+    auto first = lower_bound(run.keys.begin(), run.keys.end(), lo);
+    auto last = upper_bound(first, run.keys.end(), hi);
+    return {static_cast<size_t>(first - run.keys.begin()), static_cast<size_t>(last - run.keys.begin())};
+  }
+
+public:
+  void insert(int32_t key, uint32_t row)
+  {
+    auto it = upper_bound(buffer_.keys.begin(), buffer_.keys.end(), key);
+    size_t pos = static_cast<size_t>(it - buffer_.keys.begin());
+    buffer_.keys.insert(it, key);
+    buffer_.rows.insert(buffer_.rows.begin() + static_cast<ptrdiff_t>(pos), row);
+    ++size_;
+    if (buffer_.size() >= BUFFER_MAX)
+      add_run(runs_, std::exchange(buffer_, Run{}));
+  }
+
+  // Sorts a batch once and adds it as a single run
+  void bulk_load(const int32_t *keys, uint32_t first_row, size_t n)
+  {
+    add_run(runs_, sorted_run(keys, first_row, n));
+    size_ += n;
+  }
+
+  // Marks rows already in the index as gone (a dropped store segment)
+  void expire(const int32_t *keys, uint32_t first_row, size_t n)
+  {
+    add_run(expired_, sorted_run(keys, first_row, n));
+    expired_size_ += n;
+  }
+
+  // Live rows with lo <= key <= hi
+  size_t count(int32_t lo, int32_t hi) const
+  {
+    if (lo > hi)
+      return 0;
+    auto b = bounds(buffer_, lo, hi);
+    return b.second - b.first + count_in(runs_, lo, hi) - count_in(expired_, lo, hi);
+  }
+
+  // True once expired rows outnumber half the live ones
+  bool needs_purge() const { return expired_size_ * 2 > size_ - expired_size_; }
+
+  // Rewrites the runs keeping rows for which is_live(row) holds
+  template <class Live>
+  void purge(Live &&is_live)
+  {
+    auto filter = [&](Run &run)
+    {
+      size_t k = 0;
+      for (size_t i = 0; i < run.size(); ++i)
+        if (is_live(run.rows[i]))
+        {
+          run.keys[k] = run.keys[i];
+          run.rows[k++] = run.rows[i];
+        }
+      size_ -= run.size() - k;
+      run.keys.resize(k);
+      run.rows.resize(k);
+    };
+    filter(buffer_);
+    vector<Run> old = std::move(runs_);
+    runs_.clear();
+    for (auto &run : old)
+    {
+      filter(run);
+      if (run.size())
+        add_run(runs_, std::move(run));
+    }
+    expired_.clear();
+    expired_size_ = 0;
+  }
+
+  size_t bytes() const
+  {
+    auto run_bytes = [](const Run &run)
+    { return run.keys.capacity() * sizeof(int32_t) + run.rows.capacity() * sizeof(uint32_t); };
+    size_t n = run_bytes(buffer_);
+    for (const auto &run : runs_)
+      n += run_bytes(run);
+    for (const auto &run : expired_)
+      n += run_bytes(run);
+    return n;
+  }
+
+  // Subtracts `by` from every row id (store renumbering); purge first, so
+  // no expired rows are left to shift
+  void shift_rows(uint32_t by)
+  {
+    auto shift = [&](Run &run)
+    {
+      for (uint32_t &row : run.rows)
+        row -= by;
+    };
+    shift(buffer_);
+    for (auto &run : runs_)
+      shift(run);
+  }
+
+  // Calls f(key, row) for matches, run by run (not globally key-ordered).
+  // Expired rows are still visited until the next purge; callers that care
+  // check them against the store.
+  template <class F>
+  void for_each(int32_t lo, int32_t hi, F &&f) const
+  {
+    if (lo > hi)
+      return;
+    auto visit = [&](const Run &run)
+    {
+      auto b = bounds(run, lo, hi);
+      for (size_t i = b.first; i < b.second; ++i)
+        f(run.keys[i], run.rows[i]);
+    };
+    visit(buffer_);
+    for (const auto &run : runs_)
+      visit(run);
+  }
+
+  void clear()
+  {
+    runs_.clear();
+    buffer_ = Run{};
+    expired_.clear();
+    size_ = 0;
+    expired_size_ = 0;
+  }
+};
+
+// Query bounds snap onto the grid the same way stored values do (floor), so a
+// bound typed as 1234.56 km matches an order entered as 1234.56 km.
+// Infinities saturate; a NaN bound matches nothing.
+inline int32_t grid_key(double value, double scale, bool upper)
+{
+  double v = floor(value * scale);
+  if (v != v)
+    return upper ? INT32_MIN : INT32_MAX;
+  if (v >= 2147483647.0)
+    return INT32_MAX;
+  if (v <= -2147483648.0)
+    return INT32_MIN;
+  return static_cast<int32_t>(v);
+}
+
+// ==========================================
+// Streaming Aggregation 📈
+// ==========================================
+
+inline int64_t now_ms()
+{
+  return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Ids of the live ThreadShards registries. A registry's destructor bumps
+// `retired`, which tells every thread to drop its cached slots for dead
+// registries on its next lookup.
+struct ShardRegistries
+{
+  mutex lock;
+  vector<uint64_t> live; // ascending, ids are never reused
+  atomic<uint64_t> retired{0};
+
+  static ShardRegistries &instance()
+  {
+    static ShardRegistries registries;
+    return registries;
+  }
+};
+
+// One instance of T per thread, created on first use. Slots are published
+// once and never freed while the registry lives, so readers can merge them
+// without locks. Threads beyond MAX_SHARDS share slots, so shard state must
+// stay safe under concurrent updates (atomics, or the shard's own lock).
+// OrderManager is driven by one thread at a time today (OrderService holds
+// its lock); the shards keep the aggregators ready for concurrent callers.
+template <class T>
+class ThreadShards
+{
+  static constexpr size_t MAX_SHARDS = 64;
+
+  struct Cache
+  {
+    vector<pair<uint64_t, T *>> entries;
+    uint64_t retired = 0;
+  };
+
+  const uint64_t id_ = next_id();
+  array<atomic<T *>, MAX_SHARDS> slots_{};
+  atomic<size_t> next_slot_{0};
+
+  static uint64_t next_id()
+  {
+    static atomic<uint64_t> ids{0};
+    ShardRegistries &registries = ShardRegistries::instance();
+    lock_guard<mutex> guard(registries.lock);
+    registries.live.push_back(++ids);
+    return registries.live.back();
+  }
+
+  // Drops the entries of registries destroyed since the last prune
+  static void prune(Cache &cache)
+  {
+    ShardRegistries &registries = ShardRegistries::instance();
+    lock_guard<mutex> guard(registries.lock);
+    cache.retired = registries.retired.load(memory_order_relaxed);
+    auto dead = [&](const pair<uint64_t, T *> &entry)
+    { return !binary_search(registries.live.begin(), registries.live.end(), entry.first); };
+    cache.entries.erase(remove_if(cache.entries.begin(), cache.entries.end(), dead), cache.entries.end());
+  }
+
+public:
+  ThreadShards() = default;
+  ThreadShards(const ThreadShards &) = delete;
+  ThreadShards &operator=(const ThreadShards &) = delete;
+
+  ~ThreadShards()
+  {
+    {
+      ShardRegistries &registries = ShardRegistries::instance();
+      lock_guard<mutex> guard(registries.lock);
+      registries.live.erase(lower_bound(registries.live.begin(), registries.live.end(), id_));
+      registries.retired.fetch_add(1, memory_order_release);
+    }
+    for (auto &slot : slots_)
+      delete slot.load();
+  }
+
+  T &local()
+  {
+    // Registry ids are never reused, so a stale entry cannot alias a new registry
+    thread_local Cache cache;
+    if (cache.retired != ShardRegistries::instance().retired.load(memory_order_acquire))
+      prune(cache);
+    for (const auto &entry : cache.entries)
+      if (entry.first == id_)
+        return *entry.second;
+
+    size_t slot = next_slot_.fetch_add(1) % MAX_SHARDS;
+    T *shard = slots_[slot].load(memory_order_acquire);
+    if (!shard)
+    {
+      T *fresh = new T();
+      if (slots_[slot].compare_exchange_strong(shard, fresh, memory_order_acq_rel))
+        shard = fresh;
+      else
+        delete fresh;
+    }
+    cache.entries.emplace_back(id_, shard);
+    return *shard;
+  }
+
+  template <class F>
+  void for_each(F &&f) const
+  {
+    for (const auto &slot : slots_)
+      if (T *shard = slot.load(memory_order_acquire))
+        f(*shard);
+  }
+};
+
+// Totals of one window, per transport kind (Truck, Ship, Air)
+struct OrderWindow
+{
+  int64_t start_ms;
+  int64_t orders[3];
+  double avg_distance_km[3];
+  double avg_eta_days[3];
+};
+
+// Ring of one-minute tumbling windows per thread shard. Each order costs three
+// relaxed atomic adds; a bucket is recycled when its minute comes round again,
+// so memory stays fixed however long the history. Sliding windows are sums
+// of the latest buckets, merged across shards at query time.
+class WindowAggregator
+{
+  // Bucket::window while one thread zeroes a recycled bucket
+  static constexpr int64_t RECYCLING = -2;
+
+  struct Bucket
+  {
+    atomic<int64_t> window{-1};
+    atomic<int64_t> orders[3] = {};
+    atomic<int64_t> distance_dam[3] = {};
+    atomic<int64_t> eta_days[3] = {};
+  };
+
+  struct Shard
+  {
+    Bucket buckets[Config::WINDOW_COUNT];
+  };
+
+  ThreadShards<Shard> shards_;
+
+  // This thread's bucket for `window`, zeroed if it held an older one; null
+  // if the window is older than the retained ones
+  Bucket *bucket(int64_t window)
+  {
+    Bucket &b = shards_.local().buckets[static_cast<size_t>(window) % Config::WINDOW_COUNT];
+    // A thread sharing the slot must not add before the bucket is zeroed,
+    // so the recycler marks it and the others wait for the new window
+    int64_t seen = b.window.load(memory_order_acquire);
+    while (seen < window)
+    {
+      if (seen == RECYCLING)
+      {
+        this_thread::yield();
+        seen = b.window.load(memory_order_acquire);
+      }
+      else if (b.window.compare_exchange_weak(seen, RECYCLING, memory_order_acquire))
+      {
+        for (int k = 0; k < 3; ++k)
+        {
+          b.orders[k].store(0, memory_order_relaxed);
+          b.distance_dam[k].store(0, memory_order_relaxed);
+          b.eta_days[k].store(0, memory_order_relaxed);
+        }
+        b.window.store(window, memory_order_release);
+        seen = window;
+      }
+    }
+    return seen == window ? &b : nullptr;
+  }
+
+public:
+  void observe(const PackedOrder &r, int64_t at_ms)
+  {
+    Bucket *b = bucket(at_ms / Config::WINDOW_MS);
+    if (!b)
+      return;
+    int k = static_cast<int>(r.kind());
+    b->orders[k].fetch_add(1, memory_order_relaxed);
+    b->distance_dam[k].fetch_add(r.distance_dam, memory_order_relaxed);
+    b->eta_days[k].fetch_add(r.eta_days(), memory_order_relaxed);
+  }
+
+  // Rows observed together: summed here, then added once per kind
+  void observe(const PackedOrder *rows, size_t n, int64_t at_ms)
+  {
+    Bucket *b = n ? bucket(at_ms / Config::WINDOW_MS) : nullptr;
+    if (!b)
+      return;
+    int64_t orders[3] = {}, distance[3] = {}, eta[3] = {};
+    for (size_t i = 0; i < n; ++i)
+    {
+      int k = static_cast<int>(rows[i].kind());
+      ++orders[k];
+      distance[k] += rows[i].distance_dam;
+      eta[k] += rows[i].eta_days();
+    }
+    for (int k = 0; k < 3; ++k)
+      if (orders[k])
+      {
+        b->orders[k].fetch_add(orders[k], memory_order_relaxed);
+        b->distance_dam[k].fetch_add(distance[k], memory_order_relaxed);
+        b->eta_days[k].fetch_add(eta[k], memory_order_relaxed);
+      }
+  }
+
+  // Merged totals of windows [first, last], as a single window starting at `first`
+  OrderWindow merge(int64_t first, int64_t last) const
+  {
+    int64_t orders[3] = {}, distance[3] = {}, eta[3] = {};
+    shards_.for_each([&](const Shard &shard)
+    {
+      for (const Bucket &b : shard.buckets)
+      {
+        int64_t w = b.window.load(memory_order_relaxed);
+        if (w < first || w > last)
+          continue;
+        for (int k = 0; k < 3; ++k)
+        {
+          orders[k] += b.orders[k].load(memory_order_relaxed);
+          distance[k] += b.distance_dam[k].load(memory_order_relaxed);
+          eta[k] += b.eta_days[k].load(memory_order_relaxed);
+        }
+      }
+    });
+
+    OrderWindow out{first * Config::WINDOW_MS, {}, {}, {}};
+    for (int k = 0; k < 3; ++k)
+    {
+      out.orders[k] = orders[k];
+      out.avg_distance_km[k] = orders[k] ? distance[k] / Config::DISTANCE_SCALE / orders[k] : 0.0;
+      out.avg_eta_days[k] = orders[k] ? static_cast<double>(eta[k]) / orders[k] : 0.0;
+    }
+    return out;
+  }
+
+  // The latest n tumbling windows up to `at_ms`, newest first
+  size_t latest(int64_t at_ms, size_t n, OrderWindow *out) const
+  {
+    int64_t current = at_ms / Config::WINDOW_MS;
+    n = min(n, Config::WINDOW_COUNT);
+    for (size_t i = 0; i < n; ++i)
+      out[i] = merge(current - static_cast<int64_t>(i), current - static_cast<int64_t>(i));
+    return n;
+  }
+
+  // Sliding window over the last `minutes` windows up to `at_ms`
+  OrderWindow sliding(int64_t at_ms, size_t windows) const
+  {
+    int64_t current = at_ms / Config::WINDOW_MS;
+    windows = max<size_t>(1, min(windows, Config::WINDOW_COUNT));
+    return merge(current - static_cast<int64_t>(windows) + 1, current);
+  }
+
+  size_t bytes() const
+  {
+    size_t n = 0;
+    shards_.for_each([&](Shard &) { n += sizeof(Shard); });
+    return n;
+  }
+
+  void clear()
+  {
+    shards_.for_each([](Shard &shard)
+    {
+      for (Bucket &b : shard.buckets)
+        b.window.store(-1, memory_order_relaxed);
+    });
+  }
+};
+
+// ==========================================
+// Quantile Sketches 📊
+// ==========================================
+
+// KLL sketch: level h holds items of weight 2^h with capacity shrinking by 2/3
+// per level below the top. A full level is sorted and every other item is
+// promoted, so memory is O(k log n) and sketches merge level by level.
+class KllSketch
+{
+  uint16_t k_;
+  uint64_t n_ = 0;
+  uint32_t coin_ = 0x9E3779B9;
+  size_t retained_ = 0;
+  size_t total_capacity_ = 0;
+  vector<vector<float>> levels_;
+  vector<size_t> capacity_; // per level, recomputed when a level is added
+
+  void add_level()
+  {
+    levels_.emplace_back();
+    capacity_.resize(levels_.size());
+    total_capacity_ = 0;
+    for (size_t h = 0; h < levels_.size(); ++h)
+    {
+      double depth = static_cast<double>(levels_.size() - 1 - h);
+      capacity_[h] = max<size_t>(8, static_cast<size_t>(ceil(k_ * pow(2.0 / 3.0, depth))));
+      total_capacity_ += capacity_[h];
+    }
+  }
+
+  void compress()
+  {
+    while (retained_ > total_capacity_)
+    {
+      size_t h = 0;
+      while (levels_[h].size() < capacity_[h])
+        ++h;
+      if (h + 1 == levels_.size())
+        add_level();
+
+      vector<float> &level = levels_[h];
+      sort(level.begin(), level.end());
+      // An odd item stays behind so the promoted pairs are exact
+      float leftover = level.back();
+      bool odd = level.size() % 2;
+      if (odd)
+        level.pop_back();
+      coin_ ^= coin_ << 13, coin_ ^= coin_ >> 17, coin_ ^= coin_ << 5;
+      for (size_t i = coin_ & 1; i < level.size(); i += 2)
+        levels_[h + 1].push_back(level[i]);
+      retained_ -= level.size() / 2;
+      level.clear();
+      if (odd)
+        level.push_back(leftover);
+    }
+  }
+
+public:
+  explicit KllSketch(uint16_t k = Config::SKETCH_K) : k_(k) { add_level(); }
+
+  void update(float value)
+  {
+    levels_[0].push_back(value);
+    ++n_;
+    if (++retained_ > total_capacity_)
+      compress();
+  }
+
+  void merge(const KllSketch &other)
+  {
+    while (levels_.size() < other.levels_.size())
+      add_level();
+    for (size_t h = 0; h < other.levels_.size(); ++h)
+      levels_[h].insert(levels_[h].end(), other.levels_[h].begin(), other.levels_[h].end());
+    n_ += other.n_;
+    retained_ += other.retained_;
+    compress();
+  }
+
+  uint64_t count() const { return n_; }
+
+  // Approximate q-quantile (0..1), NaN when empty
+  double quantile(double q) const
+  {
+    vector<pair<float, uint64_t>> items;
+    uint64_t total = 0;
+    for (size_t h = 0; h < levels_.size(); ++h)
+      for (float v : levels_[h])
+      {
+        items.emplace_back(v, uint64_t{1} << h);
+        total += uint64_t{1} << h;
+      }
+    if (items.empty())
+      return NAN;
+    sort(items.begin(), items.end());
+    double target = min(max(q, 0.0), 1.0) * static_cast<double>(total);
+    uint64_t seen = 0;
+    for (const auto &item : items)
+    {
+      seen += item.second;
+      if (static_cast<double>(seen) >= target)
+        return item.first;
+    }
+    return items.back().first;
+  }
+
+  size_t bytes() const
+  {
+    size_t n = sizeof(KllSketch) + capacity_.capacity() * sizeof(size_t) + levels_.capacity() * sizeof(vector<float>);
+    for (const auto &level : levels_)
+      n += level.capacity() * sizeof(float);
+    return n;
+  }
+
+  void clear()
+  {
+    n_ = 0;
+    retained_ = 0;
+    levels_.clear();
+    add_level();
+  }
+};
+
+namespace Metric
+{
+  constexpr int ETA_DAYS = 0;
+  constexpr int WEIGHT_KG = 1;
+  constexpr int DISTANCE_KM = 2;
+  constexpr int COUNT = 3;
+}
+
+// KLL sketches of ETA, weight and distance per transport kind, over the whole
+// history and per one-minute window (same ring as WindowAggregator). Each
+// thread updates its own shard under an uncontended lock; queries merge the
+// shards.
+class QuantileSketches
+{
+  static constexpr size_t CELLS = Metric::COUNT * 3;
+
+  struct Window
+  {
+    int64_t window = -1;
+    vector<KllSketch> sketches = vector<KllSketch>(CELLS, KllSketch(Config::WINDOW_SKETCH_K));
+  };
+
+  struct Shard
+  {
+    mutex lock;
+    vector<KllSketch> history = vector<KllSketch>(CELLS);
+    Window windows[Config::WINDOW_COUNT];
+  };
+
+  ThreadShards<Shard> shards_;
+
+  static size_t cell(int metric, int kind) { return static_cast<size_t>(metric * 3 + kind); }
+
+  template <class F>
+  KllSketch collect(int metric, int kind, F &&pick) const
+  {
+    KllSketch out;
+    shards_.for_each([&](Shard &shard)
+    {
+      lock_guard<mutex> guard(shard.lock);
+      for (int k = 0; k < 3; ++k)
+        if (kind < 0 || kind == k)
+          pick(shard, cell(metric, k), out);
+    });
+    return out;
+  }
+
+public:
+  void observe(const PackedOrder &r, int64_t at_ms) { observe(&r, 1, at_ms); }
+
+  // Rows observed together, under one lock
+  void observe(const PackedOrder *rows, size_t n, int64_t at_ms)
+  {
+    int64_t window = at_ms / Config::WINDOW_MS;
+    Shard &shard = shards_.local();
+    lock_guard<mutex> guard(shard.lock);
+    Window &w = shard.windows[static_cast<size_t>(window) % Config::WINDOW_COUNT];
+    if (w.window < window)
+    {
+      w.window = window;
+      for (auto &sketch : w.sketches)
+        sketch.clear();
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+      const PackedOrder &r = rows[i];
+      int kind = static_cast<int>(r.kind());
+      float values[Metric::COUNT] = {static_cast<float>(r.eta_days()), static_cast<float>(r.weight_kg()),
+                                     static_cast<float>(r.distance_km())};
+      for (int m = 0; m < Metric::COUNT; ++m)
+      {
+        shard.history[cell(m, kind)].update(values[m]);
+        if (w.window == window)
+          w.sketches[cell(m, kind)].update(values[m]);
+      }
+    }
+  }
+
+  // Over all orders; kind -1 covers every transport kind
+  double quantile(int metric, int kind, double q) const
+  {
+    return collect(metric, kind, [](Shard &shard, size_t c, KllSketch &out) { out.merge(shard.history[c]); })
+        .quantile(q);
+  }
+
+  // Over the last `windows` one-minute windows up to `at_ms`
+  double window_quantile(int metric, int kind, double q, int64_t at_ms, size_t windows) const
+  {
+    int64_t last = at_ms / Config::WINDOW_MS;
+    int64_t first = last - static_cast<int64_t>(max<size_t>(1, min(windows, Config::WINDOW_COUNT))) + 1;
+    return collect(metric, kind, [&](Shard &shard, size_t c, KllSketch &out)
+    {
+      for (const Window &w : shard.windows)
+        if (w.window >= first && w.window <= last)
+          out.merge(w.sketches[c]);
+    }).quantile(q);
+  }
+
+  size_t bytes() const
+  {
+    size_t n = 0;
+    shards_.for_each([&](Shard &shard)
+    {
+      lock_guard<mutex> guard(shard.lock);
+      n += sizeof(Shard);
+      for (const auto &sketch : shard.history)
+        n += sketch.bytes();
+      for (const Window &w : shard.windows)
+        for (const auto &sketch : w.sketches)
+          n += sketch.bytes();
+    });
+    return n;
+  }
+
+  void clear()
+  {
+    shards_.for_each([](Shard &shard)
+    {
+      lock_guard<mutex> guard(shard.lock);
+      for (auto &sketch : shard.history)
+        sketch.clear();
+      for (auto &w : shard.windows)
+        w.window = -1;
+    });
+  }
+};
+
+// ==========================================
+// Distinct Counts 🔢
+// ==========================================
+
+inline uint64_t mix64(uint64_t x)
+{
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+// HyperLogLog with one byte per register. Merging is a byte-wise max over a
+// flat array, which the compiler turns into packed max instructions.
+class HyperLogLog
+{
+  static constexpr size_t REGISTERS = size_t{1} << Config::HLL_PRECISION;
+  array<uint8_t, REGISTERS> registers_{};
+
+public:
+  void add(uint64_t value)
+  {
+    uint64_t h = mix64(value);
+    size_t index = h >> (64 - Config::HLL_PRECISION);
+    uint64_t rest = (h << Config::HLL_PRECISION) | (uint64_t{1} << (Config::HLL_PRECISION - 1));
+    uint8_t rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+    registers_[index] = max(registers_[index], rank);
+  }
+
+  void merge(const HyperLogLog &other)
+  {
+    uint8_t *dst = registers_.data();
+    const uint8_t *src = other.registers_.data();
+    for (size_t i = 0; i < REGISTERS; ++i)
+      dst[i] = dst[i] > src[i] ? dst[i] : src[i];
+  }
+
+  double estimate() const
+  {
+    const double m = static_cast<double>(REGISTERS);
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (uint8_t r : registers_)
+    {
+      sum += ldexp(1.0, -r);
+      zeros += r == 0;
+    }
+    double raw = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+    // Linear counting is more accurate while many registers are still empty
+    if (raw <= 2.5 * m && zeros)
+      return m * log(m / static_cast<double>(zeros));
+    return raw;
+  }
+
+  void clear() { registers_.fill(0); }
+};
+
+namespace Distinct
+{
+  constexpr int CUSTOMERS = 0;
+  constexpr int ROUTES = 1;
+}
+
+// Distinct customers and routes per transport kind, all-time and per day for
+// the last week. Fixed memory per thread shard; queries merge the shards.
+class DistinctCounters
+{
+  struct Day
+  {
+    int64_t day = -1;
+    HyperLogLog sketches[2][3];
+  };
+
+  struct Shard
+  {
+    mutex lock;
+    HyperLogLog total[2][3];
+    Day days[Config::DISTINCT_DAYS];
+  };
+
+  ThreadShards<Shard> shards_;
+
+public:
+  void observe(TransportKind kind, uint64_t customer_id, uint64_t destination_id, int64_t at_ms)
+  {
+    if (!customer_id && !destination_id)
+      return;
+    PackedOrder r{0, 0, 0, PackedOrder::field(static_cast<int>(kind), 2, PackedOrder::KIND_SHIFT)};
+    observe(&r, &customer_id, &destination_id, 1, at_ms);
+  }
+
+  // Rows observed together, under one lock; either id array may be null
+  void observe(const PackedOrder *rows, const uint64_t *customers, const uint64_t *destinations, size_t n,
+               int64_t at_ms)
+  {
+    if ((!customers && !destinations) || !n)
+      return;
+    int64_t day = at_ms / Config::DAY_MS;
+    const uint64_t *ids[2] = {customers, destinations};
+
+    Shard &shard = shards_.local();
+    lock_guard<mutex> guard(shard.lock);
+    Day &d = shard.days[static_cast<size_t>(day) % Config::DISTINCT_DAYS];
+    if (d.day < day)
+    {
+      d.day = day;
+      for (auto &row : d.sketches)
+        for (auto &sketch : row)
+          sketch.clear();
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+      int k = static_cast<int>(rows[i].kind());
+      for (int what = 0; what < 2; ++what)
+        if (ids[what] && ids[what][i])
+        {
+          shard.total[what][k].add(ids[what][i]);
+          if (d.day == day)
+            d.sketches[what][k].add(ids[what][i]);
+        }
+    }
+  }
+
+  // Estimated distinct ids; kind -1 = all kinds, days 0 = all time, otherwise
+  // the last `days` days up to `at_ms`
+  double estimate(int what, int kind, size_t days, int64_t at_ms) const
+  {
+    HyperLogLog merged;
+    int64_t last = at_ms / Config::DAY_MS;
+    int64_t first = last - static_cast<int64_t>(min(days, Config::DISTINCT_DAYS)) + 1;
+    shards_.for_each([&](Shard &shard)
+    {
+      lock_guard<mutex> guard(shard.lock);
+      for (int k = 0; k < 3; ++k)
+      {
+        if (kind >= 0 && kind != k)
+          continue;
+        if (days == 0)
+          merged.merge(shard.total[what][k]);
+        else
+          for (const Day &d : shard.days)
+            if (d.day >= first && d.day <= last)
+              merged.merge(d.sketches[what][k]);
+      }
+    });
+    return merged.estimate();
+  }
+
+  size_t bytes() const
+  {
+    size_t n = 0;
+    shards_.for_each([&](Shard &) { n += sizeof(Shard); });
+    return n;
+  }
+
+  void clear()
+  {
+    shards_.for_each([](Shard &shard)
+    {
+      lock_guard<mutex> guard(shard.lock);
+      for (auto &row : shard.total)
+        for (auto &sketch : row)
+          sketch.clear();
+      for (auto &d : shard.days)
+        d.day = -1;
+    });
+  }
+};
+
+// ==========================================
+// Top-K Tracking 🏆
+// ==========================================
+
+namespace TopMetric
+{
+  constexpr int HEAVIEST = 0;       // weight
+  constexpr int LONGEST = 1;        // distance
+  constexpr int SLOWEST_URGENT = 2; // ETA days of urgent orders
+  constexpr int COUNT = 3;
+}
+
+struct TopEntry
+{
+  int64_t value;    // fixed-point weight/distance or ETA days
+  uint64_t ordinal; // arrival number; later orders win ties
+  int32_t id;
+
+  bool operator>(const TopEntry &o) const { return value != o.value ? value > o.value : ordinal > o.ordinal; }
+};
+
+// Bounded min-heaps of the K largest entries per metric and transport kind,
+// one set per store segment in each thread shard. The top K of the live
+// orders is always among the per-segment top K of the live segments, so
+// retention drops whole segments' heaps and the answer stays exact. A query
+// merges at most shards * segments * 3 * K entries and never looks at the
+// stored records.
+class TopOrders
+{
+  using Heaps = array<array<vector<TopEntry>, 3>, TopMetric::COUNT>;
+
+  struct Shard
+  {
+    mutex lock;
+    map<uint64_t, Heaps> segments; // by the segment's first ordinal
+  };
+
+  ThreadShards<Shard> shards_;
+
+  static void offer(vector<TopEntry> &heap, const TopEntry &e)
+  {
+    auto greater = [](const TopEntry &a, const TopEntry &b) { return a > b; };
+    if (heap.size() < Config::TOP_K)
+    {
+      heap.push_back(e);
+      push_heap(heap.begin(), heap.end(), greater);
+    }
+    else if (e > heap.front())
+    {
+      pop_heap(heap.begin(), heap.end(), greater);
+      heap.back() = e;
+      push_heap(heap.begin(), heap.end(), greater);
+    }
+  }
+
+public:
+  // `segment` is the first ordinal of the store segment holding the order
+  void observe(const PackedOrder &r, uint64_t ordinal, uint64_t segment) { observe(&r, 1, ordinal, segment); }
+
+  // Rows with consecutive ordinals from `first` in one segment, under one lock
+  void observe(const PackedOrder *rows, size_t n, uint64_t first, uint64_t segment)
+  {
+    Shard &shard = shards_.local();
+    lock_guard<mutex> guard(shard.lock);
+    Heaps &heaps = shard.segments.try_emplace(shard.segments.end(), segment)->second;
+    for (size_t i = 0; i < n; ++i)
+    {
+      const PackedOrder &r = rows[i];
+      int k = static_cast<int>(r.kind());
+      offer(heaps[TopMetric::HEAVIEST][k], {r.weight_g, first + i, r.id});
+      offer(heaps[TopMetric::LONGEST][k], {r.distance_dam, first + i, r.id});
+      if (r.urgent())
+        offer(heaps[TopMetric::SLOWEST_URGENT][k], {r.eta_days(), first + i, r.id});
+    }
+  }
+
+  // Up to `limit` (at most TOP_K) entries, largest first; kind -1 = all kinds
+  vector<TopEntry> top(int metric, int kind, size_t limit) const
+  {
+    vector<TopEntry> all;
+    shards_.for_each([&](Shard &shard)
+    {
+      lock_guard<mutex> guard(shard.lock);
+      for (const auto &segment : shard.segments)
+        for (int k = 0; k < 3; ++k)
+          if (kind < 0 || kind == k)
+            all.insert(all.end(), segment.second[metric][k].begin(), segment.second[metric][k].end());
+    });
+    limit = min({limit, all.size(), Config::TOP_K});
+    partial_sort(all.begin(), all.begin() + static_cast<ptrdiff_t>(limit), all.end(),
+                 [](const TopEntry &a, const TopEntry &b) { return a > b; });
+    all.resize(limit);
+    return all;
+  }
+
+  // Forgets the segments before `segment`, the first ordinal of the oldest
+  // live one
+  void expire_before(uint64_t segment)
+  {
+    shards_.for_each([&](Shard &shard)
+    {
+      lock_guard<mutex> guard(shard.lock);
+      shard.segments.erase(shard.segments.begin(), shard.segments.lower_bound(segment));
+    });
+  }
+
+  size_t bytes() const
+  {
+    size_t n = 0;
+    shards_.for_each([&](Shard &shard)
+    {
+      lock_guard<mutex> guard(shard.lock);
+      n += sizeof(Shard);
+      for (const auto &segment : shard.segments)
+      {
+        n += sizeof(segment) + 4 * sizeof(void *); // map node
+        for (const auto &per_kind : segment.second)
+          for (const auto &heap : per_kind)
+            n += heap.capacity() * sizeof(TopEntry);
+      }
+    });
+    return n;
+  }
+
+  void clear()
+  {
+    shards_.for_each([](Shard &shard)
+    {
+      lock_guard<mutex> guard(shard.lock);
+      shard.segments.clear();
+    });
+  }
+};
+
+// ==========================================
+// External Sort 🗃️
+// ==========================================
+
+// Tournament tree for k-way merging. Each inner node keeps the loser of its
+// match, so after the winner's source advances only its path to the root is
+// replayed: log2(k) comparisons per row. `less` must be a strict total order
+// on source indices.
+template <class Less>
+class LoserTree
+{
+  vector<int> tree_; // [0] = winner, [1, k) = losers; leaves are k + source
+  size_t k_;
+  Less less_;
+
+  int build(size_t node)
+  {
+    if (node >= k_)
+      return static_cast<int>(node - k_);
+    int a = build(2 * node), b = build(2 * node + 1);
+    bool a_wins = less_(a, b);
+    tree_[node] = a_wins ? b : a;
+    return a_wins ? a : b;
+  }
+
+public:
+  LoserTree(size_t k, Less less) : tree_(max<size_t>(k, 1)), k_(k), less_(less)
+  {
+    if (k_)
+      tree_[0] = build(1);
+  }
+
+  int winner() const { return tree_[0]; }
+
+  // Call after the winning source moved to its next row
+  void replay()
+  {
+    int w = tree_[0];
+    for (size_t node = (static_cast<size_t>(w) + k_) / 2; node >= 1; node /= 2)
+      if (less_(tree_[node], w))
+        swap(tree_[node], w);
+    tree_[0] = w;
+  }
+};
+
+// Sort key of a row: ETA days, then distance, in 40 bits. Negative truck
+// days sort first; ETAs stay within -17..28 days, so +128 fits 8 bits.
+inline uint64_t eta_distance_key(uint32_t meta, int32_t distance_dam)
+{
+  uint64_t eta = static_cast<uint64_t>(PackedOrder{0, 0, 0, meta}.eta_days() + 128) & 0xFF;
+  return eta << 32 | (static_cast<uint32_t>(distance_dam) ^ 0x80000000u);
+}
+
+// Sorts an order file by ETA, then distance, in bounded memory. Worker
+// threads take chunks of the input, radix-sort them and write sorted runs to
+// tmp_dir; the runs are then merged through a loser tree with one block
+// buffered per run. Ties keep input order. Returns the row count, or -1 if a
+// file cannot be read or written.
+inline int64_t external_sort(const string &in_path, const string &out_path, const string &tmp_dir,
+                             size_t memory_bytes, unsigned threads, bool encode_output = false)
+{
+  threads = max(1u, threads);
+  // A worker holds its columns, a block and the keys: about 40 bytes a row.
+  // Row offsets take the low 24 bits of a key.
+  size_t chunk_rows = clamp(memory_bytes / (threads * size_t{40}), Config::SEGMENT_ROWS, size_t{1} << 24);
+  SegmentReader input;
+  if (!input.open(in_path))
+    return -1;
+
+  mutex input_lock;
+  atomic<bool> failed{false};
+  vector<string> runs;
+  string prefix = tmp_dir + "/sort-" + to_string(::getpid()) + "-";
+
+  auto generate_runs = [&]()
+  {
+    OrderBlock chunk, block;
+    vector<uint64_t> keys;
+    for (;;)
+    {
+      string path;
+      {
+        lock_guard<mutex> guard(input_lock);
+        chunk.resize(0);
+        int status = 1;
+        while (!failed && chunk.size() + Config::SEGMENT_ROWS <= chunk_rows && (status = input.next(block)) == 1)
+        {
+          chunk.ids.insert(chunk.ids.end(), block.ids.begin(), block.ids.end());
+          chunk.weight_g.insert(chunk.weight_g.end(), block.weight_g.begin(), block.weight_g.end());
+          chunk.distance_dam.insert(chunk.distance_dam.end(), block.distance_dam.begin(), block.distance_dam.end());
+          chunk.meta.insert(chunk.meta.end(), block.meta.begin(), block.meta.end());
+        }
+        if (status < 0)
+          failed = true;
+        if (failed || chunk.size() == 0)
+          return;
+        path = prefix + to_string(runs.size()) + ".run";
+        runs.push_back(path);
+      }
+
+      keys.resize(chunk.size());
+      for (size_t i = 0; i < chunk.size(); ++i)
+        keys[i] = eta_distance_key(chunk.meta[i], chunk.distance_dam[i]) << 24 | i;
+      radix_sort(keys);
+      SegmentWriter run;
+      run.open(path);
+      for (uint64_t key : keys)
+        run.append(chunk.row(key & 0xFFFFFF));
+      if (!run.close())
+        failed = true;
+    }
+  };
+
+  vector<thread> workers;
+  for (unsigned t = 1; t < threads; ++t)
+    workers.emplace_back(generate_runs);
+  generate_runs();
+  for (auto &w : workers)
+    w.join();
+
+  struct Source
+  {
+    SegmentReader reader;
+    OrderBlock block;
+    size_t pos = 0;
+    bool done = false;
+    uint64_t key = 0;
+  };
+  vector<Source> sources(runs.size());
+  auto load = [&](Source &src)
+  {
+    int status;
+    src.pos = 0;
+    while ((status = src.reader.next(src.block)) == 1 && src.block.size() == 0)
+      ;
+    if (status < 0)
+      failed = true;
+    src.done = status != 1;
+  };
+  auto advance = [&](Source &src)
+  {
+    if (++src.pos == src.block.size())
+      load(src);
+    if (!src.done)
+      src.key = eta_distance_key(src.block.meta[src.pos], src.block.distance_dam[src.pos]);
+  };
+  for (size_t i = 0; i < runs.size() && !failed; ++i)
+  {
+    if (!sources[i].reader.open(runs[i]))
+      failed = true;
+    load(sources[i]);
+    if (!sources[i].done)
+      sources[i].key = eta_distance_key(sources[i].block.meta[0], sources[i].block.distance_dam[0]);
+  }
+
+  int64_t rows = 0;
+  SegmentWriter out;
+  out.set_encoded(encode_output);
+  if (!failed && out.open(out_path))
+  {
+    auto less = [&](int a, int b)
+    {
+      const Source &x = sources[static_cast<size_t>(a)], &y = sources[static_cast<size_t>(b)];
+      if (x.done || y.done)
+        return x.done == y.done ? a < b : y.done;
+      return x.key < y.key || (x.key == y.key && a < b);
+    };
+    LoserTree<decltype(less)> tree(sources.size(), less);
+    while (!sources.empty() && !sources[static_cast<size_t>(tree.winner())].done)
+    {
+      Source &src = sources[static_cast<size_t>(tree.winner())];
+      out.append(src.block.row(src.pos));
+      ++rows;
+      advance(src);
+      tree.replay();
+    }
+  }
+  else
+    failed = true;
+  if (!out.close())
+    failed = true;
+
+  for (const auto &path : runs)
+    ::unlink(path.c_str());
+  return failed ? -1 : rows;
+}
+
+// ==========================================
+// Arrow IPC Export 🏹
+// ==========================================
+
+// Front-to-back flatbuffer writer, just enough for Arrow metadata. A parent
+// is written before its children and its offset fields are linked to them
+// afterwards, so every uoffset points forward as the format requires.
+// Scalars are stored in host order, which must be little-endian.
+class FlatWriter
+{
+public:
+  struct Slot
+  {
+    int index;
+    int size; // bytes; 0 = offset to an object, set with link()
+    uint64_t value;
+  };
+
+  struct Table
+  {
+    size_t pos;
+    array<size_t, 8> field{}; // position of each slot's value
+  };
+
+  string data;
+
+  // The root offset comes first; link(0, table) sets it
+  FlatWriter() { put<uint32_t>(0); }
+
+  void align(size_t a) { data.resize((data.size() + a - 1) / a * a, '\0'); }
+
+  template <class T>
+  void put(T v) { data.append(reinterpret_cast<const char *>(&v), sizeof v); }
+
+  template <class T>
+  void put_at(size_t pos, T v) { memcpy(&data[pos], &v, sizeof v); }
+
+  Table table(initializer_list<Slot> slots)
+  {
+    int count = 0;
+    for (const auto &s : slots)
+      count = max(count, s.index + 1);
+    align(2);
+    size_t vtable = data.size();
+    data.resize(vtable + 4 + 2 * static_cast<size_t>(count), '\0');
+    align(8);
+    Table t;
+    t.pos = data.size();
+    put<int32_t>(static_cast<int32_t>(t.pos - vtable));
+    for (const auto &s : slots)
+    {
+      size_t size = s.size ? static_cast<size_t>(s.size) : 4;
+      align(size);
+      t.field[static_cast<size_t>(s.index)] = data.size();
+      put_at<uint16_t>(vtable + 4 + 2 * static_cast<size_t>(s.index), static_cast<uint16_t>(data.size() - t.pos));
+      data.append(reinterpret_cast<const char *>(&s.value), size);
+    }
+    put_at<uint16_t>(vtable, static_cast<uint16_t>(4 + 2 * count));
+    put_at<uint16_t>(vtable + 2, static_cast<uint16_t>(data.size() - t.pos));
+    return t;
+  }
+
+  // Vector of `count` table offsets, filled with link(element(vec, i), table)
+  size_t offsets(size_t count)
+  {
+    align(4);
+    size_t pos = data.size();
+    put<uint32_t>(static_cast<uint32_t>(count));
+    data.resize(data.size() + 4 * count, '\0');
+    return pos;
+  }
+
+  static size_t element(size_t vec, size_t i) { return vec + 4 + 4 * i; }
+
+  // Vector of structs, elements 8-byte aligned
+  size_t structs(const void *items, size_t count, size_t size)
+  {
+    while ((data.size() + 4) % 8)
+      data.push_back('\0');
+    size_t pos = data.size();
+    put<uint32_t>(static_cast<uint32_t>(count));
+    data.append(static_cast<const char *>(items), count * size);
+    return pos;
+  }
+
+  size_t text(string_view s)
+  {
+    align(4);
+    size_t pos = data.size();
+    put<uint32_t>(static_cast<uint32_t>(s.size()));
+    data.append(s.data(), s.size());
+    data.push_back('\0');
+    return pos;
+  }
+
+  void link(size_t at, size_t target) { put_at<uint32_t>(at, static_cast<uint32_t>(target - at)); }
+};
+
+namespace Arrow
+{
+  constexpr uint64_t V5 = 4;                          // MetadataVersion
+  constexpr uint64_t SCHEMA = 1, RECORD_BATCH = 3;    // MessageHeader
+  constexpr uint64_t INT = 2, BOOL = 6;               // Type
+  constexpr int32_t CONTINUATION = -1;
+  constexpr char MAGIC[8] = {'A', 'R', 'R', 'O', 'W', '1', 0, 0};
+
+  struct Column
+  {
+    string_view name;
+    uint64_t type;
+    uint64_t bit_width;
+    bool is_signed;
+  };
+
+  // Quantized weight and distance keep the store's units (g, 10 m);
+  // flags is the raw decision word (see PackedOrder)
+  constexpr Column COLUMNS[] = {{"id", INT, 32, true},     {"weight_g", INT, 32, true}, {"distance_dam", INT, 32, true},
+                                {"urgent", BOOL, 0, false}, {"kind", INT, 8, false},     {"eta_days", INT, 8, true},
+                                {"flags", INT, 32, false}};
+  constexpr size_t COLUMN_COUNT = sizeof COLUMNS / sizeof COLUMNS[0];
+
+  struct Block
+  {
+    int64_t offset;
+    int32_t metadata_length;
+    int32_t pad;
+    int64_t body_length;
+  };
+}
+
+// Writes the order columns as Arrow IPC, stream or file format, one record
+// batch per segment. Stored columns (id, weight, distance, flags) are written
+// from the segment memory as they are; urgent, kind and ETA are unpacked
+// from the flags column by column into a scratch buffer.
+class ArrowWriter
+{
+  int fd_ = -1;
+  bool file_format_ = false;
+  bool ok_ = true;
+  int64_t position_ = 0;
+  vector<Arrow::Block> blocks_;
+  vector<uint8_t> scratch_;
+
+  static size_t padded(size_t n) { return (n + 7) / 8 * 8; }
+
+  void emit(const void *data, size_t n)
+  {
+    ok_ = ok_ && write_all(fd_, data, n);
+    position_ += static_cast<int64_t>(n);
+  }
+
+  void emit_padding(size_t n)
+  {
+    static const char zeros[8] = {};
+    emit(zeros, n);
+  }
+
+  static size_t write_schema(FlatWriter &fb)
+  {
+    auto schema = fb.table({{0, 2, 0}, {1, 0, 0}});
+    size_t fields = fb.offsets(Arrow::COLUMN_COUNT);
+    fb.link(schema.field[1], fields);
+    for (size_t i = 0; i < Arrow::COLUMN_COUNT; ++i)
+    {
+      const Arrow::Column &col = Arrow::COLUMNS[i];
+      auto field = fb.table({{0, 0, 0}, {1, 1, 0}, {2, 1, col.type}, {3, 0, 0}, {5, 0, 0}});
+      fb.link(FlatWriter::element(fields, i), field.pos);
+      fb.link(field.field[0], fb.text(col.name));
+      size_t type =
+          col.type == Arrow::INT ? fb.table({{0, 4, col.bit_width}, {1, 1, col.is_signed}}).pos : fb.table({}).pos;
+      fb.link(field.field[3], type);
+      fb.link(field.field[5], fb.offsets(0));
+    }
+    return schema.pos;
+  }
+
+  // Continuation marker, metadata length, then the flatbuffer padded to 8
+  int32_t write_message(FlatWriter &fb)
+  {
+    fb.align(8);
+    int32_t prefix[2] = {Arrow::CONTINUATION, static_cast<int32_t>(fb.data.size())};
+    emit(prefix, sizeof prefix);
+    emit(fb.data.data(), fb.data.size());
+    return static_cast<int32_t>(sizeof prefix + fb.data.size());
+  }
+
+public:
+  ArrowWriter() = default;
+  ArrowWriter(const ArrowWriter &) = delete;
+  ArrowWriter &operator=(const ArrowWriter &) = delete;
+  ~ArrowWriter() { close(); }
+
+  // Creates the file and writes the schema
+  bool open(const string &path, bool file_format)
+  {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ok_ = fd_ >= 0;
+    if (!ok_)
+      return false;
+    file_format_ = file_format;
+    if (file_format_)
+      emit(Arrow::MAGIC, sizeof Arrow::MAGIC);
+    FlatWriter fb;
+    auto message = fb.table({{0, 2, Arrow::V5}, {1, 1, Arrow::SCHEMA}, {2, 0, 0}, {3, 8, 0}});
+    fb.link(0, message.pos);
+    fb.link(message.field[2], write_schema(fb));
+    write_message(fb);
+    return ok_;
+  }
+
+  void write_batch(const int32_t *ids, const int32_t *weight_g, const int32_t *distance_dam, const uint32_t *meta,
+                   size_t n)
+  {
+    using P = PackedOrder;
+    size_t bits = (n + 7) / 8;
+    scratch_.assign(padded(bits) + 2 * padded(n), 0);
+    uint8_t *urgent = scratch_.data(), *kind = urgent + padded(bits), *eta = kind + padded(n);
+    for (size_t i = 0; i < n; ++i)
+      kind[i] = static_cast<uint8_t>((meta[i] >> P::KIND_SHIFT) & 3);
+    for (size_t i = 0; i < n; ++i)
+      eta[i] = static_cast<uint8_t>(P{0, 0, 0, meta[i]}.eta_days());
+    for (size_t i = 0; i < n; ++i)
+      urgent[i >> 3] = static_cast<uint8_t>(urgent[i >> 3] | ((meta[i] >> P::URGENT_BIT) & 1) << (i & 7));
+
+    struct Piece
+    {
+      const void *data;
+      size_t length;
+    };
+    const Piece pieces[Arrow::COLUMN_COUNT] = {{ids, n * 4}, {weight_g, n * 4}, {distance_dam, n * 4}, {urgent, bits},
+                                               {kind, n},    {eta, n},          {meta, n * 4}};
+    // Per column: an empty validity bitmap (no nulls), then the values
+    int64_t buffers[Arrow::COLUMN_COUNT * 2][2];
+    int64_t nodes[Arrow::COLUMN_COUNT][2];
+    int64_t body = 0;
+    for (size_t c = 0; c < Arrow::COLUMN_COUNT; ++c)
+    {
+      buffers[2 * c][0] = body;
+      buffers[2 * c][1] = 0;
+      buffers[2 * c + 1][0] = body;
+      buffers[2 * c + 1][1] = static_cast<int64_t>(pieces[c].length);
+      body += static_cast<int64_t>(padded(pieces[c].length));
+      nodes[c][0] = static_cast<int64_t>(n);
+      nodes[c][1] = 0;
+    }
+
+    FlatWriter fb;
+    auto message =
+        fb.table({{0, 2, Arrow::V5}, {1, 1, Arrow::RECORD_BATCH}, {2, 0, 0}, {3, 8, static_cast<uint64_t>(body)}});
+    fb.link(0, message.pos);
+    auto batch = fb.table({{0, 8, n}, {1, 0, 0}, {2, 0, 0}});
+    fb.link(message.field[2], batch.pos);
+    fb.link(batch.field[1], fb.structs(nodes, Arrow::COLUMN_COUNT, sizeof nodes[0]));
+    fb.link(batch.field[2], fb.structs(buffers, 2 * Arrow::COLUMN_COUNT, sizeof buffers[0]));
+    int64_t offset = position_;
+    int32_t metadata_length = write_message(fb);
+    for (const Piece &piece : pieces)
+    {
+      emit(piece.data, piece.length);
+      emit_padding(padded(piece.length) - piece.length);
+    }
+    blocks_.push_back({offset, metadata_length, 0, body});
+  }
+
+  // Ends the stream (and writes the footer in file format); false if any write failed
+  bool close()
+  {
+    if (fd_ < 0)
+      return ok_;
+    int32_t end_of_stream[2] = {Arrow::CONTINUATION, 0};
+    emit(end_of_stream, sizeof end_of_stream);
+    if (file_format_)
+    {
+      FlatWriter fb;
+      auto footer = fb.table({{0, 2, Arrow::V5}, {1, 0, 0}, {2, 0, 0}, {3, 0, 0}});
+      fb.link(0, footer.pos);
+      fb.link(footer.field[1], write_schema(fb));
+      fb.link(footer.field[2], fb.structs(nullptr, 0, sizeof(Arrow::Block)));
+      fb.link(footer.field[3], fb.structs(blocks_.data(), blocks_.size(), sizeof(Arrow::Block)));
+      int32_t length = static_cast<int32_t>(fb.data.size());
+      emit(fb.data.data(), fb.data.size());
+      emit(&length, sizeof length);
+      emit(Arrow::MAGIC, 6);
+    }
+    ok_ = ::close(fd_) == 0 && ok_;
+    fd_ = -1;
+    return ok_;
+  }
+};
+
+// ==========================================
+// Wire Format 📦
+// ==========================================
+
+// Binary batches for feeds in and decisions out: a 24-byte header, then
+// fixed-width little-endian columns, each padded to 8 bytes. Frames can be
+// concatenated, so one buffer, file, pipe or socket carries any number.
+//   orders:    weight kg (f64), distance km (f64), customer id (u64),
+//              destination id (u64), order id (i32), urgent (u8, 0 or 1)
+//   decisions: order id (i32), weight g (i32), distance 10 m (i32),
+//              decision word (u32, the PackedOrder meta layout)
+// With the ENCODED flag the integer columns use the column codecs instead:
+// a decision frame holds the five encode_records columns, and an order frame
+// keeps weights and distances as plain f64 (so replay stays bit-exact),
+// followed by encoded ids, customer and destination ids as low and high
+// halves, and urgent.
+struct WireHeader
+{
+  char magic[4];
+  uint16_t version;
+  uint16_t type;
+  uint32_t rows;
+  uint32_t flags;
+  uint64_t body_length;
+};
+static_assert(sizeof(WireHeader) == 24, "wire header is 24 bytes");
+// Frames, journals and Arrow exports are written straight from host memory
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "wire formats assume a little-endian host");
+
+namespace Wire
+{
+  constexpr char MAGIC[4] = {'T', 'O', 'S', 'W'};
+  constexpr uint16_t VERSION = 1;
+  constexpr uint16_t ORDERS = 1;
+  constexpr uint16_t DECISIONS = 2;
+  constexpr uint32_t MAX_ROWS = 1u << 20;
+  constexpr uint32_t ENCODED = 1;
+
+  inline size_t padded(size_t n) { return (n + 7) / 8 * 8; }
+  inline size_t orders_body(size_t rows) { return 32 * rows + padded(4 * rows) + padded(rows); }
+  inline size_t decisions_body(size_t rows) { return 4 * padded(4 * rows); }
+
+  inline WireHeader header(uint16_t type, size_t rows)
+  {
+    WireHeader h{};
+    memcpy(h.magic, MAGIC, sizeof h.magic);
+    h.version = VERSION;
+    h.type = type;
+    h.rows = static_cast<uint32_t>(rows);
+    h.body_length = type == ORDERS ? orders_body(rows) : decisions_body(rows);
+    return h;
+  }
+
+  // Body length of a supported frame, or -1; a frame may carry no rows
+  inline int64_t body_length(const WireHeader &h)
+  {
+    if (memcmp(h.magic, MAGIC, sizeof h.magic) != 0 || h.version != VERSION || h.rows > MAX_ROWS ||
+        (h.type != ORDERS && h.type != DECISIONS))
+      return -1;
+    if (h.flags == ENCODED)
+    {
+      size_t column = sizeof(ColumnHeader) + padded(4 * h.rows);
+      size_t limit = h.type == ORDERS ? 16 * size_t{h.rows} + 6 * column : Codec::RECORD_COLUMNS * column;
+      return h.body_length <= limit && h.body_length % 8 == 0 ? static_cast<int64_t>(h.body_length) : -1;
+    }
+    if (h.flags)
+      return -1;
+    size_t expected = h.type == ORDERS ? orders_body(h.rows) : decisions_body(h.rows);
+    return h.body_length == expected ? static_cast<int64_t>(expected) : -1;
+  }
+}
+
+// Column views into the body of an order frame; the integer columns of an
+// encoded frame are decoded into `decoded`
+struct OrderFrame
+{
+  size_t rows = 0;
+  const double *weights = nullptr;
+  const double *distances = nullptr;
+  const uint64_t *customers = nullptr;
+  const uint64_t *destinations = nullptr;
+  const int32_t *ids = nullptr;
+  const bool *urgent = nullptr;
+  vector<uint64_t> decoded;
+};
+
+// Decodes the next column of an encoded body at `at`; false if it does not fit
+inline bool next_column(const WireHeader &h, const char *body, size_t &at, uint32_t *values)
+{
+  ColumnHeader ch;
+  if (h.body_length - at < sizeof ch)
+    return false;
+  memcpy(&ch, body + at, sizeof ch);
+  size_t size = encoded_size(ch, h.rows);
+  if (!size || size > h.body_length - at || !decode_column(ch, body + at + sizeof ch, values, h.rows))
+    return false;
+  at += size;
+  return true;
+}
+
+// Points `frame` at the columns of an 8-byte aligned body, decoding them if
+// the frame is encoded; false if an urgent value is not 0 or 1 or an encoded
+// column does not fit
+inline bool decode_order_frame(const WireHeader &h, const char *body, OrderFrame &frame)
+{
+  size_t n = h.rows;
+  frame.rows = n;
+  if (h.flags == Wire::ENCODED)
+  {
+    // customers, destinations, ids, urgent bytes, then two 32-bit halves
+    size_t words = 2 * n + (n + 1) / 2 + (n + 7) / 8;
+    frame.decoded.resize(words + n);
+    uint64_t *customers = frame.decoded.data(), *destinations = customers + n;
+    uint32_t *ids = reinterpret_cast<uint32_t *>(destinations + n);
+    uint8_t *urgent = reinterpret_cast<uint8_t *>(customers + 2 * n + (n + 1) / 2);
+    uint32_t *low = reinterpret_cast<uint32_t *>(customers + words), *high = low + n;
+    size_t at = 16 * n;
+    if (h.body_length < at || !next_column(h, body, at, ids))
+      return false;
+    for (uint64_t *wide : {customers, destinations})
+    {
+      if (!next_column(h, body, at, low) || !next_column(h, body, at, high))
+        return false;
+      for (size_t i = 0; i < n; ++i)
+        wide[i] = static_cast<uint64_t>(high[i]) << 32 | low[i];
+    }
+    if (!next_column(h, body, at, low))
+      return false;
+    uint32_t any = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      any |= low[i];
+      urgent[i] = static_cast<uint8_t>(low[i]);
+    }
+    frame.weights = reinterpret_cast<const double *>(body);
+    frame.distances = reinterpret_cast<const double *>(body + 8 * n);
+    frame.customers = customers;
+    frame.destinations = destinations;
+    frame.ids = reinterpret_cast<const int32_t *>(ids);
+    frame.urgent = reinterpret_cast<const bool *>(urgent);
+    return any <= 1;
+  }
+  frame.weights = reinterpret_cast<const double *>(body);
+  frame.distances = reinterpret_cast<const double *>(body + 8 * n);
+  frame.customers = reinterpret_cast<const uint64_t *>(body + 16 * n);
+  frame.destinations = reinterpret_cast<const uint64_t *>(body + 24 * n);
+  frame.ids = reinterpret_cast<const int32_t *>(body + 32 * n);
+  const uint8_t *urgent = reinterpret_cast<const uint8_t *>(body + 32 * n + Wire::padded(4 * n));
+  uint8_t any = 0;
+  for (size_t i = 0; i < n; ++i)
+    any |= urgent[i];
+  frame.urgent = reinterpret_cast<const bool *>(urgent);
+  return any <= 1;
+}
+
+// Appends an order frame, optionally encoded; customers and destinations may
+// be nullptr (0 = unknown)
+inline void encode_order_frame(string &out, const int32_t *ids, const double *weights, const double *distances,
+                               const bool *urgent, const uint64_t *customers, const uint64_t *destinations, size_t n,
+                               bool encoded = false)
+{
+  WireHeader h = Wire::header(Wire::ORDERS, n);
+  if (encoded)
+  {
+    static thread_local vector<uint32_t> scratch;
+    size_t at = out.size();
+    out.append(reinterpret_cast<const char *>(&h), sizeof h);
+    out.append(reinterpret_cast<const char *>(weights), 8 * n);
+    out.append(reinterpret_cast<const char *>(distances), 8 * n);
+    encode_column(out, reinterpret_cast<const uint32_t *>(ids), n);
+    scratch.resize(n);
+    for (const uint64_t *wide : {customers, destinations})
+      for (int shift : {0, 32})
+      {
+        for (size_t i = 0; i < n; ++i)
+          scratch[i] = wide ? static_cast<uint32_t>(wide[i] >> shift) : 0;
+        encode_column(out, scratch.data(), n);
+      }
+    for (size_t i = 0; i < n; ++i)
+      scratch[i] = urgent[i];
+    encode_column(out, scratch.data(), n);
+    h.flags = Wire::ENCODED;
+    h.body_length = out.size() - at - sizeof h;
+    memcpy(&out[at], &h, sizeof h);
+    return;
+  }
+  size_t at = out.size();
+  out.resize(at + sizeof h + h.body_length, '\0');
+  char *p = &out[at];
+  memcpy(p, &h, sizeof h);
+  p += sizeof h;
+  memcpy(p, weights, 8 * n);
+  memcpy(p + 8 * n, distances, 8 * n);
+  if (customers)
+    memcpy(p + 16 * n, customers, 8 * n);
+  if (destinations)
+    memcpy(p + 24 * n, destinations, 8 * n);
+  memcpy(p + 32 * n, ids, 4 * n);
+  memcpy(p + 32 * n + Wire::padded(4 * n), urgent, n);
+}
+
+// Appends a decision frame straight from record columns, optionally encoded
+inline void encode_decision_frame(string &out, const int32_t *ids, const int32_t *weight_g,
+                                  const int32_t *distance_dam, const uint32_t *meta, size_t n, bool encoded = false)
+{
+  WireHeader h = Wire::header(Wire::DECISIONS, n);
+  if (encoded)
+  {
+    size_t at = out.size();
+    out.append(reinterpret_cast<const char *>(&h), sizeof h);
+    encode_records(out, ids, weight_g, distance_dam, meta, n);
+    h.flags = Wire::ENCODED;
+    h.body_length = out.size() - at - sizeof h;
+    memcpy(&out[at], &h, sizeof h);
+    return;
+  }
+  size_t at = out.size();
+  out.resize(at + sizeof h + h.body_length, '\0');
+  char *p = &out[at];
+  memcpy(p, &h, sizeof h);
+  p += sizeof h;
+  const void *columns[] = {ids, weight_g, distance_dam, meta};
+  for (const void *column : columns)
+  {
+    memcpy(p, column, 4 * n);
+    p += Wire::padded(4 * n);
+  }
+}
+
+// Decodes a decision frame body (plain or encoded) into `block`; false if
+// the columns do not fit the body
+inline bool decode_decision_frame(const WireHeader &h, const char *body, OrderBlock &block)
+{
+  static thread_local vector<uint32_t> kind;
+  size_t n = h.rows;
+  block.resize(n);
+  kind.resize(n);
+  uint32_t *columns[] = {reinterpret_cast<uint32_t *>(block.ids.data()),
+                         reinterpret_cast<uint32_t *>(block.weight_g.data()),
+                         reinterpret_cast<uint32_t *>(block.distance_dam.data()), block.meta.data(), kind.data()};
+  size_t at = 0;
+  if (h.flags != Wire::ENCODED)
+  {
+    for (int c = 0; c < SegmentFile::COLUMNS; ++c, at += Wire::padded(4 * n))
+      memcpy(columns[c], body + at, 4 * n);
+    return true;
+  }
+  for (uint32_t *column : columns)
+    if (!next_column(h, body, at, column))
+      return false;
+  return merge_kind(block.meta.data(), kind.data(), n);
+}
+
+// ==========================================
+// Journal ✍️
+// ==========================================
+
+// The journal is a stream of wire frames: every ingest call appends an order
+// frame with its inputs and a decision frame with the results. Frames are
+// copied into a ring of buffers that a backend writes and fdatasyncs off the
+// ingest path; orders count as durable once every buffer up to theirs is.
+// While a write is in flight the next buffer keeps filling (group commit),
+// so the syscall count drops as load grows.
+class JournalBackend
+{
+public:
+  virtual ~JournalBackend() = default;
+  // Writes buffer `index` at `offset` and syncs it; reports through Journal::complete
+  virtual bool submit(size_t index, const char *data, size_t length, uint64_t offset) = 0;
+};
+
+class Journal
+{
+public:
+  using Callback = void (*)(int64_t durable_orders, void *context);
+
+  enum Backend
+  {
+    AUTO = 0,
+    IO_URING = 1,
+    THREADS = 2
+  };
+
+private:
+  enum class State : uint8_t
+  {
+    Free,
+    Filling,
+    InFlight,
+    Done
+  };
+
+  struct Buffer
+  {
+    char *data = nullptr;
+    size_t used = 0;
+    int64_t orders_through = 0; // orders whose frames end in or before this buffer
+    State state = State::Free;
+  };
+
+  mutex lock_;
+  condition_variable changed_;
+  vector<Buffer> buffers_;
+  char *memory_ = nullptr;
+  size_t fill_ = 0;
+  size_t head_ = 0;
+  size_t in_flight_ = 0;
+  uint64_t offset_ = 0;
+  int64_t appended_ = 0;
+  atomic<int64_t> durable_{0};
+  atomic<bool> failed_{false};
+  int fd_ = -1;
+  int event_fd_ = -1;
+  atomic<Callback> callback_{nullptr};
+  atomic<void *> context_{nullptr};
+  unique_ptr<JournalBackend> backend_;
+
+  void submit_locked(size_t index)
+  {
+    Buffer &b = buffers_[index];
+    b.state = State::InFlight;
+    ++in_flight_;
+    uint64_t at = offset_;
+    offset_ += b.used;
+    fill_ = (index + 1) % buffers_.size();
+    if (!backend_->submit(index, b.data, b.used, at))
+    {
+      failed_ = true;
+      b.state = State::Done;
+      --in_flight_;
+      free_done_locked();
+      changed_.notify_all();
+    }
+  }
+
+  // Frees the buffers at the head that are done, in file order
+  void free_done_locked()
+  {
+    while (buffers_[head_].state == State::Done)
+    {
+      Buffer &b = buffers_[head_];
+      if (!failed_)
+        durable_ = b.orders_through;
+      b.used = 0;
+      b.state = State::Free;
+      head_ = (head_ + 1) % buffers_.size();
+    }
+  }
+
+public:
+  Journal() = default;
+  Journal(const Journal &) = delete;
+  Journal &operator=(const Journal &) = delete;
+  ~Journal() { close(); }
+
+  // Appends to `path` after cutting it back to its last whole frame, as found
+  // by scanning from `scan_from` (0, or the offset a checkpoint covers once
+  // the prefix before it is released); returns the backend in use, or -1
+  int open(const string &path, int backend, uint64_t scan_from = 0);
+
+  // End of the whole frames in [at, end) of `fd`: a frame counts once its
+  // header is valid and its body fits, and an order frame only together with
+  // the decision frames written with it. A torn last write or a zero-filled
+  // gap left by buffers completing out of order ends the scan.
+  static off_t whole_frames_end(int fd, off_t at, off_t end)
+  {
+    off_t good = at;
+    uint64_t pending = 0; // rows of the last order frame still without decisions
+    WireHeader h;
+    while (end - at >= static_cast<off_t>(sizeof h) && ::pread(fd, &h, sizeof h, at) == sizeof h)
+    {
+      int64_t length = Wire::body_length(h);
+      if (length < 0 || end - at - static_cast<off_t>(sizeof h) < length)
+        break;
+      if (h.type == Wire::ORDERS ? pending != 0 : h.rows == 0 || h.rows > pending)
+        break;
+      pending = h.type == Wire::ORDERS ? h.rows : pending - h.rows;
+      at += static_cast<off_t>(sizeof h) + length;
+      if (!pending)
+        good = at;
+    }
+    return good;
+  }
+
+  void set_callback(Callback callback, void *context)
+  {
+    context_ = context;
+    callback_ = callback;
+  }
+
+  int event_fd() const { return event_fd_; }
+  int64_t appended() const { return appended_; }
+  int64_t durable() const { return durable_; }
+  bool failed() const { return failed_; }
+
+  // Copies frames holding `orders` orders; blocks only while every buffer is in flight
+  void append(const char *data, size_t length, int64_t orders)
+  {
+    unique_lock<mutex> guard(lock_);
+    int64_t before = appended_;
+    appended_ += orders;
+    do
+    {
+      changed_.wait(guard,
+                    [&] { return buffers_[fill_].state == State::Free || buffers_[fill_].state == State::Filling; });
+      Buffer &b = buffers_[fill_];
+      b.state = State::Filling;
+      size_t chunk = min(length, Config::JOURNAL_BUFFER_BYTES - b.used);
+      memcpy(b.data + b.used, data, chunk);
+      b.used += chunk;
+      data += chunk;
+      length -= chunk;
+      b.orders_through = length ? before : appended_;
+      if (b.used == Config::JOURNAL_BUFFER_BYTES)
+        submit_locked(fill_);
+    } while (length);
+    if (in_flight_ == 0 && buffers_[fill_].used)
+      submit_locked(fill_);
+  }
+
+  // Submits whatever is buffered now
+  void flush()
+  {
+    lock_guard<mutex> guard(lock_);
+    if (!buffers_.empty() && buffers_[fill_].state == State::Filling && buffers_[fill_].used)
+      submit_locked(fill_);
+  }
+
+  // Called by the backend once buffer `index` is written and synced (or failed)
+  void complete(size_t index, bool ok)
+  {
+    int64_t durable;
+    {
+      lock_guard<mutex> guard(lock_);
+      if (!ok)
+        failed_ = true;
+      buffers_[index].state = State::Done;
+      --in_flight_;
+      free_done_locked();
+      if (in_flight_ == 0 && buffers_[fill_].state == State::Filling && buffers_[fill_].used)
+        submit_locked(fill_);
+      durable = durable_;
+    }
+    changed_.notify_all();
+    uint64_t one = 1;
+    ssize_t signalled = ::write(event_fd_, &one, sizeof one);
+    (void)signalled; // fails only once the counter saturates
+    if (Callback cb = callback_)
+      cb(durable, context_);
+  }
+
+  // File offset just past everything appended so far
+  uint64_t end_offset()
+  {
+    lock_guard<mutex> guard(lock_);
+    const Buffer &b = buffers_[fill_];
+    return offset_ + (b.state == State::Filling ? b.used : 0);
+  }
+
+  // Frees the disk blocks before `offset` (a hole that reads back as zeros);
+  // file offsets stay valid for readers that start at `offset`
+  bool release(uint64_t offset)
+  {
+    off_t length = static_cast<off_t>(offset & ~uint64_t{4095});
+    return length == 0 || ::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, length) == 0;
+  }
+
+  // Waits until `orders` orders are durable: 0, 1 on timeout, -1 if a write failed
+  int wait(int64_t orders, int timeout_ms)
+  {
+    unique_lock<mutex> guard(lock_);
+    bool done = changed_.wait_for(guard, chrono::milliseconds(timeout_ms),
+                                  [&] { return failed_ || durable_ >= orders; });
+    return failed_ ? -1 : (done ? 0 : 1);
+  }
+
+  // Writes out everything, stops the backend and closes the file; false if any write failed
+  bool close()
+  {
+    if (fd_ < 0)
+      return true;
+    flush();
+    {
+      unique_lock<mutex> guard(lock_);
+      changed_.wait(guard, [&] { return in_flight_ == 0; });
+    }
+    backend_.reset();
+    ::close(fd_);
+    ::close(event_fd_);
+    free(memory_);
+    fd_ = event_fd_ = -1;
+    memory_ = nullptr;
+    buffers_.clear();
+    return !failed_;
+  }
+};
+
+// Writer threads: pwrite, then fdatasync, per buffer
+class ThreadJournalBackend : public JournalBackend
+{
+  struct Job
+  {
+    size_t index;
+    const char *data;
+    size_t length;
+    uint64_t offset;
+  };
+
+  Journal &journal_;
+  int fd_;
+  mutex lock_;
+  condition_variable ready_;
+  deque<Job> jobs_;
+  bool stopping_ = false;
+  vector<thread> workers_;
+
+  void run()
+  {
+    for (;;)
+    {
+      Job job;
+      {
+        unique_lock<mutex> guard(lock_);
+        ready_.wait(guard, [&] { return stopping_ || !jobs_.empty(); });
+        if (jobs_.empty())
+          return;
+        job = jobs_.front();
+        jobs_.pop_front();
+      }
+      bool ok = true;
+      for (size_t done = 0; ok && done < job.length;)
+      {
+        ssize_t n = ::pwrite(fd_, job.data + done, job.length - done, static_cast<off_t>(job.offset + done));
+        if (n < 0 && errno == EINTR)
+          continue;
+        ok = n > 0;
+        done += ok ? static_cast<size_t>(n) : 0;
+      }
+      journal_.complete(job.index, ok && ::fdatasync(fd_) == 0);
+    }
+  }
+
+public:
+  ThreadJournalBackend(Journal &journal, int fd, unsigned threads) : journal_(journal), fd_(fd)
+  {
+    for (unsigned i = 0; i < threads; ++i)
+      workers_.emplace_back([this] { run(); });
+  }
+
+  ~ThreadJournalBackend() override
+  {
+    {
+      lock_guard<mutex> guard(lock_);
+      stopping_ = true;
+    }
+    ready_.notify_all();
+    for (auto &w : workers_)
+      w.join();
+  }
+
+  bool submit(size_t index, const char *data, size_t length, uint64_t offset) override
+  {
+    {
+      lock_guard<mutex> guard(lock_);
+      jobs_.push_back({index, data, length, offset});
+    }
+    ready_.notify_one();
+    return true;
+  }
+};
+
+#ifdef LOGISTICS_IO_URING
+// io_uring through raw syscalls. The journal buffers are registered once, and
+// each submission is a WRITE_FIXED linked to an FSYNC (datasync), so one
+// io_uring_enter queues both; a reaper thread waits for completions.
+class IoUringJournalBackend : public JournalBackend
+{
+  static constexpr uint64_t STOP = ~uint64_t{0};
+
+  Journal &journal_;
+  int file_fd_;
+  int ring_fd_ = -1;
+  void *sq_ring_ = MAP_FAILED;
+  void *cq_ring_ = MAP_FAILED;
+  size_t sq_ring_bytes_ = 0;
+  size_t cq_ring_bytes_ = 0;
+  io_uring_sqe *sqes_ = static_cast<io_uring_sqe *>(MAP_FAILED);
+  size_t sqes_bytes_ = 0;
+  unsigned *sq_tail_ = nullptr, *sq_mask_ = nullptr, *sq_array_ = nullptr;
+  unsigned *cq_head_ = nullptr, *cq_tail_ = nullptr, *cq_mask_ = nullptr;
+  io_uring_cqe *cqes_ = nullptr;
+  mutex submit_lock_;
+  vector<size_t> lengths_;
+  // Per buffer: completions still to come, and whether its write and sync
+  // have all succeeded so far; the last completion reports the buffer
+  unique_ptr<atomic<int>[]> pending_;
+  unique_ptr<atomic<bool>[]> ok_;
+  bool broken_ = false; // the reaper stopped; under submit_lock_
+  thread reaper_;
+
+  int enter(unsigned to_submit, unsigned min_complete, unsigned flags)
+  {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete, flags, nullptr, 0));
+  }
+
+  // Writes the SQEs for one submission before publishing the tail
+  void push(const io_uring_sqe *entries, unsigned count)
+  {
+    for (unsigned i = 0; i < count; ++i)
+    {
+      unsigned tail = *sq_tail_ + i;
+      unsigned index = tail & *sq_mask_;
+      sqes_[index] = entries[i];
+      sq_array_[index] = index;
+    }
+    __atomic_store_n(sq_tail_, *sq_tail_ + count, __ATOMIC_RELEASE);
+  }
+
+  static bool transient(int error) { return error == EINTR || error == EAGAIN || error == EBUSY; }
+
+  // Counts one completion of buffer `index`; the last one reports it
+  void settle(size_t index, bool ok)
+  {
+    if (!ok)
+      ok_[index].store(false, memory_order_relaxed);
+    if (pending_[index].fetch_sub(1, memory_order_acq_rel) == 1)
+      journal_.complete(index, ok_[index].load(memory_order_relaxed));
+  }
+
+  void reap()
+  {
+    for (;;)
+    {
+      unsigned head = *cq_head_;
+      unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      if (head == tail)
+      {
+        if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && !transient(errno))
+          break;
+        continue;
+      }
+      for (; head != tail; ++head)
+      {
+        const io_uring_cqe &cqe = cqes_[head & *cq_mask_];
+        uint64_t data = cqe.user_data;
+        int res = cqe.res;
+        __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+        if (data == STOP)
+          return;
+        size_t index = static_cast<size_t>(data >> 1);
+        settle(index, data & 1 ? res == 0 : res >= 0 && static_cast<size_t>(res) == lengths_[index]);
+      }
+    }
+
+    // Nothing will be reaped any more: fail every buffer still out, so
+    // wait() and close() return, and refuse further submissions
+    vector<size_t> lost;
+    {
+      lock_guard<mutex> guard(submit_lock_);
+      broken_ = true;
+      for (size_t i = 0; i < lengths_.size(); ++i)
+        if (pending_[i].exchange(0, memory_order_acq_rel) > 0)
+          lost.push_back(i);
+    }
+    for (size_t index : lost)
+      journal_.complete(index, false);
+  }
+
+public:
+  IoUringJournalBackend(Journal &journal, int fd) : journal_(journal), file_fd_(fd) {}
+
+  // False if the kernel does not offer io_uring or buffer registration
+  bool init(const vector<iovec> &buffers)
+  {
+    io_uring_params params{};
+    unsigned entries = static_cast<unsigned>(4 * buffers.size());
+    ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (ring_fd_ < 0)
+      return false;
+    sq_ring_bytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_bytes_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqes_bytes_ = params.sq_entries * sizeof(io_uring_sqe);
+    sq_ring_ = ::mmap(nullptr, sq_ring_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                      IORING_OFF_SQ_RING);
+    cq_ring_ = ::mmap(nullptr, cq_ring_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                      IORING_OFF_CQ_RING);
+    void *sqes = ::mmap(nullptr, sqes_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                        IORING_OFF_SQES);
+    sqes_ = static_cast<io_uring_sqe *>(sqes);
+    if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED || sqes == MAP_FAILED)
+      return false;
+    char *sq = static_cast<char *>(sq_ring_), *cq = static_cast<char *>(cq_ring_);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    if (::syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS, buffers.data(),
+                  static_cast<unsigned>(buffers.size())) < 0)
+      return false;
+    lengths_.assign(buffers.size(), 0);
+    pending_ = make_unique<atomic<int>[]>(buffers.size());
+    ok_ = make_unique<atomic<bool>[]>(buffers.size());
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+      pending_[i].store(0, memory_order_relaxed);
+      ok_[i].store(true, memory_order_relaxed);
+    }
+    reaper_ = thread([this] { reap(); });
+    return true;
+  }
+
+  ~IoUringJournalBackend() override
+  {
+    if (reaper_.joinable())
+    {
+      io_uring_sqe stop{};
+      stop.opcode = IORING_OP_NOP;
+      stop.user_data = STOP;
+      {
+        lock_guard<mutex> guard(submit_lock_);
+        push(&stop, 1);
+        enter(1, 0, 0);
+      }
+      reaper_.join();
+    }
+    if (sqes_ != MAP_FAILED)
+      ::munmap(sqes_, sqes_bytes_);
+    if (cq_ring_ != MAP_FAILED)
+      ::munmap(cq_ring_, cq_ring_bytes_);
+    if (sq_ring_ != MAP_FAILED)
+      ::munmap(sq_ring_, sq_ring_bytes_);
+    if (ring_fd_ >= 0)
+      ::close(ring_fd_);
+  }
+
+  bool submit(size_t index, const char *data, size_t length, uint64_t offset) override
+  {
+    lengths_[index] = length;
+    io_uring_sqe ops[2] = {};
+    ops[0].opcode = IORING_OP_WRITE_FIXED;
+    ops[0].flags = IOSQE_IO_LINK;
+    ops[0].fd = file_fd_;
+    ops[0].addr = reinterpret_cast<uint64_t>(data);
+    ops[0].len = static_cast<uint32_t>(length);
+    ops[0].off = offset;
+    ops[0].buf_index = static_cast<uint16_t>(index);
+    ops[0].user_data = index << 1;
+    ops[1].opcode = IORING_OP_FSYNC;
+    ops[1].fd = file_fd_;
+    ops[1].fsync_flags = IORING_FSYNC_DATASYNC;
+    ops[1].user_data = index << 1 | 1;
+    lock_guard<mutex> guard(submit_lock_);
+    if (broken_)
+      return false;
+    ok_[index].store(true, memory_order_relaxed);
+    pending_[index].store(2, memory_order_release);
+    push(ops, 2);
+    // The kernel may take fewer SQEs than asked; the rest stay queued and
+    // go with the next enter
+    unsigned queued = 0;
+    for (int attempt = 0; queued < 2 && attempt < 1000;)
+    {
+      int n = enter(2 - queued, 0, 0);
+      if (n > 0)
+        queued += static_cast<unsigned>(n);
+      else if (n == 0 || !transient(errno))
+        break;
+      else if (errno != EINTR)
+      {
+        ++attempt;
+        this_thread::yield(); // out of resources or the CQ is full; the reaper drains it
+      }
+    }
+    if (queued == 2)
+      return true;
+    // Take back what the kernel never saw, so a later submission does not
+    // send it. If the write went alone, its completion fails the buffer;
+    // false (the caller fails it) if nothing went or that completion came.
+    __atomic_store_n(sq_tail_, *sq_tail_ - (2 - queued), __ATOMIC_RELEASE);
+    ok_[index].store(false, memory_order_relaxed);
+    int left = static_cast<int>(2 - queued);
+    return pending_[index].fetch_sub(left, memory_order_acq_rel) > left;
+  }
+};
+#endif
+
+inline int Journal::open(const string &path, int backend, uint64_t scan_from)
+{
+  close();
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ < 0)
+    return -1;
+  off_t end = ::lseek(fd_, 0, SEEK_END);
+  off_t from = static_cast<off_t>(scan_from);
+  off_t data = from < end ? ::lseek(fd_, from, SEEK_DATA) : end;
+  if (data < 0)
+    data = errno == ENXIO ? end : from; // only a hole after `from`, or no SEEK_DATA support
+  // A hole at the scan start with data behind it is a released prefix; its
+  // frames can only be found from the checkpoint offset
+  bool ok = end >= 0 && from <= end && (data == from || data == end);
+  if (ok)
+  {
+    off_t whole = data == end ? from : whole_frames_end(fd_, from, end);
+    ok = whole == end || (::ftruncate(fd_, whole) == 0 && ::fdatasync(fd_) == 0);
+    end = whole;
+  }
+  if (!ok)
+  {
+    ::close(fd_);
+    fd_ = -1;
+    return -1;
+  }
+  event_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  memory_ = static_cast<char *>(aligned_alloc(4096, Config::JOURNAL_BUFFERS * Config::JOURNAL_BUFFER_BYTES));
+  if (event_fd_ < 0 || !memory_)
+  {
+    close();
+    return -1;
+  }
+  offset_ = static_cast<uint64_t>(end);
+  appended_ = 0;
+  durable_ = 0;
+  failed_ = false;
+  fill_ = head_ = in_flight_ = 0;
+  buffers_.assign(Config::JOURNAL_BUFFERS, Buffer{});
+  vector<iovec> iov;
+  for (size_t i = 0; i < buffers_.size(); ++i)
+  {
+    buffers_[i].data = memory_ + i * Config::JOURNAL_BUFFER_BYTES;
+    iov.push_back({buffers_[i].data, Config::JOURNAL_BUFFER_BYTES});
+  }
+
+#ifdef LOGISTICS_IO_URING
+  if (backend != THREADS)
+  {
+    auto uring = make_unique<IoUringJournalBackend>(*this, fd_);
+    if (uring->init(iov))
+    {
+      backend_ = std::move(uring);
+      return IO_URING;
+    }
+  }
+#endif
+  if (backend == IO_URING)
+  {
+    close();
+    return -1;
+  }
+  backend_ = make_unique<ThreadJournalBackend>(*this, fd_, Config::JOURNAL_THREADS);
+  return THREADS;
+}
+
+// ==========================================
+// Shared Order Store 🧩
+// ==========================================
+
+// Decision columns in a POSIX shared-memory segment, for other processes to
+// map and read without IPC. Writers serialize on a robust process-shared
+// mutex; readers take no lock. Rows are numbered by arrival and kept in a
+// ring of `capacity` slots: rows [first, committed) are live, published by
+// the release store of `committed` and immutable until `first` moves past
+// them, after which their slots are reused. Slot words are written and read
+// with relaxed atomics, and a reader that copied rows checks `first` again
+// afterwards and drops what it moved past.
+// Each publisher holds a slot in `publishers` with the span from its oldest
+// live row to one past its newest; its retention and clears only raise the
+// start, and `first` is the lowest start among the running publishers with
+// live rows, so no publisher retires another's rows. The ring stays in
+// arrival order, so rows a publisher released stay live while an older row
+// of another one does. A store-wide clear empties every span, moves `first`
+// to `committed` and bumps `epoch`. Per-kind totals cover the live rows and
+// sit behind a seqlock: readers retry while the sequence is odd or changed
+// under them. If a writer dies holding the mutex, the next writer rebuilds
+// the totals from the live rows and carries on; a half-written batch past
+// `committed` is simply overwritten, and its slot is freed once it is found
+// dead.
+struct SharedPublisher
+{
+  pid_t pid;      // 0 = free slot
+  uint64_t first; // its oldest live row; none live once first >= end
+  uint64_t end;   // one past the newest row it appended
+};
+
+namespace SharedStore
+{
+  constexpr char MAGIC[8] = {'O', 'R', 'D', 'S', 'H', 'M', '0', '3'};
+  constexpr size_t HEADER_BYTES = 4096;
+  constexpr size_t PUBLISHERS = 64;
+}
+
+struct SharedStoreHeader
+{
+  char magic[8];
+  uint64_t capacity;
+  atomic<uint64_t> committed;
+  atomic<uint64_t> first;
+  atomic<uint64_t> epoch;
+  atomic<uint64_t> sequence;
+  atomic<int64_t> first_ms;
+  atomic<int64_t> orders[3];
+  atomic<int64_t> distance_dam[3];
+  atomic<int64_t> eta_days[3];
+  pthread_mutex_t writer;
+  SharedPublisher publishers[SharedStore::PUBLISHERS]; // under the writer mutex
+};
+static_assert(atomic<uint64_t>::is_always_lock_free && atomic<int64_t>::is_always_lock_free,
+              "shared counters must be lock-free to work across processes");
+static_assert(sizeof(SharedStoreHeader) <= SharedStore::HEADER_BYTES, "shared store header fits its page");
+
+class SharedOrderStore
+{
+  SharedStoreHeader *header_ = nullptr;
+  size_t length_ = 0;
+  int32_t *ids_ = nullptr;
+  int32_t *weight_g_ = nullptr;
+  int32_t *distance_dam_ = nullptr;
+  uint32_t *meta_ = nullptr;
+  int publisher_ = -1; // this handle's slot in the header, once it publishes
+
+  static string shm_name(const string &name) { return name.empty() || name[0] != '/' ? "/" + name : name; }
+
+  static size_t bytes_for(uint64_t capacity) { return SharedStore::HEADER_BYTES + capacity * sizeof(PackedOrder); }
+
+  bool map(int fd, size_t length)
+  {
+    void *addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+      return false;
+    header_ = static_cast<SharedStoreHeader *>(addr);
+    length_ = length;
+    return true;
+  }
+
+  void bind_columns()
+  {
+    char *base = reinterpret_cast<char *>(header_) + SharedStore::HEADER_BYTES;
+    size_t column = header_->capacity * sizeof(int32_t);
+    ids_ = reinterpret_cast<int32_t *>(base);
+    weight_g_ = reinterpret_cast<int32_t *>(base + column);
+    distance_dam_ = reinterpret_cast<int32_t *>(base + 2 * column);
+    meta_ = reinterpret_cast<uint32_t *>(base + 3 * column);
+  }
+
+  // Copies n slot words; relaxed stores, as readers load them without a lock
+  template <class T>
+  static void store_words(T *to, const T *from, size_t n)
+  {
+    for (size_t i = 0; i < n; ++i)
+      __atomic_store_n(to + i, from[i], __ATOMIC_RELAXED);
+  }
+
+  static bool alive(pid_t pid) { return pid == ::getpid() || ::kill(pid, 0) == 0 || errno == EPERM; }
+
+  // This handle's publisher slot; null in a child forked after join(),
+  // which must not act for its parent. Called with the writer mutex held.
+  SharedPublisher *publisher() const
+  {
+    SharedPublisher *p = publisher_ >= 0 ? &header_->publishers[publisher_] : nullptr;
+    return p && p->pid == ::getpid() ? p : nullptr;
+  }
+
+  // Moves `first` up to the oldest row a running publisher still holds,
+  // freeing the slots of those that died; called with the writer mutex held
+  void advance()
+  {
+    uint64_t lowest = header_->committed.load(memory_order_relaxed);
+    for (SharedPublisher &p : header_->publishers)
+    {
+      if (p.pid && !alive(p.pid))
+        p.pid = 0;
+      if (p.pid && p.first < p.end)
+        lowest = min(lowest, p.first);
+    }
+    uint64_t first = header_->first.load(memory_order_relaxed);
+    if (lowest > first)
+    {
+      update_totals([&] { add_totals(first, lowest - first, -1); });
+      header_->first.store(lowest, memory_order_release);
+    }
+  }
+
+  // Seqlock write side; only called with the writer mutex held
+  template <class F>
+  void update_totals(F &&f)
+  {
+    uint64_t s = header_->sequence.load(memory_order_relaxed);
+    header_->sequence.store(s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    f();
+    header_->sequence.store(s + 2, memory_order_release);
+  }
+
+  // Adds rows [first, first + n) to the totals, or takes them out with
+  // sign -1; writers are serialized, so plain load/store pairs suffice
+  void add_totals(uint64_t first, uint64_t n, int64_t sign = 1) const
+  {
+    int64_t orders[3] = {}, distance[3] = {}, eta[3] = {};
+    for (uint64_t i = first; i < first + n; ++i)
+    {
+      PackedOrder r = row(i);
+      int k = static_cast<int>(r.kind());
+      orders[k] += sign;
+      distance[k] += sign * r.distance_dam;
+      eta[k] += sign * r.eta_days();
+    }
+    for (int k = 0; k < 3; ++k)
+    {
+      header_->orders[k].store(header_->orders[k].load(memory_order_relaxed) + orders[k], memory_order_relaxed);
+      header_->distance_dam[k].store(header_->distance_dam[k].load(memory_order_relaxed) + distance[k],
+                                     memory_order_relaxed);
+      header_->eta_days[k].store(header_->eta_days[k].load(memory_order_relaxed) + eta[k], memory_order_relaxed);
+    }
+  }
+
+  // Called holding a mutex whose owner died: rebuilds the totals from the
+  // live rows and marks the mutex usable again
+  bool repair() const
+  {
+    uint64_t first = header_->first.load(memory_order_relaxed);
+    uint64_t committed = header_->committed.load(memory_order_relaxed);
+    uint64_t s = header_->sequence.load(memory_order_relaxed);
+    header_->sequence.store(s | 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (int k = 0; k < 3; ++k)
+    {
+      header_->orders[k].store(0, memory_order_relaxed);
+      header_->distance_dam[k].store(0, memory_order_relaxed);
+      header_->eta_days[k].store(0, memory_order_relaxed);
+    }
+    add_totals(first, committed - first);
+    header_->sequence.store((s | 1) + 1, memory_order_release);
+    return ::pthread_mutex_consistent(&header_->writer) == 0;
+  }
+
+  // Takes the writer mutex, repairing after a dead owner. A mutex that
+  // cannot be made consistent is released, which leaves it unrecoverable
+  // for everyone instead of held forever.
+  bool lock() const
+  {
+    int rc = ::pthread_mutex_lock(&header_->writer);
+    if (rc == EOWNERDEAD)
+    {
+      if (repair())
+        return true;
+      ::pthread_mutex_unlock(&header_->writer);
+    }
+    return rc == 0;
+  }
+
+public:
+  SharedOrderStore() = default;
+  SharedOrderStore(const SharedOrderStore &) = delete;
+  SharedOrderStore &operator=(const SharedOrderStore &) = delete;
+  ~SharedOrderStore() { close(); }
+
+  // Opens segment `name`, creating it with room for `capacity` orders if it
+  // does not exist yet; false if it cannot be created or is not a store
+  bool open(const string &name, uint64_t capacity)
+  {
+    close();
+    string path = shm_name(name);
+    int fd = ::shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0)
+    {
+      bool ok = capacity > 0 && ::ftruncate(fd, static_cast<off_t>(bytes_for(capacity))) == 0 &&
+                map(fd, bytes_for(capacity));
+      ::close(fd);
+      if (!ok)
+      {
+        ::shm_unlink(path.c_str());
+        return false;
+      }
+      header_->capacity = capacity;
+      header_->first_ms.store(0, memory_order_relaxed);
+      pthread_mutexattr_t attr;
+      ::pthread_mutexattr_init(&attr);
+      ::pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+      ::pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+      ::pthread_mutex_init(&header_->writer, &attr);
+      ::pthread_mutexattr_destroy(&attr);
+      atomic_thread_fence(memory_order_release);
+      memcpy(header_->magic, SharedStore::MAGIC, sizeof header_->magic); // last: marks the store ready
+      bind_columns();
+      return true;
+    }
+    if (errno != EEXIST || (fd = ::shm_open(path.c_str(), O_RDWR, 0600)) < 0)
+      return false;
+
+    // The creator may still be initializing the header
+    struct stat st;
+    bool ok = false;
+    for (int attempt = 0; attempt < 1000 && !ok; ++attempt)
+    {
+      ok = ::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= SharedStore::HEADER_BYTES;
+      if (ok && map(fd, static_cast<size_t>(st.st_size)))
+      {
+        atomic_thread_fence(memory_order_acquire);
+        ok = memcmp(header_->magic, SharedStore::MAGIC, sizeof header_->magic) == 0 &&
+             bytes_for(header_->capacity) <= length_;
+        if (!ok)
+          close();
+      }
+      else
+        ok = false;
+      if (!ok)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    ::close(fd);
+    if (ok)
+      bind_columns();
+    return ok;
+  }
+
+  void close()
+  {
+    if (header_ && publisher_ >= 0 && lock())
+    {
+      if (SharedPublisher *p = publisher())
+        p->pid = 0;
+      ::pthread_mutex_unlock(&header_->writer);
+    }
+    if (header_)
+      ::munmap(header_, length_);
+    header_ = nullptr;
+    length_ = 0;
+    publisher_ = -1;
+  }
+
+  // Takes a publisher slot, holding no rows yet; false if every slot is held
+  // by a running process or the mutex is unusable
+  bool join()
+  {
+    if (!header_ || publisher_ >= 0)
+      return header_ != nullptr;
+    if (!lock())
+      return false;
+    for (size_t i = 0; i < SharedStore::PUBLISHERS && publisher_ < 0; ++i)
+    {
+      SharedPublisher &p = header_->publishers[i];
+      if (!p.pid || !alive(p.pid))
+      {
+        p.pid = ::getpid();
+        p.first = p.end = header_->committed.load(memory_order_relaxed);
+        publisher_ = static_cast<int>(i);
+      }
+    }
+    ::pthread_mutex_unlock(&header_->writer);
+    return publisher_ >= 0;
+  }
+
+  static bool unlink(const string &name) { return ::shm_unlink(shm_name(name).c_str()) == 0; }
+
+  bool is_open() const { return header_ != nullptr; }
+  uint64_t capacity() const { return header_ ? header_->capacity : 0; }
+  // One past the newest row; rows are numbered from the store's creation
+  uint64_t size() const { return header_ ? header_->committed.load(memory_order_acquire) : 0; }
+  // The oldest live row; a reader that copied rows below it must drop them
+  uint64_t first() const { return header_ ? header_->first.load(memory_order_acquire) : 0; }
+  // Number of store-wide clears so far
+  uint64_t epoch() const { return header_ ? header_->epoch.load(memory_order_acquire) : 0; }
+  PackedOrder row(uint64_t i) const
+  {
+    i %= header_->capacity;
+    return {__atomic_load_n(ids_ + i, __ATOMIC_RELAXED), __atomic_load_n(weight_g_ + i, __ATOMIC_RELAXED),
+            __atomic_load_n(distance_dam_ + i, __ATOMIC_RELAXED), __atomic_load_n(meta_ + i, __ATOMIC_RELAXED)};
+  }
+
+  // Appends as many of the n rows as there are free slots, numbering the
+  // first one `at`; returns how many did, or -1 if the writer mutex is
+  // unusable
+  int64_t append(const int32_t *ids, const int32_t *weight_g, const int32_t *distance_dam, const uint32_t *meta,
+                 size_t n, int64_t at_ms, uint64_t &at)
+  {
+    if (!header_ || !lock())
+      return -1;
+    uint64_t first = header_->first.load(memory_order_relaxed);
+    at = header_->committed.load(memory_order_relaxed);
+    if (header_->capacity - (at - first) < n)
+    {
+      advance(); // publishers that died free their rows
+      first = header_->first.load(memory_order_relaxed);
+    }
+    size_t count = static_cast<size_t>(min<uint64_t>(n, header_->capacity - (at - first)));
+    // Slots are reused only after `first` moved past their old rows; the
+    // fence orders that move before the overwrite for readers
+    atomic_thread_fence(memory_order_release);
+    for (size_t done = 0; done < count;)
+    {
+      size_t slot = static_cast<size_t>((at + done) % header_->capacity);
+      size_t piece = min<size_t>(count - done, header_->capacity - slot);
+      store_words(ids_ + slot, ids + done, piece);
+      store_words(weight_g_ + slot, weight_g + done, piece);
+      store_words(distance_dam_ + slot, distance_dam + done, piece);
+      store_words(meta_ + slot, meta + done, piece);
+      done += piece;
+    }
+    header_->committed.store(at + count, memory_order_release);
+    SharedPublisher *p = publisher();
+    if (p && count)
+    {
+      if (p->first >= p->end)
+        p->first = at;
+      p->end = at + count;
+    }
+    update_totals([&]
+    {
+      if (at == first && count)
+        header_->first_ms.store(at_ms, memory_order_relaxed);
+      add_totals(at, count);
+    });
+    ::pthread_mutex_unlock(&header_->writer);
+    return static_cast<int64_t>(count);
+  }
+
+  // Releases this publisher's rows below `row` (all of them for
+  // UINT64_MAX); rows no running publisher holds leave the totals and the
+  // ring. False if the writer mutex is unusable.
+  bool retire(uint64_t row)
+  {
+    if (!header_ || !lock())
+      return false;
+    if (SharedPublisher *p = publisher())
+    {
+      p->first = max(p->first, min(row, header_->committed.load(memory_order_relaxed)));
+      advance();
+    }
+    ::pthread_mutex_unlock(&header_->writer);
+    return true;
+  }
+
+  // Retires every row, whoever published it, and starts a new epoch; false
+  // if the writer mutex is unusable
+  bool reset()
+  {
+    if (!header_ || !lock())
+      return false;
+    for (SharedPublisher &p : header_->publishers)
+      p.first = p.end;
+    update_totals([&]
+    {
+      header_->first_ms.store(0, memory_order_relaxed);
+      for (int k = 0; k < 3; ++k)
+      {
+        header_->orders[k].store(0, memory_order_relaxed);
+        header_->distance_dam[k].store(0, memory_order_relaxed);
+        header_->eta_days[k].store(0, memory_order_relaxed);
+      }
+    });
+    header_->first.store(header_->committed.load(memory_order_relaxed), memory_order_release);
+    header_->epoch.fetch_add(1, memory_order_release);
+    ::pthread_mutex_unlock(&header_->writer);
+    return true;
+  }
+
+  // A consistent copy of the per-kind totals of the live rows; start_ms is
+  // the time of the first order appended to an empty store
+  OrderWindow totals() const
+  {
+    OrderWindow out{};
+    if (!header_)
+      return out;
+    int64_t orders[3], distance[3], eta[3];
+    unsigned spins = 0;
+    for (;;)
+    {
+      uint64_t s = header_->sequence.load(memory_order_acquire);
+      if (s & 1)
+      {
+        // A writer that dies mid-update leaves the sequence odd; readers
+        // repair it themselves rather than wait for the next writer. Any
+        // mutex the trylock took is released, also when repair fails.
+        if (++spins % 1024 == 0)
+        {
+          int rc = ::pthread_mutex_trylock(&header_->writer);
+          if (rc == EOWNERDEAD)
+            repair();
+          if (rc == 0 || rc == EOWNERDEAD)
+            ::pthread_mutex_unlock(&header_->writer);
+        }
+        this_thread::yield();
+        continue;
+      }
+      out.start_ms = header_->first_ms.load(memory_order_relaxed);
+      for (int k = 0; k < 3; ++k)
+      {
+        orders[k] = header_->orders[k].load(memory_order_relaxed);
+        distance[k] = header_->distance_dam[k].load(memory_order_relaxed);
+        eta[k] = header_->eta_days[k].load(memory_order_relaxed);
+      }
+      atomic_thread_fence(memory_order_acquire);
+      if (header_->sequence.load(memory_order_relaxed) == s)
+        break;
+    }
+    for (int k = 0; k < 3; ++k)
+    {
+      out.orders[k] = orders[k];
+      out.avg_distance_km[k] = orders[k] ? distance[k] / Config::DISTANCE_SCALE / orders[k] : 0.0;
+      out.avg_eta_days[k] = orders[k] ? static_cast<double>(eta[k]) / orders[k] : 0.0;
+    }
+    return out;
+  }
+};
+
+// ==========================================
+// Order Manager
+// ==========================================
+
+class OrderManager
+{
+  OrderStore store_;
+  array<RoaringBitmap, Filter::COUNT> filters_;
+  RangeIndex weight_index_;
+  RangeIndex distance_index_;
+  WindowAggregator windows_;
+  QuantileSketches quantiles_;
+  DistinctCounters distinct_;
+  TopOrders top_;
+  const BusinessCalendar *calendar_ = nullptr;
+  int region_ = 0;
+  int dispatch_day_ = -1;
+  bool encode_ = false;
+  vector<size_t> scalar_rows_; // process_batch rows the classifier cannot decide
+  vector<PackedOrder> slice_rows_; // rows of the segment slice being observed
+  unique_ptr<Journal> journal_;
+  uint64_t journal_generation_ = 0;
+  pid_t checkpoint_pid_ = 0;
+  uint64_t checkpoint_offset_ = 0;
+  uint64_t checkpoint_generation_ = 0;
+  uint64_t loaded_offset_ = 0; // journal offset covered by the loaded checkpoint
+  bool checkpoint_failed_ = false;
+  double checkpoint_pause_ms_ = 0;
+
+  // Consecutive orders of this process that landed on consecutive shared rows
+  struct SharedRun
+  {
+    uint64_t ordinal; // arrival number of the first order
+    uint64_t row;     // its row in the shared store
+    uint64_t n;
+  };
+  unique_ptr<SharedOrderStore> shared_;
+  deque<SharedRun> shared_runs_; // live orders only, oldest first
+  uint64_t shared_end_ = 0;      // one past the last row this process published
+  int shared_status_ = 0;
+  uint64_t unshared_ = 0;
+
+public:
+  // Classifies and stores one order; its record also goes to `out` if
+  // given. Returns its row at insertion, before retention ran.
+  size_t process(const OrderDetails &details, PackedOrder *out = nullptr)
+  {
+    auto transport = TransportFactory::create_transport(details);
+    PackedOrder record = PackedOrder::pack(details, *transport);
+    int64_t now = now_ms();
+    make_room();
+    uint32_t row = store_.append(record, now);
+    const OrderSegment &seg = *store_.segments().back();
+    index_row(row, record);
+    windows_.observe(record, now);
+    quantiles_.observe(record, now);
+    distinct_.observe(record.kind(), details.customer_id, details.destination_id, now);
+    top_.observe(record, seg.first_ordinal + seg.size() - 1, seg.first_ordinal);
+    weight_index_.insert(record.weight_g, row);
+    distance_index_.insert(record.distance_dam, row);
+    if (journal_)
+      journal_batch(&details.id, &details.weight_kg, &details.distance_km, &details.urgent, &details.customer_id,
+                    &details.destination_id, 1, store_.size() - 1);
+    if (shared_)
+      publish(store_.size() - 1, 1, now);
+    if (out)
+      *out = record;
+    size_t inserted = store_.size() - 1;
+    expire(now);
+    spill();
+    return inserted;
+  }
+
+  // Columnar ingest: quantizes straight into the tail segment and classifies
+  // the new rows there with classify_columns. Customer and destination ids
+  // are optional (nullptr). The records also go to `out` if given, copied
+  // before retention may drop the segment holding them. Returns the row of
+  // the first order at insertion.
+  size_t process_batch(const int *ids, const double *weights, const double *distances, const bool *urgent, size_t n,
+                       const uint64_t *customers = nullptr, const uint64_t *destinations = nullptr,
+                       PackedOrder *out = nullptr)
+  {
+    using P = PackedOrder;
+    int64_t now = now_ms();
+    size_t first = store_.size();
+    for (size_t i = 0; i < n;)
+    {
+      make_room();
+      OrderSegment &seg = store_.tail(now);
+      size_t start = seg.size();
+      size_t count = min(n - i, Config::SEGMENT_ROWS - start);
+      scalar_rows_.clear();
+      for (size_t j = i; j < i + count; ++j)
+      {
+        bool weight_frac, distance_frac;
+        uint32_t route = P::route_field(TransportFactory::route_minutes({ids[j], weights[j], distances[j], urgent[j]}));
+        // NaN fails every rule and a negative route shortens the ETA; the
+        // classifier covers neither, so those rows take the scalar path
+        if ((route >> P::ROUTE_NEGATIVE_BIT) & 1 || weights[j] != weights[j] || distances[j] != distances[j])
+          scalar_rows_.push_back(j - i);
+        seg.ids.push_back(ids[j]);
+        seg.weight_g.push_back(P::quantize_weight(weights[j], weight_frac));
+        seg.distance_dam.push_back(P::quantize_distance(distances[j], distance_frac));
+        seg.meta.push_back(P::field(urgent[j], 1, P::URGENT_BIT) | P::field(weight_frac, 1, P::WEIGHT_FRAC_BIT) |
+                           P::field(distance_frac, 1, P::DISTANCE_FRAC_BIT) | route);
+      }
+      classify_columns(seg.weight_g.data() + start, seg.distance_dam.data() + start, seg.meta.data() + start, count);
+      for (size_t k : scalar_rows_)
+      {
+        OrderDetails o{ids[i + k], weights[i + k], distances[i + k], urgent[i + k]};
+        seg.meta[start + k] = P::pack(o, *TransportFactory::create_transport(o)).meta;
+      }
+      store_.commit(count, now);
+      const PackedOrder *rows = observe_slice(seg, start, count, now, out ? out + i : nullptr);
+      distinct_.observe(rows, customers ? customers + i : nullptr, destinations ? destinations + i : nullptr, count,
+                        now);
+      i += count;
+    }
+    if (journal_)
+      journal_batch(ids, weights, distances, urgent, customers, destinations, n, first);
+    if (shared_)
+      publish(first, n, now);
+    expire(now);
+    spill();
+    return first;
+  }
+
+  void process_frame(const OrderFrame &f)
+  {
+    process_batch(f.ids, f.weights, f.distances, f.urgent, f.rows, f.customers, f.destinations);
+  }
+
+  // Appends decision frames for live rows [first, first + count), one per
+  // segment slice, copied straight from the columns
+  void append_decisions(string &out, size_t first, size_t count) const
+  {
+    count = first < store_.size() ? min(count, store_.size() - first) : 0;
+    while (count)
+    {
+      auto at = store_.locate(first);
+      const OrderSegment &seg = *at.first;
+      size_t n = min(count, seg.size() - at.second);
+      encode_decision_frame(out, seg.id_data() + at.second, seg.weight_data() + at.second,
+                            seg.distance_data() + at.second, seg.meta_data() + at.second, n, encode_);
+      first += n;
+      count -= n;
+    }
+  }
+
+  // Generates a summary string for Python to read
+  string get_summary() const
+  {
+    string out;
+    append_summary(out);
+    return out;
+  }
+
+  // Appends the summary to `out`; reusing `out` keeps this allocation-free
+  void append_summary(string &out) const
+  {
+    out.reserve(out.size() + store_.size() * 64);
+    TextBuffer line, info, eta;
+    store_.for_each([&](const PackedOrder &r)
+    {
+      line.clear();
+      line.append("[Order #").append(r.id).append("] ");
+      line.append(format_info(r, info)).append(" -> ETA: ").append(eta_text(r, eta));
+      out.append(line.view()).push_back('\n');
+    });
+  }
+
+  // The ETA as the summary prints it, with the due date once a dispatch
+  // date is set
+  string_view eta_text(const PackedOrder &r, TextBuffer &buf) const
+  {
+    TextBuffer eta;
+    buf.clear();
+    buf.append(format_eta(r, eta));
+    int due = calendar_ ? calendar_->add_business_days(region_, dispatch_day_, r.eta_days()) : -1;
+    if (due >= 0)
+      buf.append(", due ").append_date(due);
+    return buf.view();
+  }
+
+  size_t size() const { return store_.size(); }
+  PackedOrder record(size_t index) const { return store_.row(index); }
+
+  // Summaries include a due date once a dispatch date is set
+  void set_dispatch(const BusinessCalendar *calendar, int region, int day)
+  {
+    calendar_ = calendar;
+    region_ = region;
+    dispatch_day_ = day;
+  }
+
+  // Rows having every filter in all_of, at least one in any_of (if any) and
+  // none in none_of; answered from the bitmaps without touching records
+  RoaringBitmap filter(uint32_t all_of, uint32_t any_of, uint32_t none_of) const
+  {
+    auto combine = [&](uint32_t mask, bool intersect)
+    {
+      RoaringBitmap out;
+      bool first = true;
+      for (int i = 0; i < Filter::COUNT; ++i)
+        if (mask & (1u << i))
+        {
+          out = first ? filters_[i] : (intersect ? out & filters_[i] : out | filters_[i]);
+          first = false;
+        }
+      return out;
+    };
+
+    // Every row has exactly one kind, so their union is the universe
+    RoaringBitmap rows = all_of ? combine(all_of, true) : combine(Filter::TRUCK | Filter::SHIP | Filter::AIR, false);
+    if (any_of)
+      rows = rows & combine(any_of, false);
+    if (none_of)
+      rows = and_not(rows, combine(none_of, false));
+    return rows;
+  }
+
+  int order_id(uint32_t row_id) const { return store_.row_by_id(row_id).id; }
+  bool is_live(uint32_t row_id) const { return store_.is_live(row_id); }
+
+  // Applies a retention policy and drops whatever it already rules out
+  void set_retention(const RetentionPolicy &policy)
+  {
+    store_.set_retention(policy);
+    expire(now_ms());
+  }
+
+  // Journals every ingest call to `path` from now on; returns the backend
+  // in use (Journal::Backend) or -1. A torn tail is cut off first, scanning
+  // from the offset the loaded checkpoint covers (or from the start).
+  int open_journal(const string &path, int backend)
+  {
+    auto journal = make_unique<Journal>();
+    int used = journal->open(path, backend, loaded_offset_);
+    if (used < 0)
+      return -1;
+    close_journal();
+    journal_ = std::move(journal);
+    ++journal_generation_;
+    return used;
+  }
+
+  // Waits for pending writes; false if any failed
+  bool close_journal()
+  {
+    bool ok = !journal_ || journal_->close();
+    journal_.reset();
+    return ok;
+  }
+
+  Journal *journal() const { return journal_.get(); }
+
+  // Copies every order processed from now on into shared-memory store
+  // `name`, created with room for `capacity` orders unless another process
+  // made it first. Retention and clear() carry over to the store; orders
+  // that find it full are not shared, see share_status().
+  bool share(const string &name, uint64_t capacity)
+  {
+    auto shared = make_unique<SharedOrderStore>();
+    if (!shared->open(name, capacity) || !shared->join())
+      return false;
+    shared_ = std::move(shared);
+    shared_runs_.clear();
+    shared_end_ = 0;
+    shared_status_ = 0;
+    unshared_ = 0;
+    return true;
+  }
+
+  void unshare()
+  {
+    shared_.reset();
+    shared_runs_.clear();
+  }
+
+  // How the last publish went: 0 if every order reached the shared store,
+  // 1 if it was full for some, -1 if its writer mutex is unusable
+  int share_status() const { return shared_status_; }
+  // Orders processed since share() that did not reach the store
+  uint64_t unshared() const { return unshared_; }
+
+  // Clears the shared store for every publisher; false if not sharing or
+  // its writer mutex is unusable
+  bool clear_shared() { return shared_ && shared_->reset(); }
+
+  // Order files and decision frames written from now on use the column codecs
+  void set_compression(bool enabled) { encode_ = enabled; }
+  bool compression() const { return encode_; }
+
+  // Writes every live order to an order file, segment by segment
+  bool export_to(const string &path, int64_t journal_offset = 0, bool sync = false) const
+  {
+    SegmentWriter out;
+    if (!out.open(path))
+      return false;
+    out.set_encoded(encode_);
+    out.set_journal_offset(journal_offset);
+    for (const auto &seg : store_.segments())
+      out.append_columns(seg->id_data(), seg->weight_data(), seg->distance_data(), seg->meta_data(), seg->size(),
+                         seg->bucket, seg->last_ms);
+    return out.close(sync);
+  }
+
+  // Forks a child that writes the store to `path` (through path.tmp, synced,
+  // then renamed) while this process keeps ingesting; copy-on-write keeps the
+  // child's view fixed at the fork, so the pause is the fork itself. The
+  // snapshot records the journal offset it covers. Returns 0, 1 while the
+  // previous checkpoint is still running, -1 if fork fails.
+  int start_checkpoint(const string &path)
+  {
+    if (checkpoint_status() == 1)
+      return 1;
+    uint64_t offset = journal_ ? journal_->end_offset() : 0;
+    auto start = chrono::steady_clock::now();
+    pid_t pid = ::fork();
+    if (pid == 0)
+    {
+      string tmp = path + ".tmp";
+      bool ok = export_to(tmp, static_cast<int64_t>(offset), true) && ::rename(tmp.c_str(), path.c_str()) == 0 &&
+                sync_parent(path);
+      ::_exit(ok ? 0 : 1);
+    }
+    checkpoint_pause_ms_ = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    if (pid < 0)
+      return -1;
+    checkpoint_pid_ = pid;
+    checkpoint_offset_ = offset;
+    checkpoint_generation_ = journal_generation_;
+    return 0;
+  }
+
+  // 1 while a checkpoint runs, 0 once it succeeded (or none ran), -1 if it
+  // failed. On success the journal prefix it covers is released; after a
+  // failure the journal is left whole.
+  int checkpoint_status()
+  {
+    if (checkpoint_pid_ > 0)
+    {
+      int status = 0;
+      pid_t r = ::waitpid(checkpoint_pid_, &status, WNOHANG);
+      if (r == 0)
+        return 1;
+      checkpoint_pid_ = 0;
+      checkpoint_failed_ = !(r > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+      if (!checkpoint_failed_ && journal_ && checkpoint_generation_ == journal_generation_)
+        journal_->release(checkpoint_offset_);
+    }
+    return checkpoint_failed_ ? -1 : 0;
+  }
+
+  double checkpoint_pause_ms() const { return checkpoint_pause_ms_; }
+
+  // Replaces the contents with a checkpoint; returns the journal offset to
+  // replay from, or -1 (and an empty manager) if the file is damaged.
+  // Windows and quantiles see each row at its segment's last arrival time;
+  // distinct counts start over, since order files keep no customer ids.
+  int64_t load_checkpoint(const string &path)
+  {
+    clear();
+    SegmentReader in;
+    OrderBlock block;
+    int64_t offset = -1;
+    int got = in.open(path) ? 1 : -1;
+    while (got == 1 && (got = in.next(block)) == 1)
+    {
+      offset = block.header.journal_offset;
+      restore(block);
+    }
+    if (got < 0 || offset < 0)
+    {
+      clear();
+      return -1;
+    }
+    expire(now_ms());
+    loaded_offset_ = static_cast<uint64_t>(offset);
+    return offset;
+  }
+
+  // Writes every live order as Arrow IPC (file or stream format)
+  bool export_arrow(const string &path, bool file_format) const
+  {
+    ArrowWriter out;
+    if (!out.open(path, file_format))
+      return false;
+    for (const auto &seg : store_.segments())
+      out.write_batch(seg->id_data(), seg->weight_data(), seg->distance_data(), seg->meta_data(), seg->size());
+    return out.close();
+  }
+
+  // Once the record columns plus index_bytes() pass `bytes`, columns move to
+  // files under `dir`, oldest sealed segment first; 0 turns spilling off.
+  // Indexes and sketches are counted but stay in memory. Returns false if
+  // `dir` is not a writable directory.
+  bool set_memory_budget(size_t bytes, const string &dir)
+  {
+    struct stat st;
+    if (bytes && (::stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || ::access(dir.c_str(), W_OK) != 0))
+      return false;
+    store_.set_spill(bytes, dir);
+    spill();
+    return true;
+  }
+
+  // Heap held besides the record columns: bitmaps, range indexes, top-K
+  // heaps and the per-thread windows and sketches
+  size_t index_bytes() const
+  {
+    size_t bytes = weight_index_.bytes() + distance_index_.bytes() + top_.bytes() + windows_.bytes() +
+                   quantiles_.bytes() + distinct_.bytes();
+    for (const auto &f : filters_)
+      bytes += f.bytes();
+    return bytes;
+  }
+
+  // Drops front segments the retention policy no longer keeps, together with
+  // their bitmap chunks, range index entries and top-K entries. Windows,
+  // quantiles and distinct counts age out on their own horizons.
+  void expire(int64_t now)
+  {
+    bool dropped = false;
+    while (const OrderSegment *seg = store_.expired_front(now))
+    {
+      uint32_t first_row = seg->seq << 16;
+      for (auto &f : filters_)
+        f.erase_chunk(static_cast<uint16_t>(seg->seq));
+      weight_index_.expire(seg->weight_data(), first_row, seg->size());
+      distance_index_.expire(seg->distance_data(), first_row, seg->size());
+      store_.drop_front();
+      dropped = true;
+    }
+    if (!dropped)
+      return;
+    auto live = [&](uint32_t row) { return store_.is_live(row); };
+    if (weight_index_.needs_purge())
+      weight_index_.purge(live);
+    if (distance_index_.needs_purge())
+      distance_index_.purge(live);
+    top_.expire_before(store_.segments().front()->first_ordinal);
+    if (shared_)
+      retire_shared();
+  }
+
+  // Renumbers the store before its next segment would wrap the row ids, and
+  // moves the bitmaps and range indexes onto the new ids
+  void make_room()
+  {
+    if (!store_.seq_exhausted())
+      return;
+    auto live = [&](uint32_t row) { return store_.is_live(row); };
+    weight_index_.purge(live);
+    distance_index_.purge(live);
+    uint32_t by = store_.renumber();
+    for (auto &f : filters_)
+      f.shift_keys(static_cast<uint16_t>(by));
+    weight_index_.shift_rows(by << 16);
+    distance_index_.shift_rows(by << 16);
+  }
+
+  const RangeIndex &weight_index() const { return weight_index_; }
+  const WindowAggregator &windows() const { return windows_; }
+  const QuantileSketches &quantiles() const { return quantiles_; }
+  const DistinctCounters &distinct() const { return distinct_; }
+  const TopOrders &top() const { return top_; }
+  const RangeIndex &distance_index() const { return distance_index_; }
+
+  // Narrows `rows` to weight and distance inside the inclusive bounds (kg, km);
+  // a range open on both sides is skipped
+  RoaringBitmap within(RoaringBitmap rows, double min_kg, double max_kg, double min_km, double max_km) const
+  {
+    auto narrow = [&](const RangeIndex &index, double lo, double hi, double scale)
+    {
+      if (isinf(lo) && lo < 0 && isinf(hi) && hi > 0)
+        return;
+      vector<uint32_t> hits;
+      index.for_each(grid_key(lo, scale, false), grid_key(hi, scale, true), [&](int32_t, uint32_t row)
+      {
+        if (store_.is_live(row))
+          hits.push_back(row);
+      });
+      sort(hits.begin(), hits.end());
+      RoaringBitmap in_range;
+      for (uint32_t row : hits)
+        in_range.add(row);
+      rows = rows & in_range;
+    };
+    narrow(weight_index_, min_kg, max_kg, Config::WEIGHT_SCALE);
+    narrow(distance_index_, min_km, max_km, Config::DISTANCE_SCALE);
+    return rows;
+  }
+
+  void clear()
+  {
+    store_.clear();
+    for (auto &f : filters_)
+      f.clear();
+    weight_index_.clear();
+    distance_index_.clear();
+    windows_.clear();
+    quantiles_.clear();
+    distinct_.clear();
+    top_.clear();
+    loaded_offset_ = 0;
+    if (shared_ && !shared_->retire(UINT64_MAX))
+      shared_status_ = -1;
+    shared_runs_.clear();
+  }
+
+private:
+  // Appends the inputs and decisions of rows [first, first + n) to the
+  // journal as frame pairs of at most Wire::MAX_ROWS orders
+  void journal_batch(const int *ids, const double *weights, const double *distances, const bool *urgent,
+                     const uint64_t *customers, const uint64_t *destinations, size_t n, size_t first)
+  {
+    static thread_local string frames;
+    for (size_t i = 0; i < n; i += Wire::MAX_ROWS)
+    {
+      size_t count = min<size_t>(n - i, Wire::MAX_ROWS);
+      frames.clear();
+      encode_order_frame(frames, ids + i, weights + i, distances + i, urgent + i, customers ? customers + i : nullptr,
+                         destinations ? destinations + i : nullptr, count, encode_);
+      append_decisions(frames, first + i, count);
+      journal_->append(frames.data(), frames.size(), static_cast<int64_t>(count));
+    }
+  }
+
+  // Spills record columns while they and the indexes exceed the budget; the
+  // index sizes are only summed when a sealed segment could go
+  void spill()
+  {
+    if (store_.can_spill())
+      store_.spill(index_bytes());
+  }
+
+  // Appends rows that are already classified, with their indexes
+  void restore(const OrderBlock &block)
+  {
+    int64_t at = block.header.last_ms ? block.header.last_ms : now_ms();
+    for (size_t i = 0; i < block.size();)
+    {
+      make_room();
+      OrderSegment &seg = store_.tail(at);
+      size_t start = seg.size();
+      size_t count = min(block.size() - i, Config::SEGMENT_ROWS - start);
+      seg.ids.insert(seg.ids.end(), block.ids.begin() + i, block.ids.begin() + i + count);
+      seg.weight_g.insert(seg.weight_g.end(), block.weight_g.begin() + i, block.weight_g.begin() + i + count);
+      seg.distance_dam.insert(seg.distance_dam.end(), block.distance_dam.begin() + i,
+                              block.distance_dam.begin() + i + count);
+      seg.meta.insert(seg.meta.end(), block.meta.begin() + i, block.meta.begin() + i + count);
+      store_.commit(count, at);
+      observe_slice(seg, start, count, at);
+      i += count;
+    }
+    spill();
+  }
+
+  // fsync of the directory holding `path`, so a rename into it is durable
+  static bool sync_parent(const string &path)
+  {
+    size_t slash = path.rfind('/');
+    string dir = slash == string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+      return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+  }
+
+  // Copies rows [first, first + count) to the shared store, a segment slice
+  // at a time, and notes where they landed for retention
+  void publish(size_t first, size_t count, int64_t now)
+  {
+    shared_status_ = 0;
+    while (count)
+    {
+      auto at = store_.locate(first);
+      const OrderSegment &seg = *at.first;
+      size_t n = min(count, seg.size() - at.second);
+      uint64_t row = 0;
+      int64_t done = shared_->append(seg.id_data() + at.second, seg.weight_data() + at.second,
+                                     seg.distance_data() + at.second, seg.meta_data() + at.second, n, now, row);
+      if (done > 0)
+      {
+        uint64_t ordinal = seg.first_ordinal + at.second;
+        SharedRun *last = shared_runs_.empty() ? nullptr : &shared_runs_.back();
+        if (last && last->ordinal + last->n == ordinal && last->row + last->n == row)
+          last->n += static_cast<uint64_t>(done);
+        else
+          shared_runs_.push_back({ordinal, row, static_cast<uint64_t>(done)});
+        shared_end_ = row + static_cast<uint64_t>(done);
+      }
+      if (done < static_cast<int64_t>(n))
+      {
+        if (done < 0)
+          shared_status_ = -1;
+        else if (shared_status_ == 0)
+          shared_status_ = 1;
+        unshared_ += n - static_cast<size_t>(max<int64_t>(done, 0));
+      }
+      first += n;
+      count -= n;
+    }
+  }
+
+  // Tells the shared store this process needs no rows before its oldest
+  // live order; other publishers' rows stay until they are past them too
+  void retire_shared()
+  {
+    uint64_t oldest = store_.segments().front()->first_ordinal;
+    while (!shared_runs_.empty() && shared_runs_.front().ordinal + shared_runs_.front().n <= oldest)
+      shared_runs_.pop_front();
+    uint64_t row = shared_end_;
+    if (!shared_runs_.empty())
+    {
+      const SharedRun &run = shared_runs_.front();
+      row = run.row + (oldest > run.ordinal ? oldest - run.ordinal : 0);
+    }
+    if (!shared_->retire(row))
+      shared_status_ = -1;
+  }
+
+  void index_row(uint32_t row_id, const PackedOrder &r)
+  {
+    uint32_t mask = Filter::of(r);
+    for (int i = 0; i < Filter::COUNT; ++i)
+      if (mask & (1u << i))
+        filters_[i].add(row_id);
+  }
+
+  // Indexes rows [start, start + count) of `seg` and feeds them to the
+  // aggregators a slice at a time; each row is built once, into `out` when
+  // given. Returns the built rows.
+  const PackedOrder *observe_slice(const OrderSegment &seg, size_t start, size_t count, int64_t at,
+                                   PackedOrder *out = nullptr)
+  {
+    if (!out)
+    {
+      slice_rows_.resize(count);
+      out = slice_rows_.data();
+    }
+    uint32_t first_row = (seg.seq << 16) | static_cast<uint32_t>(start);
+    for (size_t j = 0; j < count; ++j)
+    {
+      out[j] = seg.row(start + j);
+      index_row(first_row + static_cast<uint32_t>(j), out[j]);
+    }
+    windows_.observe(out, count, at);
+    quantiles_.observe(out, count, at);
+    top_.observe(out, count, seg.first_ordinal + start, seg.first_ordinal);
+    weight_index_.bulk_load(seg.weight_g.data() + start, first_row, count);
+    distance_index_.bulk_load(seg.distance_dam.data() + start, first_row, count);
+    return out;
+  }
+};
+
+// ==========================================
+// Journal Replay ⏪
+// ==========================================
+
+namespace ReplayStage
+{
+  constexpr int READ = 0;
+  constexpr int DECODE = 1;
+  constexpr int PROCESS = 2;
+  constexpr int VERIFY = 3;
+  constexpr int COUNT = 4;
+}
+
+// Outcome of a replay; latencies are per order frame, in microseconds,
+// indexed by ReplayStage
+struct ReplayStats
+{
+  int64_t orders;
+  int64_t frames;
+  int64_t mismatches;
+  int64_t first_mismatch_id; // -1 if every decision matched
+  int64_t truncated;         // 1 if the journal ended in a cut-off frame
+  double seconds;
+  double mean_us[ReplayStage::COUNT];
+  double p50_us[ReplayStage::COUNT];
+  double p99_us[ReplayStage::COUNT];
+  double max_us[ReplayStage::COUNT];
+};
+
+// Reads frames from a file through a large buffer; bodies are handed out
+// 8-byte aligned (copied aside when they are not in place)
+class FrameReader
+{
+  int fd_ = -1;
+  vector<uint64_t> buffer_;
+  vector<uint64_t> aligned_;
+  size_t begin_ = 0;
+  size_t end_ = 0;
+
+  char *bytes() { return reinterpret_cast<char *>(buffer_.data()); }
+
+  // Makes `n` bytes available from begin_; false at end of file
+  bool fill(size_t n)
+  {
+    if (end_ - begin_ >= n)
+      return true;
+    memmove(bytes(), bytes() + begin_, end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+    if (n > buffer_.size() * 8)
+      buffer_.resize((n + 7) / 8);
+    while (end_ < n)
+    {
+      ssize_t got = ::read(fd_, bytes() + end_, buffer_.size() * 8 - end_);
+      if (got < 0 && errno == EINTR)
+        continue;
+      if (got <= 0)
+        return false;
+      end_ += static_cast<size_t>(got);
+    }
+    return true;
+  }
+
+public:
+  FrameReader() = default;
+  FrameReader(const FrameReader &) = delete;
+  FrameReader &operator=(const FrameReader &) = delete;
+  ~FrameReader() { close(); }
+
+  bool open(const string &path, uint64_t offset)
+  {
+    close();
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0 || ::lseek(fd_, static_cast<off_t>(offset), SEEK_SET) < 0)
+      return false;
+    ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    buffer_.resize(Config::JOURNAL_BUFFER_BYTES / 2);
+    begin_ = end_ = 0;
+    return true;
+  }
+
+  void close()
+  {
+    if (fd_ >= 0)
+      ::close(fd_);
+    fd_ = -1;
+  }
+
+  // 1 with the next frame, 0 at a clean end of file, -1 on a damaged or cut-off frame
+  int next(WireHeader &h, const char *&body)
+  {
+    if (!fill(sizeof h))
+      return end_ == begin_ ? 0 : -1;
+    memcpy(&h, bytes() + begin_, sizeof h);
+    int64_t length = Wire::body_length(h);
+    if (length < 0 || !fill(sizeof h + static_cast<size_t>(length)))
+      return -1;
+    body = bytes() + begin_ + sizeof h;
+    begin_ += sizeof h + static_cast<size_t>(length);
+    if (reinterpret_cast<uintptr_t>(body) % 8)
+    {
+      aligned_.resize((static_cast<size_t>(length) + 7) / 8);
+      memcpy(aligned_.data(), body, static_cast<size_t>(length));
+      body = reinterpret_cast<const char *>(aligned_.data());
+    }
+    return 1;
+  }
+};
+
+// Feeds the order frames of a journal, from `offset` on, through a fresh
+// OrderManager and checks each result against the decision frames recorded
+// after it. `rate` caps orders per second (0 = as fast as possible);
+// `scalar` sends orders one at a time through TransportFactory instead of
+// process_frame. A cut-off frame at the end (a crash mid-append) ends the
+// replay like end of file, with `truncated` set and the stats covering the
+// whole frames before it; decision frames with no order frame ahead of them
+// (an offset between the two) are skipped. False if the journal cannot be
+// opened or a whole frame is malformed.
+inline bool replay_journal_file(const string &path, uint64_t offset, double rate, bool scalar, ReplayStats &stats)
+{
+  using Clock = chrono::steady_clock;
+  stats = ReplayStats{};
+  stats.first_mismatch_id = -1;
+  FrameReader in;
+  if (!in.open(path, offset))
+    return false;
+
+  auto manager = make_unique<OrderManager>();
+  vector<int64_t> latency[ReplayStage::COUNT];
+  vector<uint64_t> orders_body;
+  OrderBlock recorded;
+  WireHeader h;
+  const char *body;
+  auto start = Clock::now();
+  int got;
+  for (;;)
+  {
+    if (rate > 0)
+      this_thread::sleep_until(start + chrono::duration_cast<Clock::duration>(
+                                           chrono::duration<double>(static_cast<double>(stats.orders) / rate)));
+    int64_t spent[ReplayStage::COUNT] = {};
+    auto t0 = Clock::now();
+    if ((got = in.next(h, body)) != 1)
+      break;
+    if (h.type != Wire::ORDERS)
+      continue;
+
+    // The reader reuses its buffer, so the order body is kept aside while
+    // the decision frames behind it are read
+    orders_body.resize((h.body_length + 7) / 8);
+    memcpy(orders_body.data(), body, h.body_length);
+    OrderFrame frame;
+    auto t1 = Clock::now();
+    if (!decode_order_frame(h, reinterpret_cast<const char *>(orders_body.data()), frame))
+      return false;
+    auto t2 = Clock::now();
+
+    size_t first = manager->size();
+    if (scalar)
+      for (size_t i = 0; i < frame.rows; ++i)
+        manager->process({frame.ids[i], frame.weights[i], frame.distances[i], frame.urgent[i], frame.customers[i],
+                          frame.destinations[i]});
+    else
+      manager->process_frame(frame);
+    auto t3 = Clock::now();
+    spent[ReplayStage::READ] += (t1 - t0).count();
+    spent[ReplayStage::DECODE] += (t2 - t1).count();
+    spent[ReplayStage::PROCESS] += (t3 - t2).count();
+
+    size_t done = 0;
+    while (done < frame.rows)
+    {
+      auto r0 = Clock::now();
+      WireHeader dh;
+      if ((got = in.next(dh, body)) != 1)
+        break;
+      if (dh.type != Wire::DECISIONS || dh.rows == 0 || dh.rows > frame.rows - done)
+        return false;
+      auto r1 = Clock::now();
+      if (!decode_decision_frame(dh, body, recorded))
+        return false;
+      auto r2 = Clock::now();
+      for (size_t i = 0; i < recorded.size(); ++i)
+      {
+        PackedOrder want = recorded.row(i), have = manager->record(first + done + i);
+        if (have.id != want.id || have.weight_g != want.weight_g || have.distance_dam != want.distance_dam ||
+            have.meta != want.meta)
+        {
+          if (stats.mismatches++ == 0)
+            stats.first_mismatch_id = want.id;
+        }
+      }
+      done += recorded.size();
+      auto r3 = Clock::now();
+      spent[ReplayStage::READ] += (r1 - r0).count();
+      spent[ReplayStage::DECODE] += (r2 - r1).count();
+      spent[ReplayStage::VERIFY] += (r3 - r2).count();
+    }
+    if (done < frame.rows)
+    {
+      got = -1; // the decisions were cut off, so the frame does not count
+      break;
+    }
+    for (int s = 0; s < ReplayStage::COUNT; ++s)
+      latency[s].push_back(spent[s]);
+    stats.orders += static_cast<int64_t>(frame.rows);
+    ++stats.frames;
+  }
+  stats.seconds = chrono::duration<double>(Clock::now() - start).count();
+  stats.truncated = got < 0;
+
+  for (int s = 0; s < ReplayStage::COUNT; ++s)
+  {
+    vector<int64_t> &v = latency[s];
+    if (v.empty())
+      continue;
+    auto at = [&](double q)
+    {
+      auto nth = v.begin() + static_cast<ptrdiff_t>(q * static_cast<double>(v.size() - 1));
+      nth_element(v.begin(), nth, v.end());
+      return *nth / 1e3;
+    };
+    double total = 0;
+    for (int64_t ns : v)
+      total += static_cast<double>(ns);
+    stats.mean_us[s] = total / static_cast<double>(v.size()) / 1e3;
+    stats.p50_us[s] = at(0.5);
+    stats.p99_us[s] = at(0.99);
+    stats.max_us[s] = *max_element(v.begin(), v.end()) / 1e3;
+  }
+  return true;
+}
+
+// Feeds the order frames of a journal, from `offset` on, into `manager`
+// after a checkpoint load. Like Journal::open, an order frame counts only
+// once all the decision frames written with it follow, so a torn tail ends
+// the input. Returns the orders recovered, or -1 if the journal cannot be
+// read, holds an undecodable order frame, or `manager` is journaling.
+inline int64_t recover_journal_file(OrderManager &manager, const string &path, uint64_t offset)
+{
+  FrameReader in;
+  if (manager.journal() || !in.open(path, offset))
+    return -1;
+  vector<uint64_t> orders_body;
+  WireHeader orders{}, h;
+  const char *body;
+  uint64_t pending = 0; // rows of `orders` still without decisions
+  int64_t recovered = 0;
+  while (in.next(h, body) == 1)
+  {
+    if (h.type == Wire::ORDERS ? pending != 0 : h.rows == 0 || h.rows > pending)
+      break;
+    if (h.type == Wire::ORDERS)
+    {
+      orders = h;
+      orders_body.resize((h.body_length + 7) / 8);
+      memcpy(orders_body.data(), body, h.body_length);
+    }
+    pending = h.type == Wire::ORDERS ? h.rows : pending - h.rows;
+    if (pending)
+      continue;
+    OrderFrame frame;
+    if (!decode_order_frame(orders, reinterpret_cast<const char *>(orders_body.data()), frame))
+      return -1;
+    manager.process_frame(frame);
+    recovered += static_cast<int64_t>(frame.rows);
+  }
+  return recovered;
+}
+
+// ==========================================
+// Order Service 🌐
+// ==========================================
+
+struct AdmissionStats
+{
+  int64_t queued; // admitted, not yet classified
+  int64_t peak_queued;
+  int64_t admitted;
+  int64_t shed_overloaded;   // turned away at the queue bound
+  int64_t shed_rate_limited; // turned away by their client's bucket
+};
+
+namespace Admission
+{
+  constexpr int ADMITTED = 0;
+  constexpr int OVERLOADED = -2;
+  constexpr int RATE_LIMITED = -3;
+}
+
+// Decides which orders enter the serving layers. Admitted orders count
+// against max_queued until release(); each client (a peer address or a
+// process) also draws on its own token bucket, refilled at `rate` orders/s
+// up to `burst`. A rejection costs one lock and never queues, so under a
+// burst the excess fails fast instead of every caller slowing down.
+class AdmissionControl
+{
+  struct Bucket
+  {
+    double tokens;
+    int64_t last_ns;
+  };
+
+  mutex lock_;
+  unordered_map<uint64_t, Bucket> buckets_;
+  int64_t max_queued_ = Config::ADMISSION_MAX_QUEUED;
+  double rate_ = 0;
+  double burst_ = 1;
+  atomic<int64_t> queued_{0};
+  atomic<int64_t> peak_{0};
+  atomic<int64_t> admitted_{0};
+  atomic<int64_t> shed_overloaded_{0};
+  atomic<int64_t> shed_rate_limited_{0};
+
+  static int64_t now_ns()
+  {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  double refill(Bucket &b, int64_t now) const
+  {
+    b.tokens = min(burst_, b.tokens + static_cast<double>(now - b.last_ns) * 1e-9 * rate_);
+    b.last_ns = now;
+    return b.tokens;
+  }
+
+  // Drops the buckets that have refilled (their clients went quiet); if
+  // every client is active the map starts over, which errs on admitting
+  void prune(int64_t now)
+  {
+    for (auto it = buckets_.begin(); it != buckets_.end();)
+      it = refill(it->second, now) >= burst_ ? buckets_.erase(it) : next(it);
+    if (buckets_.size() >= Config::ADMISSION_MAX_CLIENTS)
+      buckets_.clear();
+  }
+
+public:
+  // max_queued 0 lifts the bound; rate 0 lifts the per-client limit
+  void configure(int64_t max_queued, double rate, double burst)
+  {
+    lock_guard<mutex> guard(lock_);
+    max_queued_ = max<int64_t>(max_queued, 0);
+    rate_ = rate > 0 ? rate : 0;
+    burst_ = max(burst, 1.0);
+    buckets_.clear();
+  }
+
+  // How many of the next n orders from `client` may enter (they are a
+  // prefix); when fewer than n, `reason` says why the rest may not. Nothing
+  // is counted as shed until the caller answers the rest with shed().
+  size_t admit(uint64_t client, size_t n, int &reason)
+  {
+    reason = Admission::ADMITTED;
+    lock_guard<mutex> guard(lock_);
+    size_t room = n;
+    int64_t queued = queued_.load(memory_order_relaxed);
+    if (max_queued_ > 0 && static_cast<int64_t>(n) > max_queued_ - queued)
+    {
+      room = static_cast<size_t>(max<int64_t>(max_queued_ - queued, 0));
+      reason = Admission::OVERLOADED;
+    }
+    if (rate_ > 0 && room > 0)
+    {
+      int64_t now = now_ns();
+      if (buckets_.size() >= Config::ADMISSION_MAX_CLIENTS && !buckets_.count(client))
+        prune(now);
+      Bucket &b = buckets_.try_emplace(client, Bucket{burst_, now}).first->second;
+      size_t tokens = static_cast<size_t>(refill(b, now));
+      if (tokens < room)
+      {
+        room = tokens;
+        reason = Admission::RATE_LIMITED;
+      }
+      b.tokens -= static_cast<double>(room);
+    }
+    queued = queued_.fetch_add(static_cast<int64_t>(room), memory_order_relaxed) + static_cast<int64_t>(room);
+    if (queued > peak_.load(memory_order_relaxed))
+      peak_.store(queued, memory_order_relaxed);
+    admitted_.fetch_add(static_cast<int64_t>(room), memory_order_relaxed);
+    return room;
+  }
+
+  // Admitted orders that have been classified
+  void release(size_t n) { queued_.fetch_sub(static_cast<int64_t>(n), memory_order_relaxed); }
+
+  // Orders answered with the reason admit() gave
+  void shed(int reason, size_t n)
+  {
+    if (n)
+      (reason == Admission::RATE_LIMITED ? shed_rate_limited_ : shed_overloaded_)
+          .fetch_add(static_cast<int64_t>(n), memory_order_relaxed);
+  }
+
+  AdmissionStats stats() const
+  {
+    return {queued_.load(memory_order_relaxed), peak_.load(memory_order_relaxed), admitted_.load(memory_order_relaxed),
+            shed_overloaded_.load(memory_order_relaxed), shed_rate_limited_.load(memory_order_relaxed)};
+  }
+};
+
+// Thread-safe front of an OrderManager for the serving layers; the C API
+// itself stays single-threaded. Callers submit groups of orders (an event
+// loop's worth of pipelined requests); a group of several goes through
+// process_batch. With micro-batching on, concurrent groups are merged: the
+// first caller to find no batch forming waits up to the window (or until
+// max_orders are queued), classifies the whole queue in one process_batch
+// and wakes the others, each with its own results.
+class OrderService
+{
+  struct Pending
+  {
+    const OrderDetails *orders;
+    size_t count;
+    PackedOrder *results;
+    size_t first_row = 0;
+    bool done = false;
+  };
+
+  OrderManager &manager_;
+  mutex lock_;
+  mutex queue_lock_;
+  condition_variable queue_full_;
+  condition_variable completed_;
+  vector<Pending *> queue_;
+  size_t queued_ = 0;
+  bool forming_ = false;
+  atomic<int64_t> window_us_{0};
+  atomic<size_t> max_orders_{1};
+  atomic<int64_t> batches_{0};
+  atomic<int64_t> batched_{0};
+  AdmissionControl admission_;
+
+  // Classifies the groups in one call under the manager lock
+  void run(Pending *const *groups, size_t count)
+  {
+    static thread_local vector<int> ids;
+    static thread_local vector<double> weights, distances;
+    static thread_local vector<uint64_t> customers, destinations;
+    static thread_local vector<char> urgent;
+    ids.clear();
+    weights.clear();
+    distances.clear();
+    customers.clear();
+    destinations.clear();
+    urgent.clear();
+    for (size_t g = 0; g < count; ++g)
+      for (size_t i = 0; i < groups[g]->count; ++i)
+      {
+        const OrderDetails &d = groups[g]->orders[i];
+        ids.push_back(d.id);
+        weights.push_back(d.weight_kg);
+        distances.push_back(d.distance_km);
+        urgent.push_back(d.urgent);
+        customers.push_back(d.customer_id);
+        destinations.push_back(d.destination_id);
+      }
+    size_t n = ids.size();
+    // Records come back from the manager itself: retention may already have
+    // dropped the rows they were stored in
+    static thread_local vector<PackedOrder> records;
+    records.resize(n);
+    lock_guard<mutex> guard(lock_);
+    size_t row = n == 1 ? manager_.process(groups[0]->orders[0], records.data())
+                        : manager_.process_batch(ids.data(), weights.data(), distances.data(),
+                                                 reinterpret_cast<const bool *>(urgent.data()), n, customers.data(),
+                                                 destinations.data(), records.data());
+    const PackedOrder *next = records.data();
+    for (size_t g = 0; g < count; ++g)
+    {
+      groups[g]->first_row = row;
+      row += groups[g]->count;
+      copy(next, next + groups[g]->count, groups[g]->results);
+      next += groups[g]->count;
+    }
+    batches_.fetch_add(1, memory_order_relaxed);
+    batched_.fetch_add(static_cast<int64_t>(n), memory_order_relaxed);
+  }
+
+public:
+  explicit OrderService(OrderManager &manager) : manager_(manager) {}
+
+  // Classifies and stores `count` orders, writing their records to
+  // `results`; returns the row of the first, the rest follow it
+  size_t submit(const OrderDetails *orders, size_t count, PackedOrder *results)
+  {
+    if (count == 0)
+      return 0;
+    Pending pending{orders, count, results};
+    Pending *self = &pending;
+    if (window_us_.load(memory_order_relaxed) <= 0 || max_orders_.load(memory_order_relaxed) <= 1)
+    {
+      run(&self, 1);
+      return pending.first_row;
+    }
+
+    unique_lock<mutex> queue(queue_lock_);
+    queue_.push_back(self);
+    queued_ += count;
+    if (forming_)
+    {
+      if (queued_ >= max_orders_.load(memory_order_relaxed))
+        queue_full_.notify_one();
+      completed_.wait(queue, [&] { return pending.done; });
+      return pending.first_row;
+    }
+    forming_ = true;
+    queue_full_.wait_for(queue, chrono::microseconds(window_us_.load(memory_order_relaxed)),
+                         [&] { return queued_ >= max_orders_.load(memory_order_relaxed); });
+    static thread_local vector<Pending *> batch;
+    batch.clear();
+    batch.swap(queue_);
+    queued_ = 0;
+    forming_ = false;
+    queue.unlock();
+
+    run(batch.data(), batch.size());
+    queue.lock();
+    for (Pending *p : batch)
+      p->done = true;
+    queue.unlock();
+    completed_.notify_all();
+    return pending.first_row;
+  }
+
+  // Submits collect for up to `window_us` or `max_orders` orders, whichever
+  // comes first; a window of 0 (the default) runs each group as it comes
+  void set_batching(int64_t window_us, size_t max_orders)
+  {
+    window_us_ = max<int64_t>(window_us, 0);
+    max_orders_ = max<size_t>(max_orders, 1);
+  }
+
+  // Batches run and the orders they carried, to tune the window against
+  int64_t batches() const { return batches_; }
+  int64_t batched_orders() const { return batched_; }
+
+  // Every serving layer admits orders here before submitting them
+  AdmissionControl &admission() { return admission_; }
+
+  // Runs `f` on the manager under the lock
+  template <class F>
+  auto locked(F &&f)
+  {
+    lock_guard<mutex> guard(lock_);
+    return f(manager_);
+  }
+};
+
+// The /process_order body: {"weight": w, "distance": d, "urgent": "true"}.
+// Numbers may also come as numeric strings (the page sends input values);
+// like the Flask handler, only the string "true" makes an order urgent.
+// Unknown keys and nested values are skipped.
+class OrderRequestParser
+{
+  const char *p_;
+  const char *end_;
+
+  void ws()
+  {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r'))
+      ++p_;
+  }
+
+  bool eat(char c)
+  {
+    ws();
+    if (p_ == end_ || *p_ != c)
+      return false;
+    ++p_;
+    return true;
+  }
+
+  // A string with its escapes left in place; none of the fields read need them
+  bool text(string_view &out)
+  {
+    if (!eat('"'))
+      return false;
+    const char *start = p_;
+    while (p_ < end_ && *p_ != '"')
+      p_ += *p_ == '\\' ? 2 : 1;
+    if (p_ >= end_)
+      return false;
+    out = string_view(start, static_cast<size_t>(p_ - start));
+    ++p_;
+    return true;
+  }
+
+  // A number, true, false or null as its raw token
+  bool token(string_view &out)
+  {
+    ws();
+    const char *start = p_;
+    while (p_ < end_ && (isalnum(static_cast<unsigned char>(*p_)) || *p_ == '-' || *p_ == '+' || *p_ == '.'))
+      ++p_;
+    out = string_view(start, static_cast<size_t>(p_ - start));
+    return !out.empty();
+  }
+
+  bool skip(int depth)
+  {
+    ws();
+    string_view ignored;
+    if (p_ == end_ || depth > 32)
+      return false;
+    if (*p_ == '"')
+      return text(ignored);
+    if (*p_ != '{' && *p_ != '[')
+      return token(ignored);
+    char close = *p_ == '{' ? '}' : ']';
+    ++p_;
+    if (eat(close))
+      return true;
+    do
+    {
+      if (close == '}' && !(text(ignored) && eat(':')))
+        return false;
+      if (!skip(depth + 1))
+        return false;
+    } while (eat(','));
+    return eat(close);
+  }
+
+  // float(): surrounding spaces and a leading '+' are allowed, the rest must parse
+  static bool number(string_view s, double &out)
+  {
+    while (!s.empty() && isspace(static_cast<unsigned char>(s.front())))
+      s.remove_prefix(1);
+    while (!s.empty() && isspace(static_cast<unsigned char>(s.back())))
+      s.remove_suffix(1);
+    if (!s.empty() && s.front() == '+')
+      s.remove_prefix(1);
+    auto res = from_chars(s.data(), s.data() + s.size(), out);
+    return !s.empty() && res.ec == errc() && res.ptr == s.data() + s.size() && isfinite(out);
+  }
+
+public:
+  // False unless the body is an object with finite weight and distance
+  bool parse(string_view body, double &weight, double &distance, bool &urgent)
+  {
+    p_ = body.data();
+    end_ = body.data() + body.size();
+    bool has_weight = false, has_distance = false;
+    urgent = false;
+    if (!eat('{'))
+      return false;
+    if (!eat('}'))
+    {
+      do
+      {
+        string_view key, value;
+        if (!text(key) || !eat(':'))
+          return false;
+        ws();
+        bool quoted = p_ < end_ && *p_ == '"';
+        if (key == "weight" || key == "distance" || key == "urgent")
+        {
+          if (!(quoted ? text(value) : token(value)))
+            return false;
+          if (key == "urgent")
+            urgent = quoted && value == "true";
+          else if (key == "weight")
+            has_weight = number(value, weight);
+          else
+            has_distance = number(value, distance);
+        }
+        else if (!skip(0))
+          return false;
+      } while (eat(','));
+      if (!eat('}'))
+        return false;
+    }
+    return has_weight && has_distance;
+  }
+};
+
+// Appends a double the way Python's json does: repr(float), the shortest
+// round trip, in positional notation with ".0" on integral values when the
+// decimal exponent is in [-4, 16) and as d.ddde+XX otherwise
+inline void append_json_number(string &out, double value)
+{
+  if (!isfinite(value))
+  {
+    out.append(value != value ? "NaN" : (value < 0 ? "-Infinity" : "Infinity"));
+    return;
+  }
+  char text[32];
+  auto res = to_chars(text, text + sizeof text, value, chars_format::scientific);
+  string_view sci(text, static_cast<size_t>(res.ptr - text));
+  size_t e = sci.find('e');
+  int exponent = 0;
+  from_chars(sci.data() + e + (sci[e + 1] == '+' ? 2 : 1), sci.data() + sci.size(), exponent);
+  string_view mantissa = sci.substr(0, e);
+  if (mantissa[0] == '-')
+  {
+    out.push_back('-');
+    mantissa.remove_prefix(1);
+  }
+  char digits[20];
+  size_t n = 0;
+  for (char c : mantissa)
+    if (c != '.')
+      digits[n++] = c;
+
+  if (exponent < -4 || exponent >= 16)
+  {
+    out.append(mantissa);
+    out.push_back('e');
+    out.push_back(exponent < 0 ? '-' : '+');
+    if (abs(exponent) < 10)
+      out.push_back('0');
+    out.append(to_string(abs(exponent)));
+  }
+  else if (exponent < 0)
+  {
+    out.append("0.");
+    out.append(static_cast<size_t>(-exponent - 1), '0');
+    out.append(digits, n);
+  }
+  else
+  {
+    size_t whole = static_cast<size_t>(exponent) + 1;
+    out.append(digits, min(n, whole));
+    out.append(whole > n ? whole - n : 0, '0');
+    out.push_back('.');
+    if (n > whole)
+      out.append(digits + whole, n - whole);
+    else
+      out.push_back('0');
+  }
+}
+
+inline bool iequals(string_view a, string_view b)
+{
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); ++i)
+    if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i])))
+      return false;
+  return true;
+}
+
+// HTTP/1.1 front end for POST /process_order. Each loop thread owns a
+// SO_REUSEPORT listener and an edge-triggered epoll set, so the kernel
+// spreads connections across loops and a connection stays on one core.
+// Connections are kept alive and may pipeline; responses are formatted
+// straight into the connection's output buffer, which is reused, and
+// everything ready goes out in one send().
+class HttpOrderServer
+{
+  struct Connection
+  {
+    int fd = -1;
+    uint64_t client = 0; // peer IPv4 address, for admission
+    string in;
+    string out;
+    size_t sent = 0;
+    size_t waiting = 0; // orders parsed but not yet answered
+    bool closing = false;
+    bool peer_closed = false;
+    bool throttled = false; // stopped parsing at the output limit
+    bool touched = false;
+  };
+
+  // An order in the loop's batch and where its answer goes
+  struct Slot
+  {
+    Connection *connection;
+    bool close;
+  };
+
+  class Loop
+  {
+    HttpOrderServer &server_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int spare_fd_ = -1; // held back for shedding connections once out of descriptors
+    vector<unique_ptr<Connection>> connections_; // by fd
+    mt19937 ids_{random_device{}()};
+    string body_;
+    vector<OrderDetails> orders_;
+    vector<PackedOrder> results_;
+    vector<Slot> slots_;
+    vector<Connection *> touched_;
+    vector<Connection *> again_;
+
+    void drop(Connection &c)
+    {
+      ::close(c.fd);
+      connections_[static_cast<size_t>(c.fd)].reset();
+      if (spare_fd_ < 0)
+        rearm();
+    }
+
+    // Takes the spare descriptor back once one is free and re-arms the
+    // listener, so connections left queued raise a fresh edge
+    void rearm()
+    {
+      spare_fd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+      epoll_event ev{};
+      ev.events = EPOLLIN | EPOLLET;
+      ev.data.fd = listen_fd_;
+      ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, listen_fd_, &ev);
+    }
+
+    // Out of descriptors: the edge-triggered listener will not fire again
+    // for connections already queued, so the spare descriptor makes room to
+    // accept each one and turn it away with a 503. False if none was queued
+    // or the spare is gone.
+    bool shed_one()
+    {
+      static constexpr string_view BUSY = "HTTP/1.1 503 Service Unavailable\r\nContent-Type: application/json\r\n"
+                                          "Content-Length: 24\r\nConnection: close\r\n\r\n{\"error\": \"server busy\"}";
+      if (spare_fd_ < 0)
+        return false;
+      ::close(spare_fd_);
+      int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd >= 0)
+      {
+        ::send(fd, BUSY.data(), BUSY.size(), MSG_NOSIGNAL);
+        ::close(fd);
+      }
+      spare_fd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+      return fd >= 0;
+    }
+
+    void accept_all()
+    {
+      for (;;)
+      {
+        sockaddr_in peer{};
+        socklen_t peer_size = sizeof peer;
+        int fd = ::accept4(listen_fd_, reinterpret_cast<sockaddr *>(&peer), &peer_size, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0 && (errno == EINTR || errno == ECONNABORTED))
+          continue;
+        if (fd < 0 && (errno == EMFILE || errno == ENFILE) && shed_one())
+          continue;
+        if (fd < 0)
+          return;
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+        if (connections_.size() <= static_cast<size_t>(fd))
+          connections_.resize(static_cast<size_t>(fd) + 1);
+        connections_[static_cast<size_t>(fd)] = make_unique<Connection>();
+        connections_[static_cast<size_t>(fd)]->fd = fd;
+        connections_[static_cast<size_t>(fd)]->client = ntohl(peer.sin_addr.s_addr);
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = fd;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0)
+          drop(*connections_[static_cast<size_t>(fd)]);
+      }
+    }
+
+    void respond(Connection &c, int status, string_view reason, string_view body, bool close)
+    {
+      c.out.append("HTTP/1.1 ").append(to_string(status)).append(" ").append(reason);
+      c.out.append("\r\nContent-Type: application/json\r\nContent-Length: ").append(to_string(body.size()));
+      c.out.append(close ? "\r\nConnection: close\r\n\r\n" : "\r\n\r\n").append(body);
+      c.closing = c.closing || close;
+    }
+
+    void answer_order(Connection &c, const OrderDetails &d, const PackedOrder &r, bool close)
+    {
+      TextBuffer info, eta;
+      static constexpr string_view TYPES[] = {"truck", "ship", "air"};
+
+      // Keys in the order Flask's jsonify sorts them; the texts need no escaping
+      body_.assign(R"({"distance":)");
+      append_json_number(body_, d.distance_km);
+      body_.append(R"(,"eta":")").append(format_eta(r, eta));
+      body_.append(R"(","id":)").append(to_string(d.id));
+      body_.append(R"(,"info":")").append(format_info(r, info));
+      body_.append(R"(","type":")").append(TYPES[static_cast<int>(r.kind())]);
+      body_.append(R"(","urgent":)").append(d.urgent ? "true" : "false");
+      body_.append(R"(,"weight":)");
+      append_json_number(body_, d.weight_kg);
+      body_.append("}");
+      respond(c, 200, "OK", body_, close);
+    }
+
+    // Parses the complete requests in c.in. Orders join the loop's batch;
+    // other answers are written at once, unless orders parsed before them
+    // are still waiting, in which case parsing stops until the batch is
+    // answered. A malformed request is answered and closes the connection.
+    void handle(Connection &c)
+    {
+      if (!c.touched)
+      {
+        c.touched = true;
+        touched_.push_back(&c);
+      }
+      size_t at = 0;
+      c.throttled = false;
+      for (;;)
+      {
+        if (c.closing)
+          break;
+        if (c.out.size() - c.sent >= Config::HTTP_MAX_PENDING_OUTPUT)
+        {
+          c.throttled = true;
+          break;
+        }
+        string_view rest(c.in.data() + at, c.in.size() - at);
+        size_t head_end = rest.find("\r\n\r\n");
+        if (head_end == string_view::npos)
+        {
+          if (rest.size() > Config::HTTP_MAX_HEADER_BYTES && !c.waiting)
+            respond(c, 431, "Request Header Fields Too Large", R"({"error": "headers too large"})", true);
+          break;
+        }
+        string_view head = rest.substr(0, head_end);
+        size_t line_end = head.find("\r\n");
+        string_view line = head.substr(0, line_end);
+        size_t sp1 = line.find(' '), sp2 = line.rfind(' ');
+        if ((sp1 == string_view::npos || sp2 <= sp1) && c.waiting)
+          break;
+        if (sp1 == string_view::npos || sp2 <= sp1)
+        {
+          respond(c, 400, "Bad Request", R"({"error": "malformed request"})", true);
+          break;
+        }
+        string_view method = line.substr(0, sp1), target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+        bool close = line.substr(sp2 + 1) != "HTTP/1.1";
+        size_t length = 0;
+        bool chunked = false;
+        for (size_t pos = line_end; pos != string_view::npos && pos < head.size();)
+        {
+          size_t next = head.find("\r\n", pos + 2);
+          string_view field = head.substr(pos + 2, next == string_view::npos ? string_view::npos : next - pos - 2);
+          pos = next;
+          size_t colon = field.find(':');
+          if (colon == string_view::npos)
+            continue;
+          string_view name = field.substr(0, colon), value = field.substr(colon + 1);
+          while (!value.empty() && value.front() == ' ')
+            value.remove_prefix(1);
+          if (iequals(name, "content-length"))
+            from_chars(value.data(), value.data() + value.size(), length);
+          else if (iequals(name, "transfer-encoding"))
+            chunked = true;
+          else if (iequals(name, "connection"))
+            close = iequals(value, "close") || (close && !iequals(value, "keep-alive"));
+        }
+        if (c.waiting && (chunked || length > Config::HTTP_MAX_BODY_BYTES))
+          break;
+        if (chunked || length > Config::HTTP_MAX_BODY_BYTES)
+        {
+          respond(c, 413, "Payload Too Large", R"({"error": "body too large or chunked"})", true);
+          break;
+        }
+        if (rest.size() < head_end + 4 + length)
+          break;
+        string_view body = rest.substr(head_end + 4, length);
+        OrderDetails order{};
+        bool valid = target == "/process_order" && method == "POST" &&
+                     OrderRequestParser().parse(body, order.weight_kg, order.distance_km, order.urgent);
+        int refused = Admission::ADMITTED;
+        bool admitted = valid && server_.service_.admission().admit(c.client, 1, refused) == 1;
+        // Answers go out in request order, so one that is not an order
+        // waits for the batch; a refused order is offered again then
+        if (!admitted && c.waiting)
+          break;
+        at += head_end + 4 + length;
+        if (admitted)
+        {
+          order.id = uniform_int_distribution<int>(1000, 9999)(ids_);
+          orders_.push_back(order);
+          slots_.push_back({&c, close});
+          ++c.waiting;
+          c.closing = close;
+        }
+        else if (refused == Admission::OVERLOADED)
+        {
+          server_.service_.admission().shed(refused, 1);
+          respond(c, 503, "Service Unavailable", R"({"error": "over capacity"})", close);
+        }
+        else if (refused == Admission::RATE_LIMITED)
+        {
+          server_.service_.admission().shed(refused, 1);
+          respond(c, 429, "Too Many Requests", R"({"error": "rate limited"})", close);
+        }
+        else if (target != "/process_order")
+          respond(c, 404, "Not Found", R"({"error": "not found"})", close);
+        else if (method != "POST")
+          respond(c, 405, "Method Not Allowed", R"({"error": "use POST"})", close);
+        else
+          respond(c, 400, "Bad Request", R"({"error": "weight and distance must be numbers"})", close);
+      }
+      c.in.erase(0, at);
+    }
+
+    // Classifies the loop's batch in one submit and answers each order;
+    // connections held up behind their orders are parsed again, which may
+    // start another batch
+    void complete()
+    {
+      while (!orders_.empty())
+      {
+        results_.resize(orders_.size());
+        server_.service_.submit(orders_.data(), orders_.size(), results_.data());
+        server_.service_.admission().release(orders_.size());
+        for (size_t i = 0; i < orders_.size(); ++i)
+        {
+          Connection &c = *slots_[i].connection;
+          answer_order(c, orders_[i], results_[i], slots_[i].close);
+          --c.waiting;
+        }
+        orders_.clear();
+        slots_.clear();
+        for (size_t i = 0, n = touched_.size(); i < n; ++i)
+          if (!touched_[i]->closing && !touched_[i]->in.empty())
+            handle(*touched_[i]);
+      }
+    }
+
+    // Sends what is queued; false once the connection is gone
+    bool flush(Connection &c)
+    {
+      while (c.sent < c.out.size())
+      {
+        ssize_t n = ::send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+          continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+          return true;
+        if (n <= 0)
+          return false;
+        c.sent += static_cast<size_t>(n);
+      }
+      c.out.clear();
+      c.sent = 0;
+      return !c.closing;
+    }
+
+    void receive(Connection &c, uint32_t events)
+    {
+      c.peer_closed = c.peer_closed || (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR));
+      if (events & EPOLLIN)
+        for (;;)
+        {
+          size_t used = c.in.size();
+          c.in.resize(used + 16384);
+          ssize_t n = ::recv(c.fd, &c.in[used], 16384, 0);
+          c.in.resize(used + static_cast<size_t>(max<ssize_t>(n, 0)));
+          if (n > 0)
+            continue;
+          if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+            c.peer_closed = true;
+          if (n == 0 || errno != EINTR)
+            break;
+        }
+      handle(c);
+    }
+
+    // Sends every touched connection's answers; one whose output drained
+    // while requests were held back by the output limit goes round again
+    void finish()
+    {
+      for (Connection *c : touched_)
+      {
+        c->touched = false;
+        bool alive = flush(*c);
+        if (!alive || (c->peer_closed && c->out.empty() && !c->throttled))
+          drop(*c);
+        else if (c->throttled && c->out.empty())
+          again_.push_back(c);
+      }
+      touched_.clear();
+    }
+  public:
+    explicit Loop(HttpOrderServer &server) : server_(server) {}
+    Loop(const Loop &) = delete;
+    Loop &operator=(const Loop &) = delete;
+
+    ~Loop()
+    {
+      for (auto &c : connections_)
+        if (c)
+          ::close(c->fd);
+      if (epoll_fd_ >= 0)
+        ::close(epoll_fd_);
+      if (listen_fd_ >= 0)
+        ::close(listen_fd_);
+      if (spare_fd_ >= 0)
+        ::close(spare_fd_);
+    }
+
+    bool listen(int port)
+    {
+      listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      spare_fd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+      int one = 1;
+      sockaddr_in addr{};
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(static_cast<uint16_t>(port));
+      addr.sin_addr.s_addr = htonl(INADDR_ANY);
+      epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+      epoll_event listen_ev{}, stop_ev{};
+      listen_ev.events = EPOLLIN | EPOLLET;
+      listen_ev.data.fd = listen_fd_;
+      stop_ev.events = EPOLLIN;
+      stop_ev.data.fd = server_.stop_fd_;
+      return listen_fd_ >= 0 && epoll_fd_ >= 0 &&
+             ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEPORT, &one, sizeof one) == 0 &&
+             ::bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof addr) == 0 &&
+             ::listen(listen_fd_, 4096) == 0 &&
+             ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &listen_ev) == 0 &&
+             ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, server_.stop_fd_, &stop_ev) == 0;
+    }
+
+    // Each round reads every ready connection, answers all the orders they
+    // carried with one submit, then sends
+    void run()
+    {
+      epoll_event events[256];
+      vector<Connection *> again;
+      for (;;)
+      {
+        int n = ::epoll_wait(epoll_fd_, events, 256, again_.empty() ? -1 : 0);
+        again.swap(again_);
+        for (Connection *c : again)
+          handle(*c);
+        again.clear();
+        for (int i = 0; i < n; ++i)
+        {
+          int fd = events[i].data.fd;
+          if (fd == server_.stop_fd_)
+            return;
+          if (fd == listen_fd_)
+            accept_all();
+          else if (static_cast<size_t>(fd) < connections_.size() && connections_[static_cast<size_t>(fd)])
+            receive(*connections_[static_cast<size_t>(fd)], events[i].events);
+        }
+        complete();
+        finish();
+      }
+    }
+  };
+
+  OrderService &service_;
+  int stop_fd_ = -1;
+
+public:
+  explicit HttpOrderServer(OrderService &service) : service_(service)
+  {
+    stop_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  }
+  HttpOrderServer(const HttpOrderServer &) = delete;
+  HttpOrderServer &operator=(const HttpOrderServer &) = delete;
+  ~HttpOrderServer() { ::close(stop_fd_); }
+
+  // Serves on `port` with `threads` loops (0 = one per allowed CPU, each
+  // pinned to its CPU) until stop(); false if the port cannot be bound
+  bool run(int port, unsigned threads)
+  {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    vector<int> allowed;
+    if (::sched_getaffinity(0, sizeof cpus, &cpus) == 0)
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET(cpu, &cpus))
+          allowed.push_back(cpu);
+    bool pin = threads == 0 && !allowed.empty();
+    if (threads == 0)
+      threads = max<unsigned>(1, static_cast<unsigned>(allowed.size()));
+
+    vector<unique_ptr<Loop>> loops;
+    for (unsigned i = 0; i < threads; ++i)
+    {
+      loops.push_back(make_unique<Loop>(*this));
+      if (!loops.back()->listen(port))
+        return false;
+    }
+    vector<thread> workers;
+    for (unsigned i = 0; i < threads; ++i)
+      workers.emplace_back([&, i]
+      {
+        if (pin)
+        {
+          cpu_set_t one;
+          CPU_ZERO(&one);
+          CPU_SET(allowed[i], &one);
+          ::pthread_setaffinity_np(pthread_self(), sizeof one, &one);
+        }
+        loops[i]->run();
+      });
+    for (auto &worker : workers)
+      worker.join();
+    uint64_t drained;
+    ssize_t reset = ::read(stop_fd_, &drained, sizeof drained);
+    (void)reset; // only clears the stop signal for the next run
+    return true;
+  }
+
+  // Makes run() return; safe to call from a signal handler
+  void stop()
+  {
+    uint64_t one = 1;
+    ssize_t signalled = ::write(stop_fd_, &one, sizeof one);
+    (void)signalled;
+  }
+};
+
+// ==========================================
+// Order Daemon 🔌
+// ==========================================
+
+// Fixed 32-byte messages over a Unix domain socket. A client may write any
+// number of requests before reading; responses come back in request order
+// and echo the request's seq.
+struct DaemonRequest
+{
+  uint16_t op;
+  uint16_t flags;
+  uint32_t seq;
+  int32_t id;
+  uint32_t urgent;
+  double weight_kg;
+  double distance_km;
+};
+static_assert(sizeof(DaemonRequest) == 32, "daemon request is 32 bytes");
+
+struct DaemonResponse
+{
+  uint16_t op;
+  int16_t status;
+  uint32_t seq;
+  int64_t value;      // COUNT: orders held; SUBMIT: orders held after it
+  PackedOrder record; // SUBMIT: the decision
+};
+static_assert(sizeof(DaemonResponse) == 32, "daemon response is 32 bytes");
+
+namespace Daemon
+{
+  constexpr uint16_t SUBMIT = 1;
+  constexpr uint16_t RESET = 2;
+  constexpr uint16_t COUNT = 3;
+
+  constexpr int16_t OK = 0;
+  constexpr int16_t BAD_REQUEST = -1;
+  constexpr int16_t OVERLOADED = Admission::OVERLOADED;
+  constexpr int16_t RATE_LIMITED = Admission::RATE_LIMITED;
+}
+
+// Owns nothing but the socket: every request goes to an OrderService, one
+// lock acquisition per batch of requests read together
+class OrderDaemon
+{
+  struct Connection
+  {
+    int fd = -1;
+    uint64_t client = 0; // peer process, for admission
+    string in;
+    string out;
+    size_t sent = 0;
+  };
+
+  OrderService &service_;
+  int stop_fd_ = -1;
+  vector<OrderDetails> orders_;
+  vector<PackedOrder> results_;
+
+  static DaemonRequest request(const Connection &c, size_t i)
+  {
+    DaemonRequest req;
+    memcpy(&req, c.in.data() + i * sizeof req, sizeof req);
+    return req;
+  }
+
+  static bool submittable(const DaemonRequest &req)
+  {
+    return req.op == Daemon::SUBMIT && isfinite(req.weight_kg) && isfinite(req.distance_km);
+  }
+
+  // Everything but a valid order, which goes through the service
+  static DaemonResponse answer(OrderManager &manager, const DaemonRequest &req)
+  {
+    DaemonResponse res{};
+    res.op = req.op;
+    res.seq = req.seq;
+    switch (req.op)
+    {
+    case Daemon::RESET:
+      manager.clear();
+      break;
+    case Daemon::COUNT:
+      break;
+    default:
+      res.status = Daemon::BAD_REQUEST;
+    }
+    res.value = static_cast<int64_t>(manager.size());
+    return res;
+  }
+
+  // Answers every whole request read so far into c.out
+  void answer_all(Connection &c)
+  {
+    size_t whole = c.in.size() / sizeof(DaemonRequest);
+    size_t at = c.out.size();
+    c.out.resize(at + whole * sizeof(DaemonResponse));
+    auto put = [&](size_t i, const DaemonResponse &res) { memcpy(&c.out[at + i * sizeof res], &res, sizeof res); };
+    for (size_t i = 0; i < whole;)
+    {
+      DaemonRequest req = request(c, i);
+      if (!submittable(req))
+      {
+        put(i, service_.locked([&](OrderManager &manager) { return answer(manager, req); }));
+        ++i;
+        continue;
+      }
+      // A run of orders goes to the service in groups of at most
+      // Config::DAEMON_MAX_BATCH. Each group is admitted as far as there is
+      // room and offered again for the rest, so only a queue already full
+      // of other orders answers OVERLOADED; what admission refuses is
+      // answered with its reason.
+      orders_.clear();
+      size_t end = min(whole, i + Config::DAEMON_MAX_BATCH);
+      for (size_t j = i; j < end && submittable(req = request(c, j)); ++j)
+        orders_.push_back({req.id, req.weight_kg, req.distance_km, req.urgent != 0});
+      results_.resize(orders_.size());
+      int refused = Admission::ADMITTED;
+      size_t done = 0;
+      while (done < orders_.size() && refused != Admission::RATE_LIMITED)
+      {
+        size_t admitted = service_.admission().admit(c.client, orders_.size() - done, refused);
+        if (admitted == 0)
+          break;
+        size_t row = service_.submit(orders_.data() + done, admitted, results_.data() + done);
+        service_.admission().release(admitted);
+        for (size_t k = done; k < done + admitted; ++k)
+        {
+          DaemonResponse res{};
+          res.op = Daemon::SUBMIT;
+          res.seq = request(c, i + k).seq;
+          res.value = static_cast<int64_t>(row + (k - done) + 1);
+          res.record = results_[k];
+          put(i + k, res);
+        }
+        done += admitted;
+      }
+      service_.admission().shed(refused, orders_.size() - done);
+      for (size_t k = done; k < orders_.size(); ++k)
+      {
+        DaemonResponse res{};
+        res.op = Daemon::SUBMIT;
+        res.seq = request(c, i + k).seq;
+        res.status = static_cast<int16_t>(refused);
+        put(i + k, res);
+      }
+      i += orders_.size();
+    }
+    c.in.erase(0, whole * sizeof(DaemonRequest));
+  }
+
+  // Sends queued answers until done or the socket is full; false on error
+  static bool flush(Connection &c)
+  {
+    while (c.sent < c.out.size())
+    {
+      ssize_t n = ::send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return true;
+      if (n <= 0)
+        return false;
+      c.sent += static_cast<size_t>(n);
+    }
+    c.out.clear();
+    c.sent = 0;
+    return true;
+  }
+
+  // Reads, answers and sends one chunk at a time. A client that writes
+  // without reading stops being read once its unsent answers pass
+  // Config::DAEMON_MAX_PENDING_OUTPUT; EPOLLOUT brings it back here when
+  // the socket drains. False once the connection is finished.
+  bool serve(Connection &c)
+  {
+    for (;;)
+    {
+      if (!flush(c))
+        return false;
+      if (c.out.size() - c.sent > Config::DAEMON_MAX_PENDING_OUTPUT)
+        return true;
+      size_t used = c.in.size();
+      c.in.resize(used + 65536);
+      ssize_t n = ::recv(c.fd, &c.in[used], 65536, 0);
+      c.in.resize(used + static_cast<size_t>(max<ssize_t>(n, 0)));
+      if (n > 0)
+        answer_all(c);
+      else if (n == 0 || errno != EINTR)
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+  }
+
+public:
+  explicit OrderDaemon(OrderService &service) : service_(service)
+  {
+    stop_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  }
+  OrderDaemon(const OrderDaemon &) = delete;
+  OrderDaemon &operator=(const OrderDaemon &) = delete;
+  ~OrderDaemon() { ::close(stop_fd_); }
+
+  // Listens on `path` (replacing a stale socket file) and serves until
+  // stop(); false if the socket cannot be created or another daemon still
+  // answers there
+  bool run(const string &path)
+  {
+    sockaddr_un addr{};
+    if (path.empty() || path.size() >= sizeof addr.sun_path)
+      return false;
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    // Only a socket nobody listens on is stale: a live daemon accepts the
+    // probe, and any other file stays put
+    struct stat existing;
+    if (::lstat(path.c_str(), &existing) == 0)
+    {
+      int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      bool stale = probe >= 0 && S_ISSOCK(existing.st_mode) &&
+                   ::connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof addr) != 0 && errno == ECONNREFUSED;
+      if (probe >= 0)
+        ::close(probe);
+      if (!stale)
+        return false;
+      ::unlink(path.c_str());
+    }
+    int listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    epoll_event listen_ev{}, stop_ev{};
+    listen_ev.events = EPOLLIN | EPOLLET;
+    listen_ev.data.fd = listen_fd;
+    stop_ev.events = EPOLLIN;
+    stop_ev.data.fd = stop_fd_;
+    bool ok = listen_fd >= 0 && epoll_fd >= 0 &&
+              ::bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) == 0 &&
+              ::listen(listen_fd, 4096) == 0 && ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &listen_ev) == 0 &&
+              ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd_, &stop_ev) == 0;
+    bool listening = ok;
+
+    vector<unique_ptr<Connection>> connections; // by fd
+    int spare_fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC); // held back for shedding clients once out of descriptors
+    // Closes a client; once a descriptor is free again the spare is taken
+    // back and the listener re-armed, so clients left queued raise a fresh edge
+    auto drop = [&](int fd)
+    {
+      ::close(fd);
+      connections[static_cast<size_t>(fd)].reset();
+      if (spare_fd >= 0)
+        return;
+      spare_fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+      ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, listen_fd, &listen_ev);
+    };
+    // Out of descriptors: the edge-triggered listener will not fire again
+    // for clients already queued, so the spare descriptor makes room to
+    // accept each one and close it. False if none was queued or the spare
+    // is gone.
+    auto shed_one = [&]
+    {
+      if (spare_fd < 0)
+        return false;
+      ::close(spare_fd);
+      int client = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (client >= 0)
+        ::close(client);
+      spare_fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+      return client >= 0;
+    };
+    epoll_event events[256];
+    while (ok)
+    {
+      int n = ::epoll_wait(epoll_fd, events, 256, -1);
+      for (int i = 0; i < n && ok; ++i)
+      {
+        int fd = events[i].data.fd;
+        if (fd == stop_fd_)
+          ok = false;
+        else if (fd == listen_fd)
+          for (;;)
+          {
+            int client = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (client < 0 && (errno == EINTR || errno == ECONNABORTED))
+              continue;
+            if (client < 0 && (errno == EMFILE || errno == ENFILE) && shed_one())
+              continue;
+            if (client < 0)
+              break;
+            if (connections.size() <= static_cast<size_t>(client))
+              connections.resize(static_cast<size_t>(client) + 1);
+            connections[static_cast<size_t>(client)] = make_unique<Connection>();
+            connections[static_cast<size_t>(client)]->fd = client;
+            ucred peer{};
+            socklen_t peer_size = sizeof peer;
+            if (::getsockopt(client, SOL_SOCKET, SO_PEERCRED, &peer, &peer_size) == 0)
+              connections[static_cast<size_t>(client)]->client = static_cast<uint64_t>(peer.pid);
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            ev.data.fd = client;
+            if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client, &ev) != 0)
+              drop(client);
+          }
+        else if (static_cast<size_t>(fd) < connections.size() && connections[static_cast<size_t>(fd)] &&
+                 !serve(*connections[static_cast<size_t>(fd)]))
+          drop(fd);
+      }
+    }
+    for (auto &c : connections)
+      if (c)
+        ::close(c->fd);
+    if (spare_fd >= 0)
+      ::close(spare_fd);
+    if (epoll_fd >= 0)
+      ::close(epoll_fd);
+    if (listen_fd >= 0)
+    {
+      ::close(listen_fd);
+      ::unlink(path.c_str());
+    }
+    uint64_t drained;
+    ssize_t reset = ::read(stop_fd_, &drained, sizeof drained);
+    (void)reset;
+    return listening;
+  }
+
+  // Makes run() return; safe to call from a signal handler
+  void stop()
+  {
+    uint64_t one = 1;
+    ssize_t signalled = ::write(stop_fd_, &one, sizeof one);
+    (void)signalled;
+  }
+};
+
+// One daemon connection; requests are written in one go and the responses
+// read back in order
+class DaemonClient
+{
+  int fd_ = -1;
+  pid_t pid_ = 0; // a forked child must not share its parent's connection
+  uint32_t seq_ = 0;
+  vector<DaemonRequest> requests_;
+  vector<DaemonResponse> responses_;
+
+public:
+  DaemonClient() = default;
+  DaemonClient(const DaemonClient &) = delete;
+  DaemonClient &operator=(const DaemonClient &) = delete;
+  ~DaemonClient() { close(); }
+
+  bool connected() const { return fd_ >= 0 && pid_ == ::getpid(); }
+
+  bool connect(const string &path)
+  {
+    close();
+    pid_ = ::getpid();
+    sockaddr_un addr{};
+    if (path.empty() || path.size() >= sizeof addr.sun_path)
+      return false;
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ >= 0 && ::connect(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof addr) == 0)
+      return true;
+    close();
+    return false;
+  }
+
+  void close()
+  {
+    if (fd_ >= 0)
+      ::close(fd_);
+    fd_ = -1;
+    requests_.clear();
+  }
+
+  // Queues a request; call() sends everything queued
+  void add(uint16_t op, int32_t id = 0, double weight_kg = 0, double distance_km = 0, bool urgent = false)
+  {
+    requests_.push_back({op, 0, seq_++, id, urgent ? 1u : 0u, weight_kg, distance_km});
+  }
+
+  // Sends the queued requests and reads their responses; nullptr (and a
+  // closed connection) on a transport error. The daemon stops reading a
+  // client that leaves Config::DAEMON_MAX_PENDING_OUTPUT of answers unread,
+  // so a longer pipeline goes out that much at a time.
+  const DaemonResponse *call()
+  {
+    constexpr size_t WINDOW = Config::DAEMON_MAX_PENDING_OUTPUT / sizeof(DaemonResponse);
+    size_t n = requests_.size();
+    responses_.resize(n);
+    bool ok = fd_ >= 0;
+    for (size_t i = 0; ok && i < n; i += WINDOW)
+    {
+      size_t m = min(WINDOW, n - i);
+      ok = send_all(fd_, requests_.data() + i, m * sizeof(DaemonRequest)) &&
+           read_all(fd_, responses_.data() + i, m * sizeof(DaemonResponse)) == m * sizeof(DaemonResponse);
+    }
+    for (size_t i = 0; ok && i < n; ++i)
+      ok = responses_[i].seq == requests_[i].seq;
+    requests_.clear();
+    if (!ok)
+      close();
+    return ok ? responses_.data() : nullptr;
+  }
+};
+
+// ==========================================
+// C Interface for Python (Extern C)
+// ==========================================
+
+// Global instances to persist state between Python calls
+static BusinessCalendar calendar_instance;
+static OrderManager manager_instance;
+static string last_output_buffer;
+static thread_local TextBuffer last_text_buffer;
+static thread_local string last_frame_buffer;
+static OrderService service_instance(manager_instance);
+static HttpOrderServer http_server_instance(service_instance);
+static OrderDaemon daemon_instance(service_instance);
+static mutex daemon_path_lock;
+static string daemon_path;
+static thread_local DaemonClient daemon_client;
+static thread_local int daemon_status = Daemon::OK;
+static SharedOrderStore shared_reader_instance;
+
+// This thread's daemon connection, opened on first use; nullptr if down
+static DaemonClient *daemon_connection()
+{
+  if (!daemon_client.connected())
+  {
+    string path;
+    {
+      lock_guard<mutex> guard(daemon_path_lock);
+      path = daemon_path;
+    }
+    if (!daemon_client.connect(path))
+      return nullptr;
+  }
+  return &daemon_client;
+}
+
+static int list_range(const RangeIndex &index, int32_t lo, int32_t hi, int *out_ids, int max_ids)
+{
+  vector<pair<int32_t, uint32_t>> hits;
+  index.for_each(lo, hi, [&](int32_t key, uint32_t row)
+  {
+    if (manager_instance.is_live(row))
+      hits.emplace_back(key, row);
+  });
+  sort(hits.begin(), hits.end());
+  int written = 0;
+  for (size_t i = 0; i < hits.size() && written < max_ids; ++i)
+    out_ids[written++] = manager_instance.order_id(hits[i].second);
+  return static_cast<int>(hits.size());
+}
+
+extern "C"
+{
+  // Add an order to the system
+  void add_order(int id, double weight, double distance, bool urgent)
+  {
+    OrderDetails d{id, weight, distance, urgent};
+    manager_instance.process(d);
+  }
+
+  // Get the formatted log of all orders
+  const char *get_orders_log()
+  {
+    last_output_buffer.clear();
+    manager_instance.append_summary(last_output_buffer);
+    return last_output_buffer.c_str();
+  }
+
+  // Same as add_order, with customer and destination ids (0 = unknown)
+  void add_order_ex(int id, double weight, double distance, bool urgent, uint64_t customer_id, uint64_t destination_id)
+  {
+    OrderDetails d{id, weight, distance, urgent, customer_id, destination_id};
+    manager_instance.process(d);
+  }
+
+  // Columnar batch ingest of n orders (same rules as add_order)
+  void add_orders_batch(const int *ids, const double *weights, const double *distances, const bool *urgent, int n)
+  {
+    if (n > 0)
+      manager_instance.process_batch(ids, weights, distances, urgent, static_cast<size_t>(n));
+  }
+
+  // Batch ingest with optional (NULL) customer and destination id columns
+  void add_orders_batch_ex(const int *ids, const double *weights, const double *distances, const bool *urgent,
+                           const uint64_t *customer_ids, const uint64_t *destination_ids, int n)
+  {
+    if (n > 0)
+      manager_instance.process_batch(ids, weights, distances, urgent, static_cast<size_t>(n), customer_ids,
+                                     destination_ids);
+  }
+
+  // Ingest every order frame in data[0, size). Returns the order count, or
+  // -1 at the first malformed frame (frames before it are kept).
+  int64_t add_order_frames(const void *data, int64_t size)
+  {
+    const char *p = static_cast<const char *>(data);
+    const char *end = p + max<int64_t>(size, 0);
+    vector<uint64_t> aligned;
+    int64_t orders = 0;
+    while (p < end)
+    {
+      WireHeader h;
+      if (static_cast<size_t>(end - p) < sizeof h)
+        return -1;
+      memcpy(&h, p, sizeof h);
+      int64_t length = Wire::body_length(h);
+      if (length < 0 || end - p - static_cast<int64_t>(sizeof h) < length)
+        return -1;
+      const char *body = p + sizeof h;
+      if (reinterpret_cast<uintptr_t>(body) % 8)
+      {
+        aligned.resize(static_cast<size_t>(length) / 8);
+        memcpy(aligned.data(), body, static_cast<size_t>(length));
+        body = reinterpret_cast<const char *>(aligned.data());
+      }
+      OrderFrame frame;
+      if (h.type != Wire::ORDERS || !decode_order_frame(h, body, frame))
+        return -1;
+      manager_instance.process_frame(frame);
+      orders += frame.rows;
+      p += sizeof h + static_cast<size_t>(length);
+    }
+    return orders;
+  }
+
+  // Same, reading frames from a file, pipe or socket until end of stream
+  int64_t read_order_frames(int fd)
+  {
+    vector<uint64_t> body;
+    int64_t orders = 0;
+    WireHeader h;
+    size_t got;
+    while ((got = read_all(fd, &h, sizeof h)) == sizeof h)
+    {
+      int64_t length = Wire::body_length(h);
+      if (length < 0 || h.type != Wire::ORDERS)
+        return -1;
+      body.resize(static_cast<size_t>(length) / 8);
+      OrderFrame frame;
+      if (read_all(fd, body.data(), static_cast<size_t>(length)) != static_cast<size_t>(length) ||
+          !decode_order_frame(h, reinterpret_cast<const char *>(body.data()), frame))
+        return -1;
+      manager_instance.process_frame(frame);
+      orders += frame.rows;
+    }
+    return got == 0 ? orders : -1;
+  }
+
+  // Decision frames for live orders [first, first + count) in a buffer owned
+  // by the library (valid until the next call on this thread)
+  const void *get_decision_frames(int64_t first, int64_t count, int64_t *size)
+  {
+    last_frame_buffer.clear();
+    if (first >= 0 && count > 0)
+      manager_instance.append_decisions(last_frame_buffer, static_cast<size_t>(first), static_cast<size_t>(count));
+    *size = static_cast<int64_t>(last_frame_buffer.size());
+    return last_frame_buffer.data();
+  }
+
+  // Same, written to a file descriptor a segment at a time; returns the
+  // bytes written or -1
+  int64_t write_decision_frames(int fd, int64_t first, int64_t count)
+  {
+    const int64_t step = static_cast<int64_t>(Config::SEGMENT_ROWS);
+    int64_t written = 0;
+    for (int64_t at = first; count > 0; at += step, count -= step)
+    {
+      int64_t size;
+      const void *data = get_decision_frames(at, min(count, step), &size);
+      if (size == 0)
+        break;
+      if (!write_all(fd, data, static_cast<size_t>(size)))
+        return -1;
+      written += size;
+    }
+    return written;
+  }
+
+  // Filter bits: 1 truck, 2 ship, 4 air, 8 urgent, 16 heavy, 32 reserved, 64 express
+  int count_orders_where(int all_of, int any_of, int none_of)
+  {
+    return static_cast<int>(manager_instance.filter(all_of, any_of, none_of).cardinality());
+  }
+
+  // Writes up to max_ids matching order ids in arrival order; returns the total match count
+  int list_orders_where(int all_of, int any_of, int none_of, int *out_ids, int max_ids)
+  {
+    RoaringBitmap rows = manager_instance.filter(all_of, any_of, none_of);
+    int written = 0;
+    rows.for_each([&](uint32_t row)
+    {
+      if (written < max_ids)
+        out_ids[written++] = manager_instance.order_id(row);
+    });
+    return static_cast<int>(rows.cardinality());
+  }
+
+  // Range queries with inclusive bounds at gram / 10 m resolution; pass
+  // +-inf for an open side. Lists are ordered by the queried value and
+  // return the total match count.
+  int count_orders_by_weight(double min_kg, double max_kg)
+  {
+    return static_cast<int>(manager_instance.weight_index().count(
+        grid_key(min_kg, Config::WEIGHT_SCALE, false), grid_key(max_kg, Config::WEIGHT_SCALE, true)));
+  }
+
+  int count_orders_by_distance(double min_km, double max_km)
+  {
+    return static_cast<int>(manager_instance.distance_index().count(
+        grid_key(min_km, Config::DISTANCE_SCALE, false), grid_key(max_km, Config::DISTANCE_SCALE, true)));
+  }
+
+  int list_orders_by_weight(double min_kg, double max_kg, int *out_ids, int max_ids)
+  {
+    return list_range(manager_instance.weight_index(), grid_key(min_kg, Config::WEIGHT_SCALE, false),
+                      grid_key(max_kg, Config::WEIGHT_SCALE, true), out_ids, max_ids);
+  }
+
+  int list_orders_by_distance(double min_km, double max_km, int *out_ids, int max_ids)
+  {
+    return list_range(manager_instance.distance_index(), grid_key(min_km, Config::DISTANCE_SCALE, false),
+                      grid_key(max_km, Config::DISTANCE_SCALE, true), out_ids, max_ids);
+  }
+
+  // Filters and ranges together, e.g. urgent AND ship AND weight > 500 kg
+  int count_orders_matching(int all_of, int any_of, int none_of, double min_kg, double max_kg, double min_km,
+                            double max_km)
+  {
+    RoaringBitmap rows = manager_instance.filter(all_of, any_of, none_of);
+    return static_cast<int>(manager_instance.within(std::move(rows), min_kg, max_kg, min_km, max_km).cardinality());
+  }
+
+  // Latest n one-minute windows (newest first, up to 120); returns the count written
+  int get_order_windows(int n, OrderWindow *out)
+  {
+    return n > 0 ? static_cast<int>(manager_instance.windows().latest(now_ms(), static_cast<size_t>(n), out)) : 0;
+  }
+
+  // Rolling totals and averages over the last `minutes` minutes
+  void get_sliding_window(int minutes, OrderWindow *out)
+  {
+    *out = manager_instance.windows().sliding(now_ms(), static_cast<size_t>(max(minutes, 1)));
+  }
+
+  // Approximate quantile q (0..1) of metric 0 = ETA days, 1 = weight kg,
+  // 2 = distance km for kind 0-2 (-1 = all); NaN without data
+  double get_order_quantile(int metric, int kind, double q)
+  {
+    if (metric < 0 || metric >= Metric::COUNT || kind < -1 || kind > 2)
+      return NAN;
+    return manager_instance.quantiles().quantile(metric, kind, q);
+  }
+
+  // Same over the last `minutes` one-minute windows
+  double get_window_quantile(int metric, int kind, double q, int minutes)
+  {
+    if (metric < 0 || metric >= Metric::COUNT || kind < -1 || kind > 2)
+      return NAN;
+    return manager_instance.quantiles().window_quantile(metric, kind, q, now_ms(),
+                                                        static_cast<size_t>(max(minutes, 1)));
+  }
+
+  // Estimated distinct customers (what = 0) or routes (what = 1) for kind 0-2
+  // (-1 = all); days = 0 for all time, else the last 1-7 days
+  double get_distinct_count(int what, int kind, int days)
+  {
+    if (what < 0 || what > 1 || kind < -1 || kind > 2 || days < 0)
+      return 0.0;
+    return manager_instance.distinct().estimate(what, kind, static_cast<size_t>(days), now_ms());
+  }
+
+  // Largest orders by metric 0 = weight (kg), 1 = distance (km), 2 = ETA days
+  // of urgent orders, for kind 0-2 (-1 = all). Writes up to k (max 100) ids
+  // and values, largest first; returns the number written.
+  int get_top_orders(int metric, int kind, int k, int *out_ids, double *out_values)
+  {
+    if (metric < 0 || metric >= TopMetric::COUNT || kind < -1 || kind > 2 || k <= 0)
+      return 0;
+    double scale = metric == TopMetric::HEAVIEST ? Config::WEIGHT_SCALE
+                                                 : (metric == TopMetric::LONGEST ? Config::DISTANCE_SCALE : 1.0);
+    vector<TopEntry> top = manager_instance.top().top(metric, kind, static_cast<size_t>(k));
+    for (size_t i = 0; i < top.size(); ++i)
+    {
+      out_ids[i] = top[i].id;
+      if (out_values)
+        out_values[i] = static_cast<double>(top[i].value) / scale;
+    }
+    return static_cast<int>(top.size());
+  }
+
+  int get_order_count()
+  {
+    return static_cast<int>(manager_instance.size());
+  }
+
+  // 0 = Truck, 1 = Ship, 2 = Air, -1 if out of range
+  int get_order_kind(int index)
+  {
+    if (index < 0 || static_cast<size_t>(index) >= manager_instance.size())
+      return -1;
+    return static_cast<int>(manager_instance.record(index).kind());
+  }
+
+  // Info/ETA text of one order. The pointer stays valid until the next call
+  // on the same thread; NULL if out of range.
+  const char *get_order_info(int index)
+  {
+    if (index < 0 || static_cast<size_t>(index) >= manager_instance.size())
+      return nullptr;
+    return format_info(manager_instance.record(index), last_text_buffer).data();
+  }
+
+  const char *get_order_eta(int index)
+  {
+    if (index < 0 || static_cast<size_t>(index) >= manager_instance.size())
+      return nullptr;
+    return manager_instance.eta_text(manager_instance.record(index), last_text_buffer).data();
+  }
+
+  // Clear memory/reset Allows Python to clear the list without restarting the process.
+  void reset_system()
+  {
+    manager_instance.clear();
+    last_output_buffer.clear();
+  }
+
+  // Keep only the newest max_orders orders and/or those from the last
+  // max_hours hours (0 = no limit); older ones are dropped a segment at a
+  // time, so up to max_orders + 65535 orders stay live
+  void set_retention(int64_t max_orders, double max_hours)
+  {
+    RetentionPolicy policy;
+    policy.max_orders = max_orders > 0 ? static_cast<size_t>(max_orders) : 0;
+    policy.max_age_ms = max_hours > 0 ? static_cast<int64_t>(max_hours * 3600.0 * 1000.0) : 0;
+    manager_instance.set_retention(policy);
+  }
+
+  // Keep order records plus indexes and sketches within max_bytes of RAM
+  // (0 = no limit); older segments spill to mapped files in spill_dir. Returns 0, or -1 if
+  // spill_dir is not a writable directory.
+  int set_memory_budget(int64_t max_bytes, const char *spill_dir)
+  {
+    size_t bytes = max_bytes > 0 ? static_cast<size_t>(max_bytes) : 0;
+    return manager_instance.set_memory_budget(bytes, spill_dir ? spill_dir : "") ? 0 : -1;
+  }
+
+  // Journal every ingested order and its decision to `path` (appended as
+  // wire frames). backend: 0 = io_uring if available, else writer threads;
+  // 1 = io_uring only; 2 = writer threads. Returns the backend used or -1.
+  int open_journal(const char *path, int backend)
+  {
+    return manager_instance.open_journal(path, backend);
+  }
+
+  // Wait for pending journal writes and stop journaling; 0, or -1 if a write failed
+  int close_journal()
+  {
+    return manager_instance.close_journal() ? 0 : -1;
+  }
+
+  // Hand buffered journal frames to the backend now
+  void flush_journal()
+  {
+    if (Journal *j = manager_instance.journal())
+      j->flush();
+  }
+
+  // Orders journaled since open_journal and fsynced to disk
+  int64_t get_journal_durable()
+  {
+    Journal *j = manager_instance.journal();
+    return j ? j->durable() : -1;
+  }
+
+  // eventfd that becomes readable whenever the durable count moves (-1 without a journal)
+  int get_journal_eventfd()
+  {
+    Journal *j = manager_instance.journal();
+    return j ? j->event_fd() : -1;
+  }
+
+  // Called from the writer thread with the durable count after each completion
+  void set_journal_callback(void (*callback)(int64_t durable_orders, void *context), void *context)
+  {
+    if (Journal *j = manager_instance.journal())
+      j->set_callback(callback, context);
+  }
+
+  // Block until `orders` orders are durable: 0, 1 on timeout, -1 on write failure or no journal
+  int wait_journal(int64_t orders, int timeout_ms)
+  {
+    Journal *j = manager_instance.journal();
+    return j ? j->wait(orders, timeout_ms) : -1;
+  }
+
+  // Writes a checkpoint of the store to `path` from a forked child; 0 when
+  // started, 1 if one is still running, -1 on error
+  int start_checkpoint(const char *path)
+  {
+    return path ? manager_instance.start_checkpoint(path) : -1;
+  }
+
+  // 1 running, 0 done (the journal prefix it covers is released), -1 failed
+  int checkpoint_status()
+  {
+    return manager_instance.checkpoint_status();
+  }
+
+  // How long the last start_checkpoint() held up ingestion
+  double get_checkpoint_pause_ms()
+  {
+    return manager_instance.checkpoint_pause_ms();
+  }
+
+  // Replaces the orders with a checkpoint; returns the journal offset to
+  // replay from, or -1
+  int64_t load_checkpoint(const char *path)
+  {
+    return path ? manager_instance.load_checkpoint(path) : -1;
+  }
+
+  // Serves POST /process_order over HTTP on `port` until stop_order_server();
+  // threads 0 runs one pinned loop per CPU. Returns 0, or -1 if the port
+  // cannot be bound.
+  int run_order_server(int port, int threads)
+  {
+    return http_server_instance.run(port, static_cast<unsigned>(max(threads, 0))) ? 0 : -1;
+  }
+
+  // Async-signal-safe
+  void stop_order_server()
+  {
+    http_server_instance.stop();
+  }
+
+  // Micro-batching for the HTTP server and the daemon: orders arriving
+  // within `window_us` of each other, up to `max_orders`, are classified
+  // in one batch. A window of 0 turns it off.
+  void set_micro_batch(int64_t window_us, int max_orders)
+  {
+    service_instance.set_batching(window_us, static_cast<size_t>(max(max_orders, 1)));
+  }
+
+  // Batches classified by the serving layer and the orders they carried
+  void get_micro_batch_stats(int64_t *batches, int64_t *orders)
+  {
+    if (batches)
+      *batches = service_instance.batches();
+    if (orders)
+      *orders = service_instance.batched_orders();
+  }
+
+  // Admission for the serving layers and submit_order: at most max_queued
+  // orders admitted but unclassified (0 = unbounded; 65536 by default), and
+  // per client at most `orders_per_sec` with bursts of `burst` (0 = no limit)
+  void set_admission(int64_t max_queued, double orders_per_sec, double burst)
+  {
+    service_instance.admission().configure(max_queued, orders_per_sec, burst);
+  }
+
+  void get_admission_stats(AdmissionStats *out)
+  {
+    if (out)
+      *out = service_instance.admission().stats();
+  }
+
+  // Thread-safe add_order through admission, for callers serving many
+  // clients; `client` keys the token bucket. Returns the kind (0 Truck,
+  // 1 Ship, 2 Air), -1 for a bad order, -2 over capacity or -3 rate limited.
+  int submit_order(int64_t client, int id, double weight, double distance, bool urgent)
+  {
+    if (!isfinite(weight) || !isfinite(distance))
+      return -1;
+    AdmissionControl &admission = service_instance.admission();
+    int refused = Admission::ADMITTED;
+    if (admission.admit(static_cast<uint64_t>(client), 1, refused) == 0)
+    {
+      admission.shed(refused, 1);
+      return refused;
+    }
+    OrderDetails d{id, weight, distance, urgent};
+    PackedOrder record;
+    service_instance.submit(&d, 1, &record);
+    admission.release(1);
+    return static_cast<int>(record.kind());
+  }
+
+  // Owns the order book for other processes: serves the daemon protocol on
+  // a Unix socket at `socket_path` until stop_order_daemon(). Returns 0, or
+  // -1 if the socket cannot be created or another daemon is live there.
+  int run_order_daemon(const char *socket_path)
+  {
+    return socket_path && daemon_instance.run(socket_path) ? 0 : -1;
+  }
+
+  // Async-signal-safe
+  void stop_order_daemon()
+  {
+    daemon_instance.stop();
+  }
+
+  // Points the daemon_* calls of every thread at `socket_path` and connects
+  // this one; 0, or -1 if the daemon is not reachable
+  int connect_order_daemon(const char *socket_path)
+  {
+    if (!socket_path)
+      return -1;
+    {
+      lock_guard<mutex> guard(daemon_path_lock);
+      daemon_path = socket_path;
+    }
+    daemon_client.close();
+    return daemon_connection() ? 0 : -1;
+  }
+
+  // add_order through the daemon; returns the order's log line (as in
+  // get_orders_log) in a per-thread buffer, or nullptr if the daemon is
+  // unreachable or rejects the order (see get_daemon_status)
+  const char *daemon_add_order(int id, double weight, double distance, bool urgent)
+  {
+    DaemonClient *client = daemon_connection();
+    daemon_status = Daemon::BAD_REQUEST;
+    if (!client)
+      return nullptr;
+    client->add(Daemon::SUBMIT, id, weight, distance, urgent);
+    const DaemonResponse *res = client->call();
+    if (!res)
+      return nullptr;
+    daemon_status = res->status;
+    if (res->status != Daemon::OK)
+      return nullptr;
+    TextBuffer info, eta;
+    last_text_buffer.clear();
+    last_text_buffer.append("[Order #").append(res->record.id).append("] ");
+    last_text_buffer.append(format_info(res->record, info)).append(" -> ETA: ").append(format_eta(res->record, eta));
+    return last_text_buffer.c_str();
+  }
+
+  // Pipelines n orders to the daemon in one write; fills out_kinds (0 Truck,
+  // 1 Ship, 2 Air, or the status it was rejected with) if given. Returns
+  // the orders the daemon holds afterwards, or -1.
+  int64_t daemon_add_orders(const int *ids, const double *weights, const double *distances, const bool *urgent,
+                            int64_t n, int *out_kinds)
+  {
+    DaemonClient *client = daemon_connection();
+    if (!client || n < 0)
+      return -1;
+    for (int64_t i = 0; i < n; ++i)
+      client->add(Daemon::SUBMIT, ids[i], weights[i], distances[i], urgent[i]);
+    client->add(Daemon::COUNT);
+    const DaemonResponse *res = client->call();
+    if (!res)
+      return -1;
+    for (int64_t i = 0; out_kinds && i < n; ++i)
+      out_kinds[i] = res[i].status == Daemon::OK ? static_cast<int>(res[i].record.kind()) : res[i].status;
+    return res[n].value;
+  }
+
+  // Why this thread's last daemon_add_order returned nullptr: -1 bad order
+  // or daemon unreachable, -2 daemon over capacity, -3 client rate limited
+  int get_daemon_status()
+  {
+    return daemon_status;
+  }
+
+  // reset_system / get_order_count on the daemon's book; -1 if unreachable
+  int64_t daemon_reset()
+  {
+    DaemonClient *client = daemon_connection();
+    if (!client)
+      return -1;
+    client->add(Daemon::RESET);
+    const DaemonResponse *res = client->call();
+    return res ? 0 : -1;
+  }
+
+  int64_t daemon_order_count()
+  {
+    DaemonClient *client = daemon_connection();
+    if (!client)
+      return -1;
+    client->add(Daemon::COUNT);
+    const DaemonResponse *res = client->call();
+    return res ? res->value : -1;
+  }
+
+  // Publishes every order processed from now on to the shared-memory store
+  // `name` (created with room for `capacity` orders if it does not exist);
+  // up to 64 processes may publish to one store. Retention and reset_system()
+  // release this process's rows there, and rows leave the store once every
+  // publisher has released them. 0, or -1.
+  int share_orders(const char *name, int64_t capacity)
+  {
+    return name && capacity >= 0 && manager_instance.share(name, static_cast<uint64_t>(capacity)) ? 0 : -1;
+  }
+
+  void unshare_orders()
+  {
+    manager_instance.unshare();
+  }
+
+  // Retires every order in the shared store, whichever process published
+  // it, and bumps its epoch; 0, or -1 if not sharing
+  int clear_shared_orders()
+  {
+    return manager_instance.clear_shared() ? 0 : -1;
+  }
+
+  // 0 if the last orders all reached the shared store, 1 if it was full for
+  // some of them, -1 if the store failed. `unshared` (may be NULL) receives
+  // the orders left out since share_orders().
+  int get_share_status(int64_t *unshared)
+  {
+    if (unshared)
+      *unshared = static_cast<int64_t>(manager_instance.unshared());
+    return manager_instance.share_status();
+  }
+
+  // Maps an existing shared store for the shared_* reads below; 0, or -1
+  int attach_shared_orders(const char *name)
+  {
+    return name && shared_reader_instance.open(name, 0) ? 0 : -1;
+  }
+
+  // Removes the store's name; mappings stay valid until they are closed
+  int unlink_shared_orders(const char *name)
+  {
+    return name && SharedOrderStore::unlink(name) ? 0 : -1;
+  }
+
+  // One past the newest order of the attached store; orders are numbered
+  // from its creation, so this never goes down
+  int64_t get_shared_order_count()
+  {
+    return static_cast<int64_t>(shared_reader_instance.size());
+  }
+
+  // The oldest order retention and clears have left in the attached store
+  int64_t get_shared_first_order()
+  {
+    return static_cast<int64_t>(shared_reader_instance.first());
+  }
+
+  // How many times the attached store was cleared
+  int64_t get_shared_epoch()
+  {
+    return static_cast<int64_t>(shared_reader_instance.epoch());
+  }
+
+  // Copies orders [first, first + count) of the attached store, without any
+  // locking; any output array may be NULL. Returns the number copied, 0 if
+  // `first` was retired before or during the copy.
+  int64_t read_shared_orders(int64_t first, int64_t count, int *ids, int *kinds, int *eta_days)
+  {
+    int64_t size = static_cast<int64_t>(shared_reader_instance.size());
+    int64_t live = static_cast<int64_t>(shared_reader_instance.first());
+    int64_t n = first >= live && first < size ? min(count, size - first) : 0;
+    for (int64_t i = 0; i < n; ++i)
+    {
+      PackedOrder r = shared_reader_instance.row(static_cast<uint64_t>(first + i));
+      if (ids)
+        ids[i] = r.id;
+      if (kinds)
+        kinds[i] = static_cast<int>(r.kind());
+      if (eta_days)
+        eta_days[i] = r.eta_days();
+    }
+    // Slots are reused only once `first` has moved past their rows
+    atomic_thread_fence(memory_order_acquire);
+    if (n > 0 && static_cast<int64_t>(shared_reader_instance.first()) > first)
+      return 0;
+    return max<int64_t>(n, 0);
+  }
+
+  // Per-kind totals of the attached store as one consistent snapshot;
+  // start_ms is the time of its first order
+  void get_shared_totals(OrderWindow *out)
+  {
+    *out = shared_reader_instance.totals();
+  }
+
+  // Re-ingests the orders a journal holds from `offset` (what load_checkpoint
+  // returned, or 0) after the checkpoint was loaded; call it before
+  // open_journal. A torn last frame ends the input. Returns the orders
+  // recovered, or -1.
+  int64_t recover_journal(const char *path, int64_t offset)
+  {
+    if (!path || offset < 0)
+      return -1;
+    return recover_journal_file(manager_instance, path, static_cast<uint64_t>(offset));
+  }
+
+  // Replays a journal from `offset` (0, or what load_checkpoint returned)
+  // through a separate manager and checks its decisions; `rate` caps orders
+  // per second (0 = unlimited), `scalar` replays order by order. A cut-off
+  // last frame ends the replay (out->truncated = 1). Returns the orders
+  // replayed, or -1 if the journal is unreadable or malformed.
+  int64_t replay_journal(const char *path, int64_t offset, double rate, int scalar, ReplayStats *out)
+  {
+    ReplayStats stats;
+    if (!path || offset < 0 || !replay_journal_file(path, static_cast<uint64_t>(offset), rate, scalar != 0, stats))
+      return -1;
+    if (out)
+      *out = stats;
+    return stats.orders;
+  }
+
+  // Encode order files, decision frames and journal order frames with the
+  // column codecs (1) or write them plain (0, the default). Readers accept both.
+  void set_compression(int enabled)
+  {
+    manager_instance.set_compression(enabled != 0);
+  }
+
+  // Write every live order to an order file; returns the row count or -1
+  int64_t export_orders(const char *path)
+  {
+    return manager_instance.export_to(path) ? static_cast<int64_t>(manager_instance.size()) : -1;
+  }
+
+  // Write every live order as Arrow IPC: file format (1) or stream format (0).
+  // Returns the row count or -1.
+  int64_t export_orders_arrow(const char *path, int file_format)
+  {
+    return manager_instance.export_arrow(path, file_format != 0) ? static_cast<int64_t>(manager_instance.size()) : -1;
+  }
+
+  // Sort an order file by ETA, then distance, using about memory_mb of RAM
+  // and `threads` workers (0 = one per core); runs go to tmp_dir.
+  // Returns the row count or -1.
+  int64_t sort_order_file(const char *in_path, const char *out_path, const char *tmp_dir, int64_t memory_mb,
+                          int threads)
+  {
+    size_t bytes = static_cast<size_t>(max<int64_t>(memory_mb, 1)) << 20;
+    unsigned workers = threads > 0 ? static_cast<unsigned>(threads) : max(1u, thread::hardware_concurrency());
+    return external_sort(in_path, out_path, tmp_dir, bytes, workers, manager_instance.compression());
+  }
+
+  // Load per-region holidays; returns the number loaded or -1 if the file is unreadable
+  int load_holiday_calendar(const char *path)
+  {
+    return path ? calendar_instance.load(path) : -1;
+  }
+
+  // Set the dispatch date used for due dates in the log (region NULL/"" = weekends only)
+  int set_dispatch_date(const char *region, int year, int month, int day)
+  {
+    int idx = calendar_instance.region_index(region ? region : "");
+    if (idx < 0 || month < 1 || day < 1 || !valid_civil(year, static_cast<unsigned>(month), static_cast<unsigned>(day)))
+      return -1;
+    int start = days_from_civil(year, static_cast<unsigned>(month), static_cast<unsigned>(day));
+    if (!calendar_instance.contains(start))
+      return -1;
+    manager_instance.set_dispatch(&calendar_instance, idx, start);
+    return 0;
+  }
+
+  // Batch ETAs: day numbers since 1970-01-01 in and out, -1 where the result is unknown
+  void add_business_days_batch(const char *region, const int *start_days, const int *business_days, int *out_days,
+                               int n)
+  {
+    int idx = calendar_instance.region_index(region ? region : "");
+    for (int i = 0; i < n; ++i)
+      out_days[i] = calendar_instance.add_business_days(idx, start_days[i], business_days[i]);
   }
 }
\ No newline at end of file
@@ -0,0 +1,223 @@
+// Admission control must fail fast instead of queueing: a client's token
+// bucket admits its burst, then refills at its rate and never beyond the
+// burst, other clients keep their own buckets, and invalid orders draw no
+// tokens. With the queue bound reached by orders held in a micro-batch
+// window, further orders get -2 at once. The daemon answers the same
+// statuses for the refused suffix of a pipeline, and admits a long run on
+// its own in groups rather than shedding it. The stats count every
+// admitted and shed order, the peak depth, and a queue that drains to 0.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/admission.cpp -o admission ./logistics.so -pthread
+// Usage: admission [TMP_DIR]
+// Exits non-zero on failure.
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+struct AdmissionStats
+{
+  int64_t queued;
+  int64_t peak_queued;
+  int64_t admitted;
+  int64_t shed_overloaded;
+  int64_t shed_rate_limited;
+};
+
+extern "C"
+{
+  void reset_system();
+  int submit_order(int64_t client, int id, double weight, double distance, bool urgent);
+  void set_admission(int64_t max_queued, double orders_per_sec, double burst);
+  void get_admission_stats(AdmissionStats *out);
+  void set_micro_batch(int64_t window_us, int max_orders);
+  int run_order_daemon(const char *socket_path);
+  void stop_order_daemon();
+  int connect_order_daemon(const char *socket_path);
+  int64_t daemon_add_orders(const int *ids, const double *weights, const double *distances, const bool *urgent,
+                            int64_t n, int *out_kinds);
+  int64_t daemon_reset();
+  int64_t daemon_order_count();
+}
+
+static int submit(int64_t client, int id) { return submit_order(client, id, 40.0 + id % 300, 300.0, id % 3 == 0); }
+
+static AdmissionStats stats()
+{
+  AdmissionStats s{};
+  get_admission_stats(&s);
+  return s;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+  std::string dir = argc > 1 ? argv[1] : "/tmp";
+  std::string path = dir + "/admission-" + std::to_string(::getpid()) + ".sock";
+  int failures = 0;
+  auto check = [&](bool ok, const std::string &what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what.c_str());
+      ++failures;
+    }
+  };
+  reset_system();
+
+  // Token buckets: 1000 orders/s with bursts of 50 per client
+  set_admission(0, 1000.0, 50.0);
+  AdmissionStats before = stats();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 10; ++i)
+    check(submit_order(1, i, NAN, 300.0, false) == -1, "an invalid order: -1");
+  int admitted = 0, limited = 0, other = 0;
+  for (int i = 0; i < 200; ++i)
+  {
+    int r = submit(1, i);
+    (r >= 0 ? admitted : (r == -3 ? limited : other)) += 1;
+  }
+  // At most one token refills per millisecond
+  double refilled = seconds_since(start) * 1000.0 + 1;
+  check(other == 0, "client 1: only kinds and -3");
+  check(admitted >= 50 && admitted <= 50 + refilled, "client 1: the burst is admitted, then -3: " +
+                                                         std::to_string(admitted));
+  int second = 0;
+  for (int i = 0; i < 60; ++i)
+    second += submit(2, 1000 + i) >= 0;
+  check(second >= 50 && second < 60, "client 2 has its own bucket: " + std::to_string(second));
+  AdmissionStats after = stats();
+  check(after.admitted - before.admitted == admitted + second, "stats: admitted");
+  check(after.shed_rate_limited - before.shed_rate_limited == limited + 60 - second, "stats: shed rate limited");
+  check(after.shed_overloaded == before.shed_overloaded && after.queued == 0, "stats: nothing overloaded or queued");
+
+  // After 200 ms client 1 has refilled, but only up to its burst
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  start = std::chrono::steady_clock::now();
+  int refill = 0;
+  for (int i = 0; i < 100; ++i)
+    refill += submit(1, 2000 + i) >= 0;
+  check(refill >= 50 && refill <= 50 + seconds_since(start) * 1000.0 + 1,
+        "client 1 refills up to its burst: " + std::to_string(refill));
+
+  // Queue bound: eight orders held in a 300 ms micro-batch window fill it,
+  // the other eight threads are refused at once
+  set_admission(8, 0, 0);
+  set_micro_batch(300000, 1000);
+  before = stats();
+  std::mutex gate;
+  std::condition_variable opened;
+  bool open = false;
+  std::vector<int> results(16, 99);
+  std::vector<double> latency(16, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 16; ++t)
+    threads.emplace_back([&, t]
+    {
+      {
+        std::unique_lock<std::mutex> wait(gate);
+        opened.wait(wait, [&] { return open; });
+      }
+      auto sent = std::chrono::steady_clock::now();
+      results[t] = submit(100 + t, 5000 + t);
+      latency[t] = seconds_since(sent);
+    });
+  {
+    std::lock_guard<std::mutex> guard(gate);
+    open = true;
+  }
+  opened.notify_all();
+  for (std::thread &t : threads)
+    t.join();
+  int held = 0, shed = 0;
+  bool fast = true;
+  for (int t = 0; t < 16; ++t)
+  {
+    held += results[t] >= 0;
+    shed += results[t] == -2;
+    fast = fast && (results[t] != -2 || latency[t] < 0.1);
+  }
+  check(held == 8 && shed == 8, "queue bound: 8 admitted, 8 refused, got " + std::to_string(held) + " and " +
+                                    std::to_string(shed));
+  check(fast, "refused orders do not wait for the window");
+  after = stats();
+  check(after.peak_queued == 8 && after.queued == 0, "stats: peak 8, drained to 0");
+  check(after.shed_overloaded - before.shed_overloaded == shed && after.admitted - before.admitted == held,
+        "stats: admitted and shed overloaded");
+
+  // The daemon, in this process
+  std::thread daemon([&] { run_order_daemon(path.c_str()); });
+  bool reachable = false;
+  for (int i = 0; i < 500 && !reachable; ++i)
+    if (!(reachable = connect_order_daemon(path.c_str()) == 0))
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  check(reachable && daemon_reset() == 0, "daemon reachable");
+  const int n = 3000;
+  std::vector<int> ids(n), kinds(n);
+  std::vector<double> weights(n, 120.0), distances(n, 800.0);
+  std::vector<char> urgent(n, 0);
+  for (int i = 0; i < n; ++i)
+    ids[i] = 10000 + i;
+
+  // -2 while other orders hold the queue
+  set_admission(8, 0, 0);
+  set_micro_batch(300000, 1000);
+  threads.clear();
+  for (int t = 0; t < 8; ++t)
+    threads.emplace_back([t] { submit(200 + t, 20000 + t); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  check(stats().queued == 8, "eight orders held in the window");
+  check(daemon_add_orders(ids.data(), weights.data(), distances.data(), reinterpret_cast<const bool *>(urgent.data()),
+                          10, kinds.data()) >= 0,
+        "daemon answers while the queue is full");
+  bool overloaded = true;
+  for (int i = 0; i < 10; ++i)
+    overloaded = overloaded && kinds[i] == -2;
+  check(overloaded, "daemon: a full queue answers -2");
+  for (std::thread &t : threads)
+    t.join();
+
+  // A long run alone is admitted in groups under the same bound
+  set_micro_batch(0, 1);
+  int64_t count = daemon_order_count();
+  check(daemon_add_orders(ids.data(), weights.data(), distances.data(), reinterpret_cast<const bool *>(urgent.data()),
+                          n, kinds.data()) == count + n,
+        "daemon: a run of 3000 under a bound of 8 is admitted whole");
+  bool all = true;
+  for (int i = 0; i < n; ++i)
+    all = all && kinds[i] == 0;
+  check(all, "daemon: every order of the run classified");
+  check(stats().queued == 0 && stats().peak_queued == 8, "stats: the run never passed the bound");
+
+  // -3 for the refused suffix of a pipeline, keyed by process; a burst of
+  // 20 lifts the peak, so this comes last
+  set_admission(0, 100.0, 20.0);
+  check(daemon_add_orders(ids.data(), weights.data(), distances.data(), reinterpret_cast<const bool *>(urgent.data()),
+                          40, kinds.data()) >= 20,
+        "daemon pipeline answered");
+  bool prefix = true;
+  for (int i = 0; i < 40; ++i)
+    prefix = prefix && (i < 20 ? kinds[i] == 0 : kinds[i] == -3 || (i < 22 && kinds[i] == 0));
+  check(prefix, "daemon: the burst is admitted, the rest of the pipeline gets -3");
+
+  stop_order_daemon();
+  daemon.join();
+  set_admission(65536, 0, 0);
+  reset_system();
+  if (failures)
+    return 1;
+  printf("admission: ok\n");
+  return 0;
+}
@@ -0,0 +1,93 @@
+// Holiday files and dispatch dates with days past the end of their month:
+// 02-29 outside leap years, 04-31 and the like must be skipped by
+// load_holiday_calendar and refused by set_dispatch_date, not rolled into
+// the next month. Real dates, 02-29 of 2000 and 2024 included, still count.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/calendar.cpp -o calendar ./logistics.so
+// Usage: calendar [TMP_DIR]
+// Exits non-zero on failure.
+
+#include <cstdio>
+#include <string>
+
+#include <unistd.h>
+
+extern "C"
+{
+  int load_holiday_calendar(const char *path);
+  int set_dispatch_date(const char *region, int year, int month, int day);
+  void add_business_days_batch(const char *region, const int *start_days, const int *business_days, int *out_days,
+                               int n);
+}
+
+// Day number since 1970-01-01, as the library counts them
+static int day_number(int y, unsigned m, unsigned d)
+{
+  y -= m <= 2;
+  const int era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<int>(doe) - 719468;
+}
+
+int main(int argc, char **argv)
+{
+  std::string path = std::string(argc > 1 ? argv[1] : "/tmp") + "/calendar-" + std::to_string(::getpid()) + ".txt";
+  int failures = 0;
+  auto check = [&](bool ok, const char *what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what);
+      ++failures;
+    }
+  };
+
+  FILE *f = fopen(path.c_str(), "w");
+  if (!f)
+  {
+    fprintf(stderr, "FAIL cannot write %s\n", path.c_str());
+    return 1;
+  }
+  fputs("# four real dates, five that do not exist\n"
+        "EU 2024-02-29\n"
+        "EU 2000-02-29\n"
+        "EU 2023-01-31\n"
+        "EU 2023-11-30\n"
+        "EU 2023-02-29\n"
+        "EU 2023-04-31\n"
+        "EU 2023-06-31 # would be Saturday 07-01\n"
+        "EU 2099-02-29\n"
+        "EU 2023-02-30\n",
+        f);
+  fclose(f);
+  check(load_holiday_calendar(path.c_str()) == 4, "only real dates are loaded");
+
+  // 2023-02-29 would have become Wednesday 2023-03-01, 04-31 Monday 05-01
+  int starts[] = {day_number(2023, 2, 28), day_number(2023, 4, 28), day_number(2024, 2, 28), day_number(2023, 11, 29)};
+  int steps[] = {1, 1, 1, 1};
+  int want[] = {day_number(2023, 3, 1), day_number(2023, 5, 1), day_number(2024, 3, 1), day_number(2023, 12, 1)};
+  int got[4];
+  add_business_days_batch("EU", starts, steps, got, 4);
+  check(got[0] == want[0], "2023-03-01 is a business day");
+  check(got[1] == want[1], "2023-05-01 is a business day");
+  check(got[2] == want[2], "2024-02-29 is a holiday");
+  check(got[3] == want[3], "2023-11-30 is a holiday");
+
+  check(set_dispatch_date("", 2024, 2, 29) == 0, "dispatch on 2024-02-29");
+  check(set_dispatch_date("", 2000, 2, 29) == 0, "dispatch on 2000-02-29");
+  check(set_dispatch_date("EU", 2023, 12, 31) == 0, "dispatch on 2023-12-31");
+  check(set_dispatch_date("", 2023, 2, 29) == -1, "no dispatch on 2023-02-29");
+  check(set_dispatch_date("", 2099, 2, 29) == -1, "no dispatch on 2099-02-29");
+  check(set_dispatch_date("", 2023, 9, 31) == -1, "no dispatch on 2023-09-31");
+  check(set_dispatch_date("", 2023, 13, 1) == -1, "no dispatch in month 13");
+  check(set_dispatch_date("", 2023, 1, 0) == -1, "no dispatch on day 0");
+  check(set_dispatch_date("", 2023, -1, 10) == -1, "no dispatch in month -1");
+
+  ::unlink(path.c_str());
+  if (failures)
+    return 1;
+  printf("calendar: ok\n");
+  return 0;
+}
@@ -0,0 +1,225 @@
+"""Round-trips export_orders_arrow through an Arrow reader.
+
+Writes an empty store, one batch and several batches in both the file and
+the stream format, reads each back and compares every column with what was
+ingested. Uses pyarrow when it is installed and always runs the minimal IPC
+reader below, which checks the framing, schema, record batch metadata and
+file footer on its own.
+
+Usage: python3 tests/check_arrow.py [path/to/logistics.so]
+Exits non-zero on failure.
+"""
+
+import ctypes
+import os
+import struct
+import sys
+import tempfile
+
+SEGMENT_ROWS = 65536
+COLUMNS = [("id", 2, 32, True), ("weight_g", 2, 32, True), ("distance_dam", 2, 32, True),
+           ("urgent", 6, 0, False), ("kind", 2, 8, False), ("eta_days", 2, 8, True), ("flags", 2, 32, False)]
+FORMATS = {"<i": "i", "<I": "I", "<b": "b", "<B": "B"}
+
+
+class Table:
+    """Read-only view of one flatbuffer table."""
+
+    def __init__(self, buf, pos):
+        self.buf, self.pos = buf, pos
+        self.vtable = pos - struct.unpack_from("<i", buf, pos)[0]
+        self.vsize = struct.unpack_from("<H", buf, self.vtable)[0]
+
+    def offset(self, i):
+        at = 4 + 2 * i
+        return struct.unpack_from("<H", self.buf, self.vtable + at)[0] if at < self.vsize else 0
+
+    def scalar(self, i, fmt, default=0):
+        o = self.offset(i)
+        return struct.unpack_from(fmt, self.buf, self.pos + o)[0] if o else default
+
+    def target(self, i):
+        o = self.offset(i)
+        if not o:
+            return None
+        at = self.pos + o
+        return at + struct.unpack_from("<I", self.buf, at)[0]
+
+    def table(self, i):
+        at = self.target(i)
+        return Table(self.buf, at) if at is not None else None
+
+    def string(self, i):
+        at = self.target(i)
+        n = struct.unpack_from("<I", self.buf, at)[0]
+        return self.buf[at + 4:at + 4 + n].decode()
+
+    def tables(self, i):
+        at = self.target(i)
+        n = struct.unpack_from("<I", self.buf, at)[0]
+        return [Table(self.buf, at + 4 + 4 * k + struct.unpack_from("<I", self.buf, at + 4 + 4 * k)[0])
+                for k in range(n)]
+
+    def structs(self, i, fmt):
+        at = self.target(i)
+        n = struct.unpack_from("<I", self.buf, at)[0]
+        size = struct.calcsize(fmt)
+        return [struct.unpack_from(fmt, self.buf, at + 4 + size * k) for k in range(n)]
+
+
+def root(buf):
+    return Table(buf, struct.unpack_from("<I", buf, 0)[0])
+
+
+def check_schema(schema):
+    fields = schema.tables(1)
+    assert len(fields) == len(COLUMNS), "schema has %d fields" % len(fields)
+    for field, (name, type_id, bits, signed) in zip(fields, COLUMNS):
+        assert field.string(0) == name, field.string(0)
+        assert field.scalar(2, "<B") == type_id, name
+        if type_id == 2:
+            t = field.table(3)
+            assert (t.scalar(0, "<i"), bool(t.scalar(1, "<B"))) == (bits, signed), name
+
+
+def read_message(data, pos):
+    """Returns (message table or None at end of stream, metadata length, next position)."""
+    marker, length = struct.unpack_from("<iI", data, pos)
+    assert marker == -1, "missing continuation marker at %d" % pos
+    assert length % 8 == 0, "metadata length %d is not 8-aligned" % length
+    if length == 0:
+        return None, 8, pos + 8
+    message = root(data[pos + 8:pos + 8 + length])
+    assert message.scalar(0, "<h") == 4, "metadata version is not V5"
+    return message, 8 + length, pos + 8 + length
+
+
+def decode_column(body, buffers, c, rows, column):
+    _, validity_length = buffers[2 * c]
+    offset, length = buffers[2 * c + 1]
+    assert validity_length == 0, "unexpected validity bitmap"
+    assert offset % 8 == 0, "buffer offset %d is not 8-aligned" % offset
+    raw = body[offset:offset + length]
+    name, type_id, bits, signed = column
+    if type_id == 6:
+        assert length == (rows + 7) // 8, name
+        return [(raw[i >> 3] >> (i & 7)) & 1 for i in range(rows)]
+    fmt = "<" + {32: "i", 8: "b"}[bits] if signed else "<" + {32: "I", 8: "B"}[bits]
+    assert length == rows * bits // 8, name
+    return list(struct.unpack_from("<%d%s" % (rows, FORMATS[fmt]), raw))
+
+
+def read_stream(data, start):
+    """Parses schema and batches from `start`; returns (columns, batch offsets, end)."""
+    message, _, pos = read_message(data, start)
+    assert message.scalar(1, "<B") == 1, "first message is not a schema"
+    check_schema(message.table(2))
+    columns = {c[0]: [] for c in COLUMNS}
+    blocks = []
+    while True:
+        at = pos
+        message, metadata_length, pos = read_message(data, pos)
+        if message is None:
+            return columns, blocks, pos
+        assert message.scalar(1, "<B") == 3, "expected a record batch"
+        body_length = message.scalar(3, "<q")
+        batch = message.table(2)
+        rows = batch.scalar(0, "<q")
+        nodes = batch.structs(1, "<qq")
+        buffers = batch.structs(2, "<qq")
+        assert nodes == [(rows, 0)] * len(COLUMNS), "bad field nodes"
+        assert len(buffers) == 2 * len(COLUMNS), "bad buffer count"
+        body = data[pos:pos + body_length]
+        assert len(body) == body_length, "truncated body"
+        for c, column in enumerate(COLUMNS):
+            columns[column[0]] += decode_column(body, buffers, c, rows, column)
+        blocks.append((at, metadata_length, body_length))
+        pos += body_length
+
+
+def read_minimal(path, file_format):
+    data = open(path, "rb").read()
+    if not file_format:
+        columns, blocks, end = read_stream(data, 0)
+        assert end == len(data), "%d bytes after end of stream" % (len(data) - end)
+        return columns, len(blocks)
+    assert data[:8] == b"ARROW1\0\0", "bad leading magic"
+    assert data[-6:] == b"ARROW1", "bad trailing magic"
+    columns, blocks, end = read_stream(data, 8)
+    footer_length = struct.unpack_from("<i", data, len(data) - 10)[0]
+    assert end + footer_length + 10 == len(data), "footer does not follow the stream"
+    footer = root(data[end:end + footer_length])
+    assert footer.scalar(0, "<h") == 4, "footer version is not V5"
+    check_schema(footer.table(1))
+    recorded = [(o, m, b) for o, m, _, b in footer.structs(3, "<qiiq")]
+    assert recorded == blocks, "footer blocks %r != %r" % (recorded[:3], blocks[:3])
+    return columns, len(blocks)
+
+
+def read_pyarrow(path, file_format):
+    import pyarrow.ipc as ipc
+    with open(path, "rb") as f:
+        reader = ipc.open_file(f) if file_format else ipc.open_stream(f)
+        table = reader.read_all()
+    return {name: [int(v) for v in table.column(name).to_pylist()] for name, *_ in COLUMNS}
+
+
+def main():
+    lib = ctypes.CDLL(sys.argv[1] if len(sys.argv) > 1 else "./logistics.so")
+    lib.add_orders_batch.argtypes = [ctypes.c_void_p] * 4 + [ctypes.c_int]
+    lib.export_orders_arrow.argtypes = [ctypes.c_char_p, ctypes.c_int]
+    lib.export_orders_arrow.restype = ctypes.c_int64
+    lib.get_order_kind.argtypes = [ctypes.c_int]
+    try:
+        import pyarrow  # noqa: F401
+        readers = [("minimal", read_minimal), ("pyarrow", read_pyarrow)]
+    except ImportError:
+        readers = [("minimal", read_minimal)]
+
+    failures = 0
+    tmp = tempfile.mkdtemp()
+    for rows in (0, 1000, 2 * SEGMENT_ROWS + 123):
+        lib.reset_system()
+        ids = [i * 7 - 5000 for i in range(rows)]
+        weights = [(i * 37) % 30000 / 2.0 + 0.5 for i in range(rows)]
+        distances = [(i * 53) % 40000 + 0.25 for i in range(rows)]
+        urgent = [i % 3 == 0 for i in range(rows)]
+        if rows:
+            lib.add_orders_batch((ctypes.c_int * rows)(*ids), (ctypes.c_double * rows)(*weights),
+                                 (ctypes.c_double * rows)(*distances), (ctypes.c_bool * rows)(*urgent), rows)
+        expected = {"id": ids, "weight_g": [int(w * 1000) for w in weights],
+                    "distance_dam": [int(d * 100) for d in distances], "urgent": [int(u) for u in urgent],
+                    "kind": [lib.get_order_kind(i) for i in range(rows)]}
+        batches = (rows + SEGMENT_ROWS - 1) // SEGMENT_ROWS
+        for file_format in (1, 0):
+            path = os.path.join(tmp, "orders.arrow" if file_format else "orders.arrows")
+            written = lib.export_orders_arrow(path.encode(), file_format)
+            label = "%d rows, %s" % (rows, "file" if file_format else "stream")
+            if written != rows:
+                print("FAIL %s: export returned %d" % (label, written))
+                failures += 1
+                continue
+            for reader_name, reader in readers:
+                try:
+                    result = reader(path, file_format)
+                    if reader is read_minimal:
+                        columns, count = result
+                        assert count == batches, "%d batches, expected %d" % (count, batches)
+                    else:
+                        columns = result
+                    for name, values in expected.items():
+                        assert columns[name] == values, "column %s differs" % name
+                    for name in ("eta_days", "flags"):
+                        assert len(columns[name]) == rows, "column %s has %d rows" % (name, len(columns[name]))
+                    print("ok   %s (%s)" % (label, reader_name))
+                except AssertionError as e:
+                    print("FAIL %s (%s): %s" % (label, reader_name, e))
+                    failures += 1
+            os.unlink(path)
+    os.rmdir(tmp)
+    lib.reset_system()
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,123 @@
+// Encoded order files with a damaged column header: an RLE run count of zero,
+// one past the row count, or one whose payload would run to gigabytes must be
+// rejected by load_checkpoint and sort_order_file, not allocated or thrown
+// out of the C API. The intact file still loads every order.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/codec_corrupt.cpp -o codec_corrupt ./logistics.so
+// Usage: codec_corrupt [TMP_DIR]
+// Exits non-zero on failure.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+extern "C"
+{
+  void reset_system();
+  void set_compression(int enabled);
+  void add_order(int id, double weight, double distance, bool urgent);
+  int get_order_count();
+  int64_t export_orders(const char *path);
+  int64_t load_checkpoint(const char *path);
+  int64_t sort_order_file(const char *in_path, const char *out_path, const char *tmp_dir, int64_t memory_mb,
+                          int threads);
+}
+
+// The on-disk column header that follows the 64-byte file header
+struct ColumnHeader
+{
+  uint8_t codec;
+  uint8_t width;
+  uint16_t reserved;
+  uint32_t count;
+  int32_t base;
+  int32_t step;
+  uint32_t length;
+  uint32_t pad;
+};
+static_assert(sizeof(ColumnHeader) == 24, "column header is 24 bytes");
+
+constexpr size_t FILE_HEADER = 64;
+constexpr uint8_t RLE = 3;
+constexpr int ORDERS = 5000;
+
+static std::string read_file(const std::string &path)
+{
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string &path, const std::string &data)
+{
+  std::ofstream(path, std::ios::binary | std::ios::trunc).write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+int main(int argc, char **argv)
+{
+  std::string dir = argc > 1 ? argv[1] : "/tmp";
+  std::string base = dir + "/codec_corrupt-" + std::to_string(::getpid());
+  std::string good = base + ".orders", bad = base + "-bad.orders", sorted = base + "-sorted.orders";
+  int failures = 0;
+  auto check = [&](bool ok, const char *what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what);
+      ++failures;
+    }
+  };
+
+  reset_system();
+  set_compression(1);
+  for (int i = 0; i < ORDERS; ++i)
+    add_order(i + 1, 5.0 + i % 900, 10.0 + i * 3 % 2400, i % 7 == 0);
+  check(export_orders(good.c_str()) == ORDERS, "export_orders");
+  check(load_checkpoint(good.c_str()) >= 0 && get_order_count() == ORDERS, "intact file loads");
+  check(sort_order_file(good.c_str(), sorted.c_str(), dir.c_str(), 16, 1) == ORDERS, "intact file sorts");
+
+  std::string file = read_file(good);
+  check(file.size() > FILE_HEADER + sizeof(ColumnHeader), "file holds a column");
+
+  // Run counts a damaged header may carry, each with a length that matches it
+  const uint32_t counts[] = {0, ORDERS + 1, 0x1FFFFFFF};
+  for (uint32_t count : counts)
+  {
+    if (file.size() <= FILE_HEADER + sizeof(ColumnHeader))
+      break;
+    std::string damaged = file;
+    ColumnHeader h;
+    memcpy(&h, &damaged[FILE_HEADER], sizeof h);
+    h.codec = RLE;
+    h.width = 0;
+    h.count = count;
+    h.length = 8 * count;
+    memcpy(&damaged[FILE_HEADER], &h, sizeof h);
+    write_file(bad, damaged);
+
+    std::string what = "RLE count " + std::to_string(count);
+    check(load_checkpoint(bad.c_str()) == -1, (what + " rejected by load_checkpoint").c_str());
+    check(get_order_count() == 0, (what + " leaves the book empty").c_str());
+    check(sort_order_file(bad.c_str(), sorted.c_str(), dir.c_str(), 16, 1) == -1,
+          (what + " rejected by sort_order_file").c_str());
+  }
+
+  // A file cut short inside the first column
+  write_file(bad, file.substr(0, FILE_HEADER + sizeof(ColumnHeader) + 4));
+  check(load_checkpoint(bad.c_str()) == -1, "truncated file rejected");
+
+  check(load_checkpoint(good.c_str()) >= 0 && get_order_count() == ORDERS, "intact file loads after damage");
+  for (const std::string &path : {good, bad, sorted})
+    ::unlink(path.c_str());
+  set_compression(0);
+  reset_system();
+  if (failures)
+    return 1;
+  printf("codec corrupt: ok\n");
+  return 0;
+}
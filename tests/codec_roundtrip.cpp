@@ -0,0 +1,266 @@
+// Column codecs must round-trip every book they encode: order files written
+// with set_compression(1) load back through load_checkpoint to the same
+// decisions as plain ones, sort_order_file gives the same stable ETA and
+// distance order from either, and an encoded journal replays without a
+// mismatch and recovers the same book. Books cover sequential ids with
+// clustered values, ids over the whole int range with negative distances, a
+// single order and no orders. Sequential books must also shrink.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/codec_roundtrip.cpp -o codec_roundtrip ./logistics.so
+// Usage: codec_roundtrip [TMP_DIR]
+// Exits non-zero on failure.
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C"
+{
+  void reset_system();
+  void set_compression(int enabled);
+  void add_orders_batch(const int *ids, const double *weights, const double *distances, const bool *urgent, int n);
+  int get_order_count();
+  const char *get_order_eta(int index);
+  const void *get_decision_frames(int64_t first, int64_t count, int64_t *size);
+  int64_t export_orders(const char *path);
+  int64_t load_checkpoint(const char *path);
+  int64_t sort_order_file(const char *in_path, const char *out_path, const char *tmp_dir, int64_t memory_mb,
+                          int threads);
+  int open_journal(const char *path, int backend);
+  int close_journal();
+  int64_t recover_journal(const char *path, int64_t offset);
+}
+
+struct ReplayStats
+{
+  int64_t orders;
+  int64_t frames;
+  int64_t mismatches;
+  int64_t first_mismatch_id;
+  int64_t truncated;
+  double seconds;
+  double mean_us[4];
+  double p50_us[4];
+  double p99_us[4];
+  double max_us[4];
+};
+
+extern "C" int64_t replay_journal(const char *path, int64_t offset, double orders_per_sec, int scalar,
+                                  ReplayStats *out);
+
+struct WireHeader
+{
+  char magic[4];
+  uint16_t version;
+  uint16_t type;
+  uint32_t rows;
+  uint32_t flags;
+  uint64_t body_length;
+};
+
+struct Book
+{
+  const char *name;
+  std::vector<int> ids;
+  std::vector<double> weights;
+  std::vector<double> distances;
+  std::vector<char> urgent;
+};
+
+// Sequential ids, weights clustered around 40 kg and distances around 900 km
+// on the stored grid, urgent runs
+static Book sequential(int n)
+{
+  Book b{"sequential", {}, {}, {}, {}};
+  for (int i = 0; i < n; ++i)
+  {
+    uint32_t h = static_cast<uint32_t>(i) * 2654435761u;
+    int spread = static_cast<int>((h >> 4) % 64 + (h >> 10) % 64 + (h >> 16) % 64) - 94;
+    b.ids.push_back(100000 + i);
+    b.weights.push_back(40.0 + spread * 0.125);
+    b.distances.push_back(900.0 + spread * 7.5 + (i % 50 == 0 ? 2000.0 : 0.0));
+    b.urgent.push_back(i / 37 % 3 == 0);
+  }
+  return b;
+}
+
+// Ids over the whole int range, one weight, distances down to -600 km
+static Book scattered(int n)
+{
+  Book b{"scattered", {INT_MIN, INT_MAX, 0, -1}, {7.5, 7.5, 7.5, 7.5}, {-600.0, 3500.0, 0.0, 501.0}, {0, 1, 1, 1}};
+  for (int i = 4; i < n; ++i)
+  {
+    uint32_t h = static_cast<uint32_t>(i) * 2246822519u;
+    b.ids.push_back(static_cast<int>(h ^ 0x9E3779B9u));
+    b.weights.push_back(7.5);
+    b.distances.push_back(static_cast<double>(h % 4100) - 600.0);
+    b.urgent.push_back(h >> 31);
+  }
+  return b;
+}
+
+static void ingest(const Book &b, size_t first, size_t n)
+{
+  add_orders_batch(b.ids.data() + first, b.weights.data() + first, b.distances.data() + first,
+                   reinterpret_cast<const bool *>(b.urgent.data()) + first, static_cast<int>(n));
+}
+
+static std::string decisions(int64_t first, int64_t count)
+{
+  int64_t size = 0;
+  const void *data = get_decision_frames(first, count, &size);
+  return std::string(static_cast<const char *>(data), static_cast<size_t>(size));
+}
+
+// Decisions of the whole book as plain frames, whatever the codec setting
+static std::string plain_decisions(bool encoded)
+{
+  set_compression(0);
+  std::string out = decisions(0, get_order_count());
+  set_compression(encoded);
+  return out;
+}
+
+// (ETA days, distance, id) per row of plain decision frames, in file order
+struct Row
+{
+  int eta;
+  int32_t distance_dam;
+  int32_t id;
+  bool operator==(const Row &o) const { return eta == o.eta && distance_dam == o.distance_dam && id == o.id; }
+};
+
+static std::vector<Row> rows_of(const std::string &data)
+{
+  std::vector<Row> out;
+  size_t index = 0;
+  for (size_t at = 0; at + sizeof(WireHeader) <= data.size();)
+  {
+    WireHeader h;
+    memcpy(&h, &data[at], sizeof h);
+    size_t column = (4 * size_t{h.rows} + 7) / 8 * 8;
+    const char *body = &data[at + sizeof h];
+    for (size_t i = 0; i < h.rows; ++i, ++index)
+    {
+      Row r{0, 0, 0};
+      memcpy(&r.id, body + 4 * i, 4);
+      memcpy(&r.distance_dam, body + 2 * column + 4 * i, 4);
+      const char *eta = get_order_eta(static_cast<int>(index));
+      if (!eta || sscanf(eta, "%*[^:]: %d", &r.eta) != 1)
+        r.eta = INT_MIN;
+      out.push_back(r);
+    }
+    at += sizeof h + h.body_length;
+  }
+  return out;
+}
+
+static int64_t file_size(const std::string &path)
+{
+  struct stat st;
+  return ::stat(path.c_str(), &st) == 0 ? static_cast<int64_t>(st.st_size) : -1;
+}
+
+int main(int argc, char **argv)
+{
+  std::string dir = argc > 1 ? argv[1] : "/tmp";
+  std::string base = dir + "/codec_roundtrip-" + std::to_string(::getpid());
+  std::string plain = base + ".plain", encoded = base + ".encoded", sorted = base + ".sorted",
+              sorted_plain = base + ".sorted-plain", journal = base + ".journal", plain_journal = base + ".journal0";
+  int failures = 0;
+  auto check = [&](bool ok, const std::string &what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what.c_str());
+      ++failures;
+    }
+  };
+
+  Book one = sequential(1), none = sequential(0);
+  one.name = "one order";
+  none.name = "no orders";
+  for (const Book &b : {sequential(200000), scattered(50000), one, none})
+  {
+    std::string name = b.name;
+    int64_t n = static_cast<int64_t>(b.ids.size());
+    reset_system();
+    set_compression(0);
+    ingest(b, 0, b.ids.size());
+    std::string want = plain_decisions(false);
+    std::vector<Row> want_rows = rows_of(want);
+    check(export_orders(plain.c_str()) == n, name + ": plain export");
+    set_compression(1);
+    check(export_orders(encoded.c_str()) == n, name + ": encoded export");
+
+    // Both files load back to the same decisions
+    check(load_checkpoint(encoded.c_str()) >= 0 && get_order_count() == n, name + ": encoded file loads");
+    check(plain_decisions(true) == want, name + ": encoded file keeps every decision");
+    check(load_checkpoint(plain.c_str()) >= 0 && plain_decisions(true) == want,
+          name + ": plain file still loads with the codecs on");
+
+    // Encoded decision frames carry the flag and shrink sequential books
+    std::string packed = decisions(0, n);
+    WireHeader h{};
+    if (packed.size() >= sizeof h)
+      memcpy(&h, packed.data(), sizeof h);
+    check(n == 0 || h.flags == 1, name + ": decision frames encoded");
+
+    // Sorting either file gives the input's stable ETA and distance order
+    std::stable_sort(want_rows.begin(), want_rows.end(),
+                     [](const Row &a, const Row &b)
+                     { return a.eta != b.eta ? a.eta < b.eta : a.distance_dam < b.distance_dam; });
+    check(sort_order_file(encoded.c_str(), sorted.c_str(), dir.c_str(), 4, 2) == n, name + ": encoded file sorts");
+    set_compression(0);
+    check(sort_order_file(plain.c_str(), sorted_plain.c_str(), dir.c_str(), 4, 2) == n, name + ": plain file sorts");
+    set_compression(1);
+    check(load_checkpoint(sorted.c_str()) >= 0 && rows_of(plain_decisions(true)) == want_rows,
+          name + ": sorted encoded file in ETA and distance order");
+    check(load_checkpoint(sorted_plain.c_str()) >= 0 && rows_of(plain_decisions(true)) == want_rows,
+          name + ": sorted plain file in the same order");
+
+    if (name == "sequential")
+    {
+      check(file_size(encoded) * 10 < file_size(plain) * 7, name + ": encoded file under 70% of plain");
+      check(packed.size() * 10 < want.size() * 7, name + ": encoded decisions under 70% of plain");
+      check(file_size(sorted) * 10 < file_size(sorted_plain) * 7, name + ": sorted file encoded");
+    }
+
+    // A journal with the codecs on replays and recovers the same decisions
+    for (int codecs : {0, 1})
+    {
+      const std::string &path = codecs ? journal : plain_journal;
+      std::string what = name + (codecs ? ": encoded journal" : ": plain journal");
+      ::unlink(path.c_str());
+      reset_system();
+      set_compression(codecs);
+      check(open_journal(path.c_str(), 2) >= 0, what + " opens");
+      for (size_t at = 0; at < b.ids.size(); at += 30000)
+        ingest(b, at, std::min<size_t>(30000, b.ids.size() - at));
+      check(close_journal() == 0, what + " closes");
+      ReplayStats stats{};
+      check(replay_journal(path.c_str(), 0, 0, 0, &stats) == n && stats.mismatches == 0 && stats.truncated == 0,
+            what + " replays without a mismatch");
+      reset_system();
+      check(recover_journal(path.c_str(), 0) == n && plain_decisions(codecs) == want, what + " recovers the book");
+    }
+    if (name == "sequential")
+      check(file_size(journal) * 10 < file_size(plain_journal) * 7, name + ": encoded journal under 70% of plain");
+  }
+
+  for (const std::string &path : {plain, encoded, sorted, sorted_plain, journal, plain_journal})
+    ::unlink(path.c_str());
+  set_compression(0);
+  reset_system();
+  if (failures)
+    return 1;
+  printf("codec roundtrip: ok\n");
+  return 0;
+}
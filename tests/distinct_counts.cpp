@@ -0,0 +1,226 @@
+// HyperLogLog distinct counts must stay within their error (2^12 registers,
+// about 1.6%; 5% is allowed) against exact counts of customers and routes,
+// per kind and over all kinds, for all time and for the last days. Small
+// counts are near exact, unknown (0) ids and null id columns add nothing,
+// and a day's sketches are recycled a week later. The wall clock the library
+// reads is faked here.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/distinct_counts.cpp -o distinct_counts ./logistics.so -pthread
+// Exits non-zero on failure.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+extern "C"
+{
+  void reset_system();
+  void add_order_ex(int id, double weight, double distance, bool urgent, uint64_t customer_id,
+                    uint64_t destination_id);
+  void add_orders_batch_ex(const int *ids, const double *weights, const double *distances, const bool *urgent,
+                           const uint64_t *customer_ids, const uint64_t *destination_ids, int n);
+  int get_order_count();
+  int get_order_kind(int index);
+  int list_orders_where(int all_of, int any_of, int none_of, int *out_ids, int max_ids);
+  double get_distinct_count(int what, int kind, int days);
+}
+
+// CLOCK_REALTIME as the library sees it; every other clock is the real one
+static int64_t fake_ms = 0;
+
+extern "C" int clock_gettime(clockid_t clock, timespec *ts)
+{
+  if (clock != CLOCK_REALTIME)
+    return static_cast<int>(::syscall(SYS_clock_gettime, clock, ts));
+  ts->tv_sec = static_cast<time_t>(fake_ms / 1000);
+  ts->tv_nsec = static_cast<long>(fake_ms % 1000 * 1000000);
+  return 0;
+}
+
+constexpr int64_t DAY_MS = 24 * 60 * 60 * 1000;
+constexpr int64_t BASE_DAY = 1700000000000 / DAY_MS;
+constexpr int CUSTOMERS = 0;
+
+static void set_day(int64_t day) { fake_ms = (BASE_DAY + day) * DAY_MS + 12 * 3600 * 1000; }
+
+// Every kind occurs; orders of the same `pool` share customers and routes
+static double weight_of(int id) { return id % 5 == 0 ? 1500.0 : (id % 7 == 0 ? 10.0 : 120.0); }
+static double distance_of(int id) { return id % 3 == 0 ? 2500.0 : 900.0; }
+static bool urgent_of(int id) { return id % 2 == 0; }
+
+// Customer and destination ids of order `id`: drawn with repeats from pools
+// of `customers` and `routes` ids, spread over 64 bits; every ninth customer
+// is unknown
+struct Pool
+{
+  uint64_t salt;
+  uint32_t customers;
+  uint32_t routes;
+
+  uint64_t customer(int id) const
+  {
+    uint32_t pick = static_cast<uint32_t>(id) * 2654435761u % customers;
+    return id % 9 == 0 ? 0 : (salt ^ pick) * 0x9E3779B97F4A7C15ull | 1;
+  }
+  uint64_t route(int id) const
+  {
+    uint32_t pick = (static_cast<uint32_t>(id) ^ 0x5bd1e995u) * 2246822519u % routes;
+    return (salt + pick) * 0xC2B2AE3D27D4EB4Full | 1;
+  }
+};
+
+// Exact distinct ids per what and kind (3 = all kinds)
+struct Exact
+{
+  std::unordered_set<uint64_t> ids[2][4];
+
+  void merge(const Exact &other)
+  {
+    for (int what = 0; what < 2; ++what)
+      for (int k = 0; k < 4; ++k)
+        ids[what][k].insert(other.ids[what][k].begin(), other.ids[what][k].end());
+  }
+};
+
+int main()
+{
+  int failures = 0;
+  auto check = [&](bool ok, const std::string &what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what.c_str());
+      ++failures;
+    }
+  };
+
+  int next_id = 1;
+  int counted = 0; // book orders already in an Exact
+
+  // Adds n orders from `pool` in batches; null columns when asked
+  auto add = [&](const Pool &pool, int n, bool customers = true, bool routes = true)
+  {
+    std::vector<int> ids(n);
+    std::vector<double> weights(n), distances(n);
+    std::vector<char> urgent(n);
+    std::vector<uint64_t> customer_ids(n), destination_ids(n);
+    for (int i = 0; i < n; ++i)
+    {
+      ids[i] = next_id++;
+      weights[i] = weight_of(ids[i]);
+      distances[i] = distance_of(ids[i]);
+      urgent[i] = urgent_of(ids[i]);
+      customer_ids[i] = pool.customer(ids[i]);
+      destination_ids[i] = pool.route(ids[i]);
+    }
+    for (int at = 0; at < n; at += 4096)
+      add_orders_batch_ex(&ids[at], &weights[at], &distances[at], reinterpret_cast<const bool *>(&urgent[at]),
+                          customers ? &customer_ids[at] : nullptr, routes ? &destination_ids[at] : nullptr,
+                          std::min(4096, n - at));
+  };
+
+  // Exact counts of the orders added since the last call, read back from
+  // the book in arrival order
+  auto exact = [&](const Pool &pool, bool customers = true, bool routes = true)
+  {
+    Exact out;
+    int n = get_order_count();
+    std::vector<int> ids(static_cast<size_t>(n));
+    list_orders_where(0, 0, 0, ids.data(), n);
+    for (int i = counted; i < n; ++i)
+    {
+      int k = get_order_kind(i);
+      uint64_t v[2] = {customers ? pool.customer(ids[i]) : 0, routes ? pool.route(ids[i]) : 0};
+      for (int what = 0; what < 2; ++what)
+        if (v[what])
+        {
+          out.ids[what][k].insert(v[what]);
+          out.ids[what][3].insert(v[what]);
+        }
+    }
+    counted = n;
+    return out;
+  };
+
+  auto same = [&](const Exact &want, int days, const std::string &what)
+  {
+    for (int w = 0; w < 2; ++w)
+      for (int kind = -1; kind < 3; ++kind)
+      {
+        double n = static_cast<double>(want.ids[w][kind < 0 ? 3 : kind].size());
+        double got = get_distinct_count(w, kind, days);
+        std::string name = what + (w ? ": routes" : ": customers") + " of kind " + std::to_string(kind) + " over " +
+                           std::to_string(days) + " days";
+        name += " = " + std::to_string(got) + ", exact " + std::to_string(n);
+        check(std::fabs(got - n) <= 0.05 * n + 0.5, name);
+      }
+  };
+
+  reset_system();
+  set_day(0);
+  check(get_distinct_count(CUSTOMERS, -1, 0) == 0.0, "no orders: 0");
+  check(get_distinct_count(2, -1, 0) == 0.0 && get_distinct_count(0, 3, 0) == 0.0 &&
+            get_distinct_count(0, -1, -1) == 0.0,
+        "bad arguments: 0");
+
+  // A handful of ids one order at a time, with unknown customers among them
+  Pool few{1, 7, 3};
+  for (int i = 0; i < 40; ++i, ++next_id)
+    add_order_ex(next_id, weight_of(next_id), distance_of(next_id), urgent_of(next_id), few.customer(next_id),
+                 few.route(next_id));
+  Exact small = exact(few);
+  same(small, 0, "a handful");
+
+  // 300k orders over 100k customers and 20k routes
+  Pool day0{2, 100000, 20000};
+  add(day0, 300000);
+  Exact all = small, first = exact(day0);
+  all.merge(first);
+  same(all, 0, "day 0");
+  same(all, 1, "day 0");
+
+  // Two days later, other customers and routes; then routes alone, without
+  // a customer column
+  set_day(2);
+  Pool day2{3, 20000, 5000}, routes_only{4, 1000, 3000};
+  add(day2, 60000);
+  Exact second = exact(day2);
+  add(routes_only, 20000, false, true);
+  second.merge(exact(routes_only, false, true));
+  all.merge(second);
+  same(second, 1, "day 2");
+  same(second, 2, "day 2");
+  same(all, 3, "days 0-2");
+  same(all, 0, "all time on day 2");
+
+  // A week after day 2 its slot is recycled for day 9; a late order for
+  // day 2 after that counts for all time only
+  set_day(9);
+  Pool day9{5, 300, 40};
+  add(day9, 3000);
+  Exact ninth = exact(day9);
+  all.merge(ninth);
+  same(ninth, 7, "days 3-9");
+  same(ninth, 30, "more than a week");
+  set_day(2);
+  Pool late{6, 5000, 1000};
+  add(late, 10000);
+  all.merge(exact(late));
+  set_day(9);
+  same(ninth, 7, "days 3-9 after late orders");
+  same(all, 0, "all time after late orders");
+
+  reset_system();
+  check(get_distinct_count(CUSTOMERS, -1, 0) == 0.0, "reset_system clears the counts");
+  if (failures)
+    return 1;
+  printf("distinct counts: ok\n");
+  return 0;
+}
@@ -0,0 +1,275 @@
+// The HTTP server must answer POST /process_order like Factory.py: the same
+// JSON keys in sorted order, info and ETA texts as the order log has them,
+// a string "true" for urgent, and weight and distance printed the way
+// Python's repr(float) prints them. Requests may be pipelined, arrive a byte
+// at a time and mix with errors, and answers come back in request order;
+// malformed, chunked, oversized and unterminated requests get their error
+// status and close the connection, as do HTTP/1.0 and Connection: close.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/http_server.cpp -o http_server ./logistics.so -pthread
+// Exits non-zero on failure.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern "C"
+{
+  void reset_system();
+  void add_order(int id, double weight, double distance, bool urgent);
+  const char *get_orders_log();
+  int run_order_server(int port, int threads);
+  void stop_order_server();
+}
+
+struct Response
+{
+  int status = 0;
+  bool close = false;
+  std::string body;
+};
+
+static int connect_to(int port)
+{
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) != 0)
+  {
+    ::close(fd);
+    return -1;
+  }
+  int one = 1;
+  timeval timeout{5, 0};
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+  return fd;
+}
+
+static void send_all(int fd, const std::string &data)
+{
+  for (size_t at = 0; at < data.size();)
+  {
+    ssize_t n = ::send(fd, data.data() + at, data.size() - at, MSG_NOSIGNAL);
+    if (n <= 0)
+      return;
+    at += static_cast<size_t>(n);
+  }
+}
+
+// Reads `count` responses, fewer if the server closes or goes quiet; sets
+// `closed` if the connection then reads as closed
+static std::vector<Response> receive(int fd, size_t count, bool *closed = nullptr)
+{
+  std::vector<Response> out;
+  std::string in;
+  char buffer[16384];
+  bool eof = false;
+  while (out.size() < count && !eof)
+  {
+    size_t head_end;
+    while ((head_end = in.find("\r\n\r\n")) != std::string::npos)
+    {
+      Response r;
+      std::string head = in.substr(0, head_end);
+      size_t length = 0, field = head.find("Content-Length: ");
+      if (field != std::string::npos)
+        length = std::stoul(head.substr(field + 16));
+      if (in.size() < head_end + 4 + length)
+        break;
+      r.status = std::stoi(head.substr(9, 3));
+      r.close = head.find("\r\nConnection: close") != std::string::npos;
+      r.body = in.substr(head_end + 4, length);
+      in.erase(0, head_end + 4 + length);
+      out.push_back(r);
+    }
+    if (out.size() >= count)
+      break;
+    ssize_t n = ::recv(fd, buffer, sizeof buffer, 0);
+    if (n <= 0)
+      eof = true;
+    else
+      in.append(buffer, static_cast<size_t>(n));
+  }
+  if (closed)
+  {
+    ssize_t n = eof ? 0 : ::recv(fd, buffer, sizeof buffer, 0);
+    *closed = n == 0 && in.empty();
+  }
+  return out;
+}
+
+static std::string post(const std::string &body, const std::string &extra = "", const std::string &version = "1.1")
+{
+  return "POST /process_order HTTP/" + version + "\r\nHost: localhost\r\nContent-Type: application/json\r\n" + extra +
+         "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+// An order, the JSON that carries it and the numbers Python would print
+struct Case
+{
+  double weight;
+  double distance;
+  bool urgent;
+  std::string json;
+  std::string weight_repr;
+  std::string distance_repr;
+};
+
+int main()
+{
+  int failures = 0;
+  auto check = [&](bool ok, const std::string &what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what.c_str());
+      ++failures;
+    }
+  };
+
+  // A free port, then the server on it with two loops
+  int probe = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  socklen_t size = sizeof addr;
+  addr.sin_family = AF_INET;
+  ::bind(probe, reinterpret_cast<sockaddr *>(&addr), sizeof addr);
+  ::getsockname(probe, reinterpret_cast<sockaddr *>(&addr), &size);
+  int port = ntohs(addr.sin_port);
+  ::close(probe);
+  reset_system();
+  int served = 1;
+  std::thread server([&] { served = run_order_server(port, 2); });
+  int fd = -1;
+  for (int i = 0; i < 500 && fd < 0; ++i)
+    if ((fd = connect_to(port)) < 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  check(fd >= 0, "server accepts connections");
+
+  const std::vector<Case> cases = {
+      {12.5, 900.0, true, R"({"weight": 12.5, "distance": 900, "urgent": "true"})", "12.5", "900.0"},
+      {1e12, 0.0001, false, R"({"distance": 0.0001, "weight": 1e12})", "1000000000000.0", "0.0001"},
+      {300.0, 1e-05, false, R"({"weight": "300", "distance": 1e-5, "urgent": true})", "300.0", "1e-05"},
+      {5.0, 1e16, true, R"({"weight":5,"distance":1E16,"urgent":"true"})", "5.0", "1e+16"},
+      {150.0, 9999999999999998.0, false, R"({"weight": 150, "distance": 9999999999999998})", "150.0",
+       "9999999999999998.0"},
+      {0.30000000000000004, 123456789.125, false,
+       R"({"note": {"a": [1, {"b": "x\"y"}]}, "weight": 0.30000000000000004, "distance": 123456789.125})",
+       "0.30000000000000004", "123456789.125"},
+      {5e-324, 1.7976931348623157e308, false, R"({"weight": 5e-324, "distance": 1.7976931348623157e308})", "5e-324",
+       "1.7976931348623157e+308"},
+      {-0.0, -2.5, false, R"({"weight": -0.0, "distance": -2.5})", "-0.0", "-2.5"},
+      {1000.0, 0.00015, true, R"({"weight": "1E3", "distance": " +1.5e-4 ", "urgent": "true"})", "1000.0", "0.00015"},
+      {12345678901234567890.0, 42.0, false, R"({"weight": 12345678901234567890, "distance": 42.0})",
+       "1.2345678901234567e+19", "42.0"},
+      {19.0, 501.0, true, R"( { "urgent" : "true" , "weight" : 19 , "distance" : 501 } )", "19.0", "501.0"}};
+
+  // Every case pipelined in one send, with errors between them that must
+  // be answered in turn without closing the connection
+  std::string batch;
+  for (size_t i = 0; i < cases.size(); ++i)
+  {
+    batch += post(cases[i].json);
+    if (i == 2)
+      batch += "GET /process_order HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    if (i == 5)
+      batch += "POST /orders HTTP/1.1\r\nContent-Length: 2\r\n\r\n{}";
+    if (i == 7)
+      batch += post(R"({"weight": "abc", "distance": 1})") + post(R"({"weight": 1})") + post("hello") +
+               post(R"({"weight": "nan", "distance": 1})") + post(R"({"weight": 1e999, "distance": 1})");
+  }
+  send_all(fd, batch);
+  std::vector<Response> got = receive(fd, cases.size() + 7);
+  check(got.size() == cases.size() + 7, "pipelined answers");
+  const std::vector<int> statuses = {200, 200, 200, 405, 200, 200, 200, 404, 200, 200,
+                                     400, 400, 400, 400, 400, 200, 200, 200};
+  std::vector<Response> orders;
+  for (size_t i = 0; i < got.size() && i < statuses.size(); ++i)
+  {
+    check(got[i].status == statuses[i] && !got[i].close, "answer " + std::to_string(i) + " status");
+    if (got[i].status == 200)
+      orders.push_back(got[i]);
+  }
+
+  // One request a byte at a time
+  std::string slow = post(cases[0].json);
+  for (char c : slow)
+  {
+    send_all(fd, std::string(1, c));
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  std::vector<Response> one = receive(fd, 1);
+  check(one.size() == 1 && one[0].status == 200, "request sent a byte at a time");
+  ::close(fd);
+
+  // Requests that close their connection, with the status they get
+  const std::pair<std::string, int> closing[] = {
+      {post(cases[0].json, "", "1.0"), 200},
+      {post(cases[0].json, "Connection: close\r\n"), 200},
+      {"BADREQUEST\r\n\r\n", 400},
+      {"POST /process_order HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n0\r\n\r\n", 413},
+      {"POST /process_order HTTP/1.1\r\nContent-Length: 70000\r\n\r\n", 413},
+      {"POST /process_order HTTP/1.1\r\nX-Padding: " + std::string(9000, 'x'), 431}};
+  for (const auto &request : closing)
+  {
+    int c = connect_to(port);
+    send_all(c, request.first);
+    bool closed = false;
+    std::vector<Response> answer = receive(c, 1, &closed);
+    std::string what = "closing request " + request.first.substr(0, 30);
+    check(answer.size() == 1 && answer[0].status == request.second, what + ": status");
+    check(answer.size() == 1 && answer[0].close && closed, what + ": connection closed");
+    ::close(c);
+  }
+
+  stop_order_server();
+  server.join();
+  check(served == 0, "run_order_server returns 0 after stop_order_server");
+
+  // Each answer against the order log Factory.py parses, rebuilt here
+  check(orders.size() == cases.size(), "one answer per order");
+  for (size_t i = 0; i < orders.size() && i < cases.size(); ++i)
+  {
+    const Case &c = cases[i];
+    const std::string &body = orders[i].body;
+    int id = 0;
+    size_t at = body.find("\"id\":");
+    if (at != std::string::npos)
+      id = atoi(body.c_str() + at + 5);
+    check(id >= 1000 && id <= 9999, "case " + std::to_string(i) + ": id " + std::to_string(id));
+    reset_system();
+    add_order(id, c.weight, c.distance, c.urgent);
+    std::string log = get_orders_log();
+    size_t info_at = log.find("] "), eta_at = log.find(" -> ETA: ");
+    std::string info = log.substr(info_at + 2, eta_at - info_at - 2);
+    std::string eta = log.substr(eta_at + 9, log.find('\n') - eta_at - 9);
+    const char *type = info.find("Air") != std::string::npos ? "air"
+                       : info.find("Ship") != std::string::npos ? "ship"
+                                                                : "truck";
+    std::string want = "{\"distance\":" + c.distance_repr + ",\"eta\":\"" + eta + "\",\"id\":" + std::to_string(id) +
+                       ",\"info\":\"" + info + "\",\"type\":\"" + type + "\",\"urgent\":" +
+                       (c.urgent ? "true" : "false") + ",\"weight\":" + c.weight_repr + "}";
+    check(body == want, "case " + std::to_string(i) + ": " + body + " != " + want);
+  }
+  check(orders.size() > 10 && orders[10].body.find("\"type\":\"air\"") != std::string::npos, "an air order");
+  check(orders.size() > 1 && orders[1].body.find("\"type\":\"ship\"") != std::string::npos, "a ship order");
+
+  reset_system();
+  if (failures)
+    return 1;
+  printf("http server: ok\n");
+  return 0;
+}
@@ -0,0 +1,124 @@
+// Checkpoint, ingest more, then load the checkpoint and recover the journal
+// tail: the recovered book must hold the same decisions as the original,
+// also when the journal ends in a torn frame.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/journal_recover.cpp -o journal_recover ./logistics.so
+// Usage: journal_recover [TMP_DIR]
+// Exits non-zero on failure.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+extern "C"
+{
+  void reset_system();
+  void add_order(int id, double weight, double distance, bool urgent);
+  void add_orders_batch(const int *ids, const double *weights, const double *distances, const bool *urgent, int n);
+  int get_order_count();
+  int open_journal(const char *path, int backend);
+  int close_journal();
+  int start_checkpoint(const char *path);
+  int checkpoint_status();
+  int64_t load_checkpoint(const char *path);
+  int64_t recover_journal(const char *path, int64_t offset);
+  const void *get_decision_frames(int64_t first, int64_t count, int64_t *size);
+}
+
+static void ingest(int first_id, int n)
+{
+  std::vector<int> ids(n);
+  std::vector<double> weights(n), distances(n);
+  std::vector<char> urgent(n);
+  for (int i = 0; i < n; ++i)
+  {
+    int id = first_id + i;
+    ids[i] = id;
+    weights[i] = 0.5 + (id * 37 % 4000) / 8.0;
+    distances[i] = 10.0 + (id * 53 % 9000) * 0.75;
+    urgent[i] = id % 5 == 0;
+  }
+  add_orders_batch(ids.data(), weights.data(), distances.data(), reinterpret_cast<const bool *>(urgent.data()), n);
+  add_order(first_id + n, 3.0, 250.0, true);
+}
+
+static std::string decisions()
+{
+  int64_t size = 0;
+  const void *frames = get_decision_frames(0, get_order_count(), &size);
+  return frames ? std::string(static_cast<const char *>(frames), static_cast<size_t>(size)) : std::string();
+}
+
+int main(int argc, char **argv)
+{
+  std::string dir = argc > 1 ? argv[1] : "/tmp";
+  std::string journal = dir + "/journal_recover-" + std::to_string(::getpid()) + ".journal";
+  std::string checkpoint = dir + "/journal_recover-" + std::to_string(::getpid()) + ".ckpt";
+  int failures = 0;
+  auto check = [&](bool ok, const char *what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what);
+      ++failures;
+    }
+  };
+
+  reset_system();
+  check(open_journal(journal.c_str(), 2) >= 0, "open_journal");
+  for (int i = 0; i < 20; ++i)
+    ingest(i * 10000, 5000);
+  check(start_checkpoint(checkpoint.c_str()) == 0, "start_checkpoint");
+  for (int i = 20; i < 35; ++i)
+    ingest(i * 10000, 3000);
+  int status;
+  while ((status = checkpoint_status()) == 1)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  check(status == 0, "checkpoint_status");
+  for (int i = 35; i < 40; ++i)
+    ingest(i * 10000, 3000);
+  check(close_journal() == 0, "close_journal");
+  int count = get_order_count();
+  std::string original = decisions();
+
+  for (int torn = 0; torn < 2; ++torn)
+  {
+    if (torn)
+    {
+      // A crash in the middle of the next append leaves half a frame behind
+      FILE *f = fopen(journal.c_str(), "ab");
+      std::string head(original.substr(0, 1000));
+      check(f && fwrite(head.data(), 1, head.size(), f) == head.size() && fclose(f) == 0, "append torn frame");
+    }
+    reset_system();
+    int64_t offset = load_checkpoint(checkpoint.c_str());
+    check(offset > 0, "load_checkpoint");
+    int loaded = get_order_count();
+    int64_t recovered = recover_journal(journal.c_str(), offset);
+    check(recovered > 0 && loaded + recovered == count, "recovered order count");
+    check(get_order_count() == count, "order count after recovery");
+    check(decisions() == original, "decisions after recovery");
+  }
+
+  // Reopening cuts the torn frame off, and new orders land behind the old ones
+  check(open_journal(journal.c_str(), 2) >= 0, "reopen journal");
+  ingest(900000, 100);
+  check(close_journal() == 0, "close reopened journal");
+  std::string extended = decisions();
+  reset_system();
+  int64_t offset = load_checkpoint(checkpoint.c_str());
+  check(recover_journal(journal.c_str(), offset) > 0 && decisions() == extended, "recovery after reopen");
+
+  reset_system();
+  ::unlink(journal.c_str());
+  ::unlink(checkpoint.c_str());
+  if (failures)
+    return 1;
+  printf("journal recovery: %d orders, ok\n", count);
+  return 0;
+}
@@ -0,0 +1,234 @@
+// Micro-batching must hand every caller its own results: threads calling
+// submit_order, with invalid orders among them, and a daemon client
+// pipelining orders at the same time are merged into shared batches, yet
+// each order gets the kind its inputs give and each daemon answer carries
+// its own order and the book row it was stored at. The stats count every
+// classified order once, and fewer batches than orders while merging; with
+// the window at 0 or one order per batch, every group runs alone.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/micro_batch.cpp -o micro_batch ./logistics.so -pthread
+// Usage: micro_batch [TMP_DIR]
+// Exits non-zero on failure.
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+extern "C"
+{
+  void reset_system();
+  void add_order(int id, double weight, double distance, bool urgent);
+  int get_order_count();
+  int get_order_kind(int index);
+  int list_orders_where(int all_of, int any_of, int none_of, int *out_ids, int max_ids);
+  int submit_order(int64_t client, int id, double weight, double distance, bool urgent);
+  void set_micro_batch(int64_t window_us, int max_orders);
+  void get_micro_batch_stats(int64_t *batches, int64_t *orders);
+  int run_order_daemon(const char *socket_path);
+  void stop_order_daemon();
+}
+
+struct DaemonRequest
+{
+  uint16_t op;
+  uint16_t flags;
+  uint32_t seq;
+  int32_t id;
+  uint32_t urgent;
+  double weight_kg;
+  double distance_km;
+};
+
+struct DaemonResponse
+{
+  uint16_t op;
+  int16_t status;
+  uint32_t seq;
+  int64_t value;
+  int32_t id;
+  int32_t weight_g;
+  int32_t distance_dam;
+  uint32_t meta;
+};
+
+constexpr int THREADS = 4;
+constexpr int PER_THREAD = 5000;
+constexpr int DAEMON_ORDERS = 3000;
+
+// Each thread leans to one kind, so a result handed to the wrong caller
+// shows; every 97th order is invalid
+static double weight_of(int id) { return id % 4 == 1 ? 1500.0 : (id % 4 == 2 ? 5.0 + id % 13 : 40.0 + id % 300); }
+static double distance_of(int id) { return id % 97 == 0 ? NAN : 100.0 + id * 37 % 1800; }
+static bool urgent_of(int id) { return id % 4 == 2 || id % 11 == 0; }
+
+// The kind add_order gives on its own, or -1 for an invalid order
+static int expected_kind(int id)
+{
+  if (std::isnan(distance_of(id)))
+    return -1;
+  reset_system();
+  add_order(id, weight_of(id), distance_of(id), urgent_of(id));
+  return get_order_kind(0);
+}
+
+int main(int argc, char **argv)
+{
+  std::string dir = argc > 1 ? argv[1] : "/tmp";
+  std::string path = dir + "/micro_batch-" + std::to_string(::getpid()) + ".sock";
+  int failures = 0;
+  auto check = [&](bool ok, const std::string &what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what.c_str());
+      ++failures;
+    }
+  };
+
+  // Thread t submits ids t + 1, t + 1 + THREADS, ...; the daemon client ids
+  // from 1000000 on
+  std::unordered_map<int, int> want;
+  for (int i = 0; i < THREADS * PER_THREAD; ++i)
+    want[i + 1] = expected_kind(i + 1);
+  for (int i = 0; i < DAEMON_ORDERS; ++i)
+    want[1000000 + i] = expected_kind(1000000 + i);
+  reset_system();
+
+  auto run = [&](int64_t window_us, int max_orders, const std::string &phase)
+  {
+    reset_system();
+    set_micro_batch(window_us, max_orders);
+    int64_t batches_before = 0, orders_before = 0, batches = 0, orders = 0;
+    get_micro_batch_stats(&batches_before, &orders_before);
+
+    std::thread daemon([&] { run_order_daemon(path.c_str()); });
+    int fd = -1;
+    for (int i = 0; i < 500 && fd < 0; ++i)
+    {
+      sockaddr_un addr{};
+      addr.sun_family = AF_UNIX;
+      memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+      fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+      if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) != 0)
+      {
+        ::close(fd);
+        fd = -1;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+    check(fd >= 0, phase + ": daemon reachable");
+
+    // The daemon client pipelines in runs of 50 while the threads submit
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t)
+      threads.emplace_back([&, t]
+      {
+        for (int i = 0; i < PER_THREAD; ++i)
+        {
+          int id = t + 1 + i * THREADS;
+          if (submit_order(t, id, weight_of(id), distance_of(id), urgent_of(id)) != want[id])
+            ++wrong;
+        }
+      });
+    std::vector<DaemonResponse> answers;
+    for (int at = 0; at < DAEMON_ORDERS; at += 50)
+    {
+      DaemonRequest reqs[50];
+      for (int i = 0; i < 50; ++i)
+      {
+        int id = 1000000 + at + i;
+        reqs[i] = {1, 0, static_cast<uint32_t>(at + i), id, urgent_of(id) ? 1u : 0u, weight_of(id), distance_of(id)};
+      }
+      DaemonResponse res[50];
+      size_t got = 0;
+      bool sent = ::send(fd, reqs, sizeof reqs, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof reqs);
+      while (sent && got < sizeof res)
+      {
+        ssize_t n = ::recv(fd, reinterpret_cast<char *>(res) + got, sizeof res - got, 0);
+        if (n <= 0)
+          break;
+        got += static_cast<size_t>(n);
+      }
+      if (got != sizeof res)
+      {
+        check(false, phase + ": daemon answers");
+        break;
+      }
+      answers.insert(answers.end(), res, res + 50);
+    }
+    for (std::thread &t : threads)
+      t.join();
+    ::close(fd);
+    stop_order_daemon();
+    daemon.join();
+    check(wrong == 0, phase + ": " + std::to_string(wrong.load()) + " submit_order results for another order");
+
+    // Every daemon answer is its own order, stored at the row it reports
+    int n = get_order_count();
+    std::vector<int> ids(static_cast<size_t>(n));
+    list_orders_where(0, 0, 0, ids.data(), n);
+    int valid = 0;
+    for (const auto &w : want)
+      valid += w.second >= 0;
+    check(n == valid, phase + ": the book holds every valid order once");
+    for (size_t i = 0; i < answers.size(); ++i)
+    {
+      const DaemonResponse &r = answers[i];
+      int id = 1000000 + static_cast<int>(i);
+      int kind = want[id];
+      bool ok = r.seq == i && (kind < 0 ? r.status == -1
+                                        : r.status == 0 && r.id == id && static_cast<int>(r.meta & 3) == kind &&
+                                              r.value >= 1 && r.value <= n && ids[r.value - 1] == id);
+      if (!ok)
+      {
+        check(false, phase + ": daemon answer " + std::to_string(i) + " (row " + std::to_string(r.value) + ")");
+        break;
+      }
+    }
+    for (int i = 0; i < n; ++i)
+      if (get_order_kind(i) != want[ids[i]])
+      {
+        check(false, phase + ": stored kind of order " + std::to_string(ids[i]));
+        break;
+      }
+
+    get_micro_batch_stats(&batches, &orders);
+    batches -= batches_before;
+    orders -= orders_before;
+    check(orders == valid, phase + ": stats count every order once: " + std::to_string(orders));
+    return batches;
+  };
+
+  int64_t merged = run(2000, 4, "window 2 ms, 4 orders");
+  int64_t groups = THREADS * PER_THREAD + DAEMON_ORDERS / 50;
+  check(merged < groups * 3 / 4, "merging: " + std::to_string(merged) + " batches for " + std::to_string(groups));
+  int64_t alone = run(0, 64, "window 0");
+  int64_t single = run(2000, 1, "one order per batch");
+  int64_t valid_threads = 0;
+  for (const auto &w : want)
+    valid_threads += w.first < 1000000 && w.second >= 0;
+  // At least one batch per submit_order call and per daemon run; invalid
+  // orders split the runs further
+  int64_t least = valid_threads + DAEMON_ORDERS / 50;
+  check(alone >= least, "window 0: " + std::to_string(alone) + " batches, not merged");
+  check(single >= least, "one order per batch: " + std::to_string(single) + " batches, not merged");
+
+  set_micro_batch(0, 1);
+  reset_system();
+  if (failures)
+    return 1;
+  printf("micro batch: ok\n");
+  return 0;
+}
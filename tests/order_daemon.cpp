@@ -0,0 +1,276 @@
+// The order daemon, run in a child process, must classify what its clients
+// send exactly as the library does locally: a pipeline of 200k orders sent
+// a window at a time, with invalid orders among them, answered in order
+// with the kinds and order count the local book gives. Over the raw
+// protocol every response echoes its request's seq, requests split across
+// writes are answered once whole, unknown ops get -1, and a client that
+// writes 3 MB without reading is answered in full once it reads, while
+// other clients are served meanwhile. A forked client gets a connection of
+// its own, and a second daemon never takes over a live socket.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/order_daemon.cpp -o order_daemon_test ./logistics.so -pthread
+// Usage: order_daemon_test [TMP_DIR]
+// Exits non-zero on failure.
+
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern "C"
+{
+  void reset_system();
+  void add_order(int id, double weight, double distance, bool urgent);
+  void add_orders_batch(const int *ids, const double *weights, const double *distances, const bool *urgent, int n);
+  int get_order_count();
+  int get_order_kind(int index);
+  const char *get_orders_log();
+  int run_order_daemon(const char *socket_path);
+  void stop_order_daemon();
+  int connect_order_daemon(const char *socket_path);
+  const char *daemon_add_order(int id, double weight, double distance, bool urgent);
+  int64_t daemon_add_orders(const int *ids, const double *weights, const double *distances, const bool *urgent,
+                            int64_t n, int *out_kinds);
+  int get_daemon_status();
+  int64_t daemon_reset();
+  int64_t daemon_order_count();
+}
+
+struct DaemonRequest
+{
+  uint16_t op;
+  uint16_t flags;
+  uint32_t seq;
+  int32_t id;
+  uint32_t urgent;
+  double weight_kg;
+  double distance_km;
+};
+
+struct DaemonResponse
+{
+  uint16_t op;
+  int16_t status;
+  uint32_t seq;
+  int64_t value;
+  int32_t id;
+  int32_t weight_g;
+  int32_t distance_dam;
+  uint32_t meta;
+};
+
+constexpr uint16_t SUBMIT = 1, RESET = 2, COUNT = 3;
+
+static double weight_of(int id) { return id % 5 == 0 ? 1500.0 : (id % 7 == 0 ? 10.0 + id % 9 : 50.0 + id % 400); }
+static double distance_of(int id) { return 20.0 + id * 37 % 2900; }
+static bool urgent_of(int id) { return id % 3 == 0; }
+
+static int connect_to(const std::string &path)
+{
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) != 0)
+  {
+    ::close(fd);
+    return -1;
+  }
+  timeval timeout{10, 0};
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+  return fd;
+}
+
+static bool write_all(int fd, const void *data, size_t size)
+{
+  const char *p = static_cast<const char *>(data);
+  while (size > 0)
+  {
+    ssize_t n = ::send(fd, p, size, MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+static bool read_all(int fd, void *data, size_t size)
+{
+  char *p = static_cast<char *>(data);
+  while (size > 0)
+  {
+    ssize_t n = ::recv(fd, p, size, 0);
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+static void on_signal(int) { stop_order_daemon(); }
+
+int main(int argc, char **argv)
+{
+  std::string dir = argc > 1 ? argv[1] : "/tmp";
+  std::string path = dir + "/order_daemon-" + std::to_string(::getpid()) + ".sock";
+  int failures = 0;
+  auto check = [&](bool ok, const std::string &what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what.c_str());
+      ++failures;
+    }
+  };
+
+  pid_t daemon = ::fork();
+  if (daemon == 0)
+  {
+    signal(SIGTERM, on_signal);
+    _exit(run_order_daemon(path.c_str()) == 0 ? 0 : 1);
+  }
+  bool reachable = false;
+  for (int i = 0; i < 500 && !reachable; ++i)
+    if (!(reachable = connect_order_daemon(path.c_str()) == 0))
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  check(reachable, "daemon reachable");
+  check(daemon_reset() == 0 && daemon_order_count() == 0, "daemon_reset");
+
+  // 200k orders in one pipeline, every thousandth invalid; the local book
+  // classifies the valid ones for comparison
+  const int n = 200000;
+  std::vector<int> ids(n), kinds(n, 99), valid_ids;
+  std::vector<double> weights(n), distances(n), valid_weights, valid_distances;
+  std::vector<char> urgent(n), valid_urgent;
+  for (int i = 0; i < n; ++i)
+  {
+    ids[i] = i + 1;
+    weights[i] = i % 1000 == 999 ? NAN : weight_of(ids[i]);
+    distances[i] = i % 1000 == 499 ? INFINITY : distance_of(ids[i]);
+    urgent[i] = urgent_of(ids[i]);
+    if (std::isfinite(weights[i]) && std::isfinite(distances[i]))
+    {
+      valid_ids.push_back(ids[i]);
+      valid_weights.push_back(weights[i]);
+      valid_distances.push_back(distances[i]);
+      valid_urgent.push_back(urgent[i]);
+    }
+  }
+  reset_system();
+  add_orders_batch(valid_ids.data(), valid_weights.data(), valid_distances.data(),
+                   reinterpret_cast<const bool *>(valid_urgent.data()), static_cast<int>(valid_ids.size()));
+  int64_t held = daemon_add_orders(ids.data(), weights.data(), distances.data(),
+                                   reinterpret_cast<const bool *>(urgent.data()), n, kinds.data());
+  check(held == static_cast<int64_t>(valid_ids.size()), "daemon holds the valid orders: " + std::to_string(held));
+  for (int i = 0, v = 0; i < n; ++i)
+  {
+    bool valid = std::isfinite(weights[i]) && std::isfinite(distances[i]);
+    int want = valid ? get_order_kind(v++) : -1;
+    if (kinds[i] != want)
+    {
+      check(false, "kind of order " + std::to_string(ids[i]) + ": " + std::to_string(kinds[i]) + ", not " +
+                       std::to_string(want));
+      break;
+    }
+  }
+  check(daemon_order_count() == held, "daemon_order_count");
+
+  // One order at a time: the same log line as the local book
+  for (int id : {7, 10, 12345, 2000})
+  {
+    reset_system();
+    add_order(id, weight_of(id), distance_of(id), urgent_of(id));
+    std::string want = get_orders_log();
+    want.erase(want.find_last_not_of('\n') + 1);
+    const char *line = daemon_add_order(id, weight_of(id), distance_of(id), urgent_of(id));
+    check(line && want == line && get_daemon_status() == 0, "log line of order " + std::to_string(id));
+  }
+  check(!daemon_add_order(1, NAN, 10.0, false) && get_daemon_status() == -1, "an invalid order: NULL, status -1");
+
+  // Raw protocol: seq echoed, a request split across writes, unknown ops
+  int fd = connect_to(path);
+  check(fd >= 0, "raw connection");
+  DaemonRequest reqs[4] = {{COUNT, 0, 101, 0, 0, 0, 0},
+                           {SUBMIT, 0, 102, 55, 1, 10.0, 900.0},
+                           {77, 0, 103, 0, 0, 0, 0},
+                           {SUBMIT, 0, 104, 56, 0, 1500.0, 100.0}};
+  const char *bytes = reinterpret_cast<const char *>(reqs);
+  write_all(fd, bytes, 40);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  write_all(fd, bytes + 40, sizeof reqs - 40);
+  DaemonResponse res[4];
+  check(read_all(fd, res, sizeof res), "raw responses");
+  int64_t count = res[0].value;
+  check(res[0].seq == 101 && res[0].status == 0 && res[0].op == COUNT, "COUNT answered");
+  check(res[1].seq == 102 && res[1].status == 0 && res[1].id == 55 && (res[1].meta & 3) == 2 &&
+            res[1].value == count + 1,
+        "SUBMIT split across writes answered with its decision");
+  check(res[2].seq == 103 && res[2].status == -1 && res[2].op == 77, "unknown op: -1");
+  check(res[3].seq == 104 && res[3].status == 0 && (res[3].meta & 3) == 1 && res[3].value == count + 2,
+        "SUBMIT after an unknown op");
+
+  // 100k requests (3.2 MB of answers) written without reading: the daemon
+  // stops reading this client, serves another meanwhile, and answers
+  // everything in order once this one reads
+  const uint32_t flood = 100000;
+  std::vector<DaemonRequest> many(flood);
+  for (uint32_t i = 0; i < flood; ++i)
+  {
+    int id = 500000 + static_cast<int>(i);
+    many[i] = {SUBMIT, 0, 1000 + i, id, urgent_of(id) ? 1u : 0u, weight_of(id), distance_of(id)};
+  }
+  std::thread writer([&] { write_all(fd, many.data(), many.size() * sizeof(DaemonRequest)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  int64_t during = daemon_order_count();
+  check(during >= count + 2 && during < count + 2 + flood, "another client is served while one does not read");
+  std::vector<DaemonResponse> answers(flood);
+  check(read_all(fd, answers.data(), answers.size() * sizeof(DaemonResponse)), "every answer arrives");
+  writer.join();
+  bool in_order = true;
+  for (uint32_t i = 0; i < flood && in_order; ++i)
+    in_order = answers[i].seq == 1000 + i && answers[i].status == 0 && answers[i].id == many[i].id &&
+               answers[i].value == count + 3 + i;
+  check(in_order, "answers in request order with growing counts");
+  DaemonRequest reset{RESET, 0, 7, 0, 0, 0, 0};
+  DaemonResponse after{};
+  check(write_all(fd, &reset, sizeof reset) && read_all(fd, &after, sizeof after) && after.seq == 7 &&
+            after.value == 0,
+        "RESET over the same connection");
+  ::close(fd);
+
+  // A forked client opens its own connection
+  pid_t child = ::fork();
+  if (child == 0)
+    _exit(daemon_add_order(9, weight_of(9), distance_of(9), urgent_of(9)) && daemon_order_count() == 1 ? 0 : 1);
+  int status = 0;
+  ::waitpid(child, &status, 0);
+  check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "forked client served");
+  check(daemon_order_count() == 1, "parent connection still works after a fork");
+
+  // A second daemon refuses the live socket
+  check(run_order_daemon(path.c_str()) == -1, "second daemon on a live socket: -1");
+  check(daemon_order_count() == 1, "live daemon untouched");
+
+  ::kill(daemon, SIGTERM);
+  ::waitpid(daemon, &status, 0);
+  check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "daemon stops cleanly");
+  check(::access(path.c_str(), F_OK) != 0, "daemon removes its socket");
+  check(daemon_order_count() == -1, "unreachable daemon: -1");
+  reset_system();
+  if (failures)
+    return 1;
+  printf("order daemon: ok\n");
+  return 0;
+}
@@ -0,0 +1,175 @@
+// Transport and flag filters answered from the bitmaps must match a scan of
+// the live orders: on a fresh book with long runs and scattered rows, after
+// count retention drops front segments, and after the row ids run out and
+// the store renumbers its segments. The wall clock the library reads is
+// faked here, so 65536 one-millisecond segments take no real time.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/order_filters.cpp -o order_filters ./logistics.so -pthread
+// Exits non-zero on failure.
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+extern "C"
+{
+  void reset_system();
+  void set_retention(int64_t max_orders, double max_hours);
+  void add_order(int id, double weight, double distance, bool urgent);
+  void add_orders_batch(const int *ids, const double *weights, const double *distances, const bool *urgent, int n);
+  int get_order_count();
+  int get_order_kind(int index);
+  int count_orders_where(int all_of, int any_of, int none_of);
+  int list_orders_where(int all_of, int any_of, int none_of, int *out_ids, int max_ids);
+}
+
+// CLOCK_REALTIME as the library sees it; every other clock is the real one
+static int64_t fake_ms = 1700000000000;
+
+extern "C" int clock_gettime(clockid_t clock, timespec *ts)
+{
+  if (clock != CLOCK_REALTIME)
+    return static_cast<int>(::syscall(SYS_clock_gettime, clock, ts));
+  ts->tv_sec = static_cast<time_t>(fake_ms / 1000);
+  ts->tv_nsec = static_cast<long>(fake_ms % 1000 * 1000000);
+  return 0;
+}
+
+constexpr int SEGMENT_ROWS = 65536;
+constexpr int TRUCK = 1, SHIP = 2, AIR = 4, URGENT = 8, HEAVY = 16, RESERVED = 32, EXPRESS = 64;
+
+struct Order
+{
+  int id;
+  double weight;
+  double distance;
+  bool urgent;
+};
+
+// Every order ever added, oldest first; the book holds the newest of them
+static std::vector<Order> added;
+
+// A mix of light and heavy trucks, ships and planes
+static Order mixed(int id)
+{
+  uint32_t h = static_cast<uint32_t>(id) * 2654435761u;
+  const double weights[] = {5.0, 12.5, 150.0, 450.0, 1500.0};
+  const double distances[] = {40.0, 800.0, 1900.0, 2600.0};
+  return {id, weights[h >> 8 & 3 ? (h >> 10) % 5 : 0], distances[(h >> 13) % 4], (h >> 17 & 3) == 0};
+}
+
+static void add_all(const std::vector<Order> &orders)
+{
+  std::vector<int> ids;
+  std::vector<double> weights, distances;
+  std::vector<char> urgent;
+  for (const Order &o : orders)
+  {
+    ids.push_back(o.id);
+    weights.push_back(o.weight);
+    distances.push_back(o.distance);
+    urgent.push_back(o.urgent);
+    added.push_back(o);
+  }
+  add_orders_batch(ids.data(), weights.data(), distances.data(), reinterpret_cast<const bool *>(urgent.data()),
+                   static_cast<int>(ids.size()));
+}
+
+int main()
+{
+  int failures = 0;
+  auto check = [&](bool ok, const std::string &what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what.c_str());
+      ++failures;
+    }
+  };
+
+  // Every filter on its own, in combinations, and as exclusions
+  const int masks[][3] = {{0, 0, 0},        {TRUCK, 0, 0},        {SHIP, 0, 0},      {AIR, 0, 0},
+                          {URGENT, 0, 0},   {HEAVY, 0, 0},        {RESERVED, 0, 0},  {EXPRESS, 0, 0},
+                          {SHIP | URGENT, 0, 0}, {0, TRUCK | AIR, URGENT}, {URGENT, HEAVY | RESERVED, 0},
+                          {0, 0, TRUCK},    {TRUCK | URGENT, 0, HEAVY}, {0, SHIP | AIR, EXPRESS}};
+
+  // Compares every mask against a scan of the live orders
+  auto verify = [&](const char *phase)
+  {
+    int n = get_order_count();
+    check(n >= 0 && static_cast<size_t>(n) <= added.size(), std::string(phase) + ": order count");
+    std::vector<int> flags(static_cast<size_t>(n));
+    for (int i = 0; i < n; ++i)
+    {
+      const Order &o = added[added.size() - static_cast<size_t>(n) + static_cast<size_t>(i)];
+      int kind = get_order_kind(i);
+      flags[i] = (1 << kind) | (o.urgent ? URGENT : 0) | (kind == 0 && o.weight > 200.0 ? HEAVY : 0) |
+                 (kind == 1 ? RESERVED : 0) | (kind == 2 ? EXPRESS : 0);
+    }
+    for (const auto &m : masks)
+    {
+      std::vector<int> want;
+      for (int i = 0; i < n; ++i)
+        if ((flags[i] & m[0]) == m[0] && (!m[1] || flags[i] & m[1]) && !(flags[i] & m[2]))
+          want.push_back(added[added.size() - static_cast<size_t>(n) + static_cast<size_t>(i)].id);
+      std::vector<int> got(static_cast<size_t>(n) + 1, -1);
+      int total = list_orders_where(m[0], m[1], m[2], got.data(), n + 1);
+      got.resize(want.size());
+      std::string what = std::string(phase) + ": filter " + std::to_string(m[0]) + "/" + std::to_string(m[1]) + "/" +
+                         std::to_string(m[2]);
+      check(count_orders_where(m[0], m[1], m[2]) == static_cast<int>(want.size()), what + " count");
+      check(total == static_cast<int>(want.size()) && got == want, what + " list");
+    }
+  };
+
+  // A long run of identical light trucks, then scattered kinds and flags
+  reset_system();
+  std::vector<Order> orders;
+  for (int i = 0; i < 70000; ++i)
+    orders.push_back({i + 1, 5.0, 40.0, false});
+  for (int i = 70000; i < 200000; ++i)
+    orders.push_back(mixed(i + 1));
+  add_all(orders);
+  verify("fresh");
+
+  // Count retention drops the front segments with their bitmap chunks
+  set_retention(100000, 0);
+  orders.clear();
+  for (int i = 200000; i < 220000; ++i)
+    orders.push_back(mixed(i + 1));
+  add_all(orders);
+  check(get_order_count() < 220000, "retention dropped segments");
+  verify("after retention");
+
+  // One-millisecond segments under a 16 ms age limit: segment 65536 runs
+  // out of 16-bit numbers and the store renumbers the live ones from 0.
+  // Rows from before and after that stay live together for 16 ms.
+  set_retention(0, 16.0 / 3600000.0);
+  reset_system();
+  for (int i = 0; i < SEGMENT_ROWS + 20; ++i)
+  {
+    ++fake_ms;
+    Order o = mixed(300000 + i);
+    added.push_back(o);
+    add_order(o.id, o.weight, o.distance, o.urgent);
+    if (i >= SEGMENT_ROWS - 4)
+      verify(("around renumbering, segment " + std::to_string(i)).c_str());
+  }
+  set_retention(0, 0);
+  orders.clear();
+  for (int i = 0; i < 150000; ++i)
+    orders.push_back(mixed(400000 + i));
+  add_all(orders);
+  verify("filled after renumbering");
+
+  reset_system();
+  if (failures)
+    return 1;
+  printf("order filters: ok\n");
+  return 0;
+}
@@ -0,0 +1,211 @@
+// Quantile sketches must stay within their rank error: the history sketches
+// (k = 200, about 0.85%) over 600k orders submitted from several serving
+// threads, per kind and over all kinds, and the per-minute sketches (k = 64,
+// about 2.7%) over the windows a query covers. The rank of each answer is
+// checked against the exact sorted values. Queries without data give NaN.
+// The wall clock the library reads is faked here.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/order_quantiles.cpp -o order_quantiles ./logistics.so -pthread
+// Exits non-zero on failure.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+extern "C"
+{
+  void reset_system();
+  void add_orders_batch(const int *ids, const double *weights, const double *distances, const bool *urgent, int n);
+  int submit_order(int64_t client, int id, double weight, double distance, bool urgent);
+  int get_order_count();
+  int get_order_kind(int index);
+  const char *get_order_eta(int index);
+  int list_orders_where(int all_of, int any_of, int none_of, int *out_ids, int max_ids);
+  double get_order_quantile(int metric, int kind, double q);
+  double get_window_quantile(int metric, int kind, double q, int minutes);
+}
+
+// CLOCK_REALTIME as the library sees it; every other clock is the real one
+static std::atomic<int64_t> fake_ms{0};
+
+extern "C" int clock_gettime(clockid_t clock, timespec *ts)
+{
+  if (clock != CLOCK_REALTIME)
+    return static_cast<int>(::syscall(SYS_clock_gettime, clock, ts));
+  int64_t ms = fake_ms.load();
+  ts->tv_sec = static_cast<time_t>(ms / 1000);
+  ts->tv_nsec = static_cast<long>(ms % 1000 * 1000000);
+  return 0;
+}
+
+constexpr int64_t MINUTE_MS = 60000;
+constexpr int64_t BASE_MINUTE = 1700000000000 / MINUTE_MS;
+constexpr int METRICS = 3;
+constexpr int ALL = 3; // Values index for every kind together
+
+static void set_minute(int64_t minute) { fake_ms = (BASE_MINUTE + minute) * MINUTE_MS + 30000; }
+
+// Orders with ids from 1000000 on weigh 1000-2000 kg; the others 0-100 kg
+// if below 100000, else 0-3000 kg. Distances are 0-4000 km, every eighth
+// order is urgent, so every kind occurs.
+static double weight_of(int id)
+{
+  uint32_t h = static_cast<uint32_t>(id) * 2654435761u >> 8;
+  if (id >= 1000000)
+    return 1000.0 + h % 1000000 / 1000.0;
+  return id < 100000 ? h % 1000000 / 10000.0 : h % 3000000 / 1000.0;
+}
+static double distance_of(int id)
+{
+  return (static_cast<uint32_t>(id) ^ 0x5bd1e995u) * 2246822519u % 4000000 / 1000.0;
+}
+static bool urgent_of(int id) { return (static_cast<uint32_t>(id) * 2654435761u & 7) == 0; }
+
+static void add(int first_id, int n)
+{
+  std::vector<int> ids(1000);
+  std::vector<double> weights(1000), distances(1000);
+  std::vector<char> urgent(1000);
+  for (int at = 0; at < n; at += 1000)
+  {
+    int m = std::min(1000, n - at);
+    for (int i = 0; i < m; ++i)
+    {
+      ids[i] = first_id + at + i;
+      weights[i] = weight_of(ids[i]);
+      distances[i] = distance_of(ids[i]);
+      urgent[i] = urgent_of(ids[i]);
+    }
+    add_orders_batch(ids.data(), weights.data(), distances.data(), reinterpret_cast<const bool *>(urgent.data()), m);
+  }
+}
+
+// Sorted values per metric and kind of the orders at book indexes [first, end)
+struct Values
+{
+  std::vector<double> of[METRICS][4];
+
+  Values(int first, int end)
+  {
+    std::vector<int> ids(static_cast<size_t>(end));
+    list_orders_where(0, 0, 0, ids.data(), end);
+    for (int i = first; i < end; ++i)
+    {
+      int kind = get_order_kind(i), days = 0;
+      const char *eta = get_order_eta(i);
+      if (kind < 0 || !eta || sscanf(eta, "%*[^:]: %d", &days) != 1)
+        continue;
+      double v[METRICS] = {static_cast<double>(days), weight_of(ids[i]), distance_of(ids[i])};
+      for (int m = 0; m < METRICS; ++m)
+      {
+        of[m][kind].push_back(v[m]);
+        of[m][ALL].push_back(v[m]);
+      }
+    }
+    for (auto &metric : of)
+      for (auto &values : metric)
+        std::sort(values.begin(), values.end());
+  }
+
+  // How far q lies outside the rank range of `value`, which must be NaN
+  // where there are no values; stored values are rounded to the gram and
+  // 10 m, hence the slack
+  double rank_error(int metric, int kind, double q, double value) const
+  {
+    const std::vector<double> &v = of[metric][kind < 0 ? ALL : kind];
+    if (v.empty() || value != value)
+      return v.empty() && value != value ? 0.0 : 1.0;
+    double n = static_cast<double>(v.size());
+    double lo = static_cast<double>(std::lower_bound(v.begin(), v.end(), value - 0.011) - v.begin()) / n;
+    double hi = static_cast<double>(std::upper_bound(v.begin(), v.end(), value + 0.011) - v.begin()) / n;
+    return q < lo ? lo - q : (q > hi ? q - hi : 0.0);
+  }
+};
+
+int main()
+{
+  int failures = 0;
+  auto check = [&](bool ok, const std::string &what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what.c_str());
+      ++failures;
+    }
+  };
+  const double qs[] = {0.0, 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99, 1.0};
+  auto name = [](int metric, int kind, double q)
+  {
+    return "metric " + std::to_string(metric) + " kind " + std::to_string(kind) + " q " + std::to_string(q);
+  };
+
+  reset_system();
+  check(std::isnan(get_order_quantile(1, -1, 0.5)), "no orders: NaN");
+  check(std::isnan(get_order_quantile(3, -1, 0.5)) && std::isnan(get_order_quantile(0, 3, 0.5)),
+        "bad metric or kind: NaN");
+
+  // History over 600k orders from four serving threads, one shard each
+  set_minute(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([t]
+    {
+      for (int id = 100000 + t * 150000; id < 100000 + (t + 1) * 150000; ++id)
+        submit_order(t, id, weight_of(id), distance_of(id), urgent_of(id));
+    });
+  for (std::thread &t : threads)
+    t.join();
+  Values history(0, get_order_count());
+  for (int m = 0; m < METRICS; ++m)
+    for (int kind = -1; kind < 3; ++kind)
+      for (double q : qs)
+      {
+        double v = get_order_quantile(m, kind, q);
+        check(history.rank_error(m, kind, q, v) <= 0.02, "history " + name(m, kind, q) + " = " + std::to_string(v));
+      }
+
+  // Light orders in minute 5, then 1000-2000 kg ones in minute 6
+  set_minute(5);
+  int light = get_order_count();
+  add(1, 30000);
+  set_minute(6);
+  int heavy = get_order_count();
+  add(1000000, 30000);
+  int end = get_order_count();
+  Values last_minute(heavy, end), last_two(light, end);
+  for (int m = 0; m < METRICS; ++m)
+    for (int kind = -1; kind < 3; ++kind)
+      for (double q : qs)
+      {
+        double one = get_window_quantile(m, kind, q, 1), two = get_window_quantile(m, kind, q, 2);
+        double three = get_window_quantile(m, kind, q, 3);
+        check(last_minute.rank_error(m, kind, q, one) <= 0.05, "last minute " + name(m, kind, q));
+        check(last_two.rank_error(m, kind, q, two) <= 0.05, "last two minutes " + name(m, kind, q));
+        check(two == three, "an empty minute changes nothing, " + name(m, kind, q));
+      }
+  check(get_window_quantile(1, -1, 0.0, 1) >= 1000.0, "last minute holds only the heavy orders");
+  check(get_window_quantile(1, -1, 1.0, 2) >= 1000.0 && get_window_quantile(1, -1, 0.0, 2) < 100.0,
+        "last two minutes hold both");
+
+  // Two hours on, those windows are gone but the history keeps them
+  set_minute(126);
+  check(std::isnan(get_window_quantile(1, -1, 0.5, 120)), "windows older than two hours: NaN");
+  check(get_order_quantile(1, -1, 0.0) < 100.0 && get_order_quantile(1, -1, 1.0) >= 1000.0,
+        "history keeps every order");
+
+  reset_system();
+  check(std::isnan(get_order_quantile(1, -1, 0.5)), "reset_system clears the history");
+  if (failures)
+    return 1;
+  printf("order quantiles: ok\n");
+  return 0;
+}
@@ -0,0 +1,234 @@
+// One-minute tumbling windows and sliding windows over them must match the
+// orders that arrived in each minute: per-kind counts, average distance and
+// average ETA, with orders added in batches, one at a time and through
+// submit_order from threads that have exited by the time of the query. A
+// window's slot is recycled when its minute comes round again two hours
+// later; late orders for a recycled window are dropped and leave the newer
+// one alone. The wall clock the library reads is faked here.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/order_windows.cpp -o order_windows ./logistics.so -pthread
+// Exits non-zero on failure.
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct OrderWindow
+{
+  int64_t start_ms;
+  int64_t orders[3];
+  double avg_distance_km[3];
+  double avg_eta_days[3];
+};
+
+extern "C"
+{
+  void reset_system();
+  void add_order(int id, double weight, double distance, bool urgent);
+  void add_orders_batch(const int *ids, const double *weights, const double *distances, const bool *urgent, int n);
+  int submit_order(int64_t client, int id, double weight, double distance, bool urgent);
+  int get_order_count();
+  int get_order_kind(int index);
+  const char *get_order_eta(int index);
+  int list_orders_where(int all_of, int any_of, int none_of, int *out_ids, int max_ids);
+  int get_order_windows(int n, OrderWindow *out);
+  void get_sliding_window(int minutes, OrderWindow *out);
+}
+
+// CLOCK_REALTIME as the library sees it; every other clock is the real one
+static std::atomic<int64_t> fake_ms{0};
+
+extern "C" int clock_gettime(clockid_t clock, timespec *ts)
+{
+  if (clock != CLOCK_REALTIME)
+    return static_cast<int>(::syscall(SYS_clock_gettime, clock, ts));
+  int64_t ms = fake_ms.load();
+  ts->tv_sec = static_cast<time_t>(ms / 1000);
+  ts->tv_nsec = static_cast<long>(ms % 1000 * 1000000);
+  return 0;
+}
+
+constexpr int64_t MINUTE_MS = 60000;
+constexpr int64_t BASE_MINUTE = 1700000000000 / MINUTE_MS;
+constexpr int WINDOW_COUNT = 120;
+
+// Whole-kilometer distances and weights that reach every kind
+static double distance_of(int id) { return 40.0 + id * 37 % 2900; }
+static double weight_of(int id) { return id % 5 == 0 ? 1500.0 : (id % 3 == 0 ? 10.0 : 250.0); }
+static bool urgent_of(int id) { return id % 4 == 0; }
+
+static void set_minute(int64_t minute) { fake_ms = (BASE_MINUTE + minute) * MINUTE_MS + 30000; }
+
+// Orders, distances and ETA days per kind that one or more minutes hold
+struct Totals
+{
+  int64_t orders[3] = {};
+  double distance[3] = {};
+  double eta[3] = {};
+
+  Totals &operator+=(const Totals &other)
+  {
+    for (int k = 0; k < 3; ++k)
+    {
+      orders[k] += other.orders[k];
+      distance[k] += other.distance[k];
+      eta[k] += other.eta[k];
+    }
+    return *this;
+  }
+};
+
+static void add_batch(int first_id, int n)
+{
+  std::vector<int> ids(n);
+  std::vector<double> weights(n), distances(n);
+  std::vector<char> urgent(n);
+  for (int i = 0; i < n; ++i)
+  {
+    ids[i] = first_id + i;
+    weights[i] = weight_of(ids[i]);
+    distances[i] = distance_of(ids[i]);
+    urgent[i] = urgent_of(ids[i]);
+  }
+  add_orders_batch(ids.data(), weights.data(), distances.data(), reinterpret_cast<const bool *>(urgent.data()), n);
+}
+
+static void add_one(int id) { add_order(id, weight_of(id), distance_of(id), urgent_of(id)); }
+
+int main()
+{
+  int failures = 0;
+  auto check = [&](bool ok, const std::string &what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what.c_str());
+      ++failures;
+    }
+  };
+
+  std::map<int64_t, Totals> expected; // by minute
+  int counted = 0;                     // orders of the book already in `expected`
+
+  // Credits the orders added since the last call to `minute`, reading ids,
+  // kinds and ETAs back from the book in arrival order
+  auto account = [&](int64_t minute)
+  {
+    int n = get_order_count();
+    std::vector<int> ids(static_cast<size_t>(n));
+    list_orders_where(0, 0, 0, ids.data(), n);
+    Totals &t = expected[minute];
+    for (int i = counted; i < n; ++i)
+    {
+      int k = get_order_kind(i), days = 0;
+      const char *eta = get_order_eta(i);
+      if (k < 0 || !eta || sscanf(eta, "%*[^:]: %d", &days) != 1)
+      {
+        check(false, "kind and ETA of order " + std::to_string(i));
+        continue;
+      }
+      ++t.orders[k];
+      t.distance[k] += distance_of(ids[i]);
+      t.eta[k] += days;
+    }
+    counted = n;
+  };
+
+  // Compares a window with the totals of the minutes it covers
+  auto same = [&](const OrderWindow &w, int64_t first, int64_t last, const std::string &what)
+  {
+    Totals t;
+    for (int64_t m = first; m <= last; ++m)
+      if (expected.count(m))
+        t += expected[m];
+    check(w.start_ms == (BASE_MINUTE + first) * MINUTE_MS, what + " start");
+    for (int k = 0; k < 3; ++k)
+    {
+      std::string kind = what + " kind " + std::to_string(k);
+      check(w.orders[k] == t.orders[k], kind + " orders");
+      double distance = t.orders[k] ? t.distance[k] / t.orders[k] : 0.0;
+      double eta = t.orders[k] ? t.eta[k] / t.orders[k] : 0.0;
+      check(std::fabs(w.avg_distance_km[k] - distance) < 1e-9 * (1 + distance), kind + " average distance");
+      check(std::fabs(w.avg_eta_days[k] - eta) < 1e-9 * (1 + eta), kind + " average ETA");
+    }
+  };
+
+  auto verify = [&](int64_t now, const char *phase)
+  {
+    OrderWindow windows[WINDOW_COUNT + 10];
+    int n = get_order_windows(WINDOW_COUNT + 10, windows);
+    check(n == WINDOW_COUNT, std::string(phase) + ": two hours of windows");
+    for (int i = 0; i < n; ++i)
+      same(windows[i], now - i, now - i, std::string(phase) + ": window " + std::to_string(now - i));
+    for (int minutes : {1, 2, 4, 60, WINDOW_COUNT})
+    {
+      OrderWindow w;
+      get_sliding_window(minutes, &w);
+      same(w, now - minutes + 1, now, std::string(phase) + ": last " + std::to_string(minutes) + " minutes");
+    }
+  };
+
+  // Minute 0 in batches, minute 1 from serving threads that are gone before
+  // the query, minute 3 both ways; minute 2 stays empty
+  reset_system();
+  set_minute(0);
+  add_batch(1, 3000);
+  add_batch(3001, 7);
+  account(0);
+  set_minute(1);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([t]
+    {
+      for (int i = 0; i < 500; ++i)
+      {
+        int id = 10000 + t * 1000 + i;
+        submit_order(t, id, weight_of(id), distance_of(id), urgent_of(id));
+      }
+    });
+  for (std::thread &t : threads)
+    t.join();
+  account(1);
+  set_minute(3);
+  add_batch(20000, 700);
+  for (int i = 0; i < 50; ++i)
+    add_one(21000 + i);
+  account(3);
+  verify(3, "first minutes");
+
+  // Two hours on, minute 120 takes over minute 0's slot
+  set_minute(WINDOW_COUNT);
+  add_batch(30000, 900);
+  account(WINDOW_COUNT);
+  verify(WINDOW_COUNT, "recycled");
+
+  // Late orders: minute 0's slot now holds minute 120, so they are dropped;
+  // minute 3's slot still holds minute 3, so they count there
+  set_minute(0);
+  add_batch(40000, 40);
+  counted = get_order_count();
+  set_minute(3);
+  add_batch(41000, 30);
+  add_one(41500);
+  account(3);
+  set_minute(WINDOW_COUNT);
+  verify(WINDOW_COUNT, "late orders");
+
+  reset_system();
+  OrderWindow w;
+  get_sliding_window(WINDOW_COUNT, &w);
+  check(w.orders[0] == 0 && w.orders[1] == 0 && w.orders[2] == 0, "reset_system clears the windows");
+  if (failures)
+    return 1;
+  printf("order windows: ok\n");
+  return 0;
+}
@@ -0,0 +1,125 @@
+// Log lines of packed records against the original transport classes: info
+// and ETA must match the baseline factory for every route within +-1023
+// minutes, negative distances included, on the scalar and the batch path.
+// The reference below is the baseline rules and texts, kept independent of
+// the library.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/packed_text.cpp -o packed_text ./logistics.so
+// Exits non-zero on failure.
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+  void reset_system();
+  void add_order(int id, double weight, double distance, bool urgent);
+  void add_orders_batch(const int *ids, const double *weights, const double *distances, const bool *urgent, int n);
+  const char *get_orders_log();
+}
+
+struct Order
+{
+  int id;
+  double weight;
+  double distance;
+  bool urgent;
+};
+
+static std::string baseline_line(const Order &o)
+{
+  std::string info, eta;
+  if (o.urgent && o.weight < 20.0 && o.distance > 500.0)
+  {
+    info = "Air (Express: Yes)";
+    eta = "Air: 1 day (Express)";
+  }
+  else if (o.distance > 2000.0 || o.weight > 1000.0)
+  {
+    info = "Ship (Reserved: Yes)";
+    eta = "Ship: 12 days";
+  }
+  else
+  {
+    double minutes = 30.0 + o.distance / 50.0;
+    if (o.urgent)
+      minutes *= 0.8;
+    int days = 1 + static_cast<int>(minutes / 60) + (o.weight > 200.0 ? 1 : 0);
+    info = "Truck (Route: " + std::to_string(static_cast<int>(minutes)) + "m)";
+    eta = "Truck: " + std::to_string(days) + " days";
+  }
+  return "[Order #" + std::to_string(o.id) + "] " + info + " -> ETA: " + eta;
+}
+
+static std::vector<std::string> lines(const char *log)
+{
+  std::vector<std::string> out;
+  for (const char *p = log; *p;)
+  {
+    const char *end = strchr(p, '\n');
+    out.emplace_back(p, end ? static_cast<size_t>(end - p) : strlen(p));
+    p = end ? end + 1 : p + strlen(p);
+  }
+  return out;
+}
+
+int main()
+{
+  std::vector<Order> orders;
+  const double weights[] = {0.5, 19.999, 20.0, 20.001, 150.0, 199.999, 200.0, 200.001, 999.999, 1000.0, 1000.5};
+  const double distances[] = {-52000.0, -7543.0, -3000.0, -1500.0, -150.0, -3.0, -1e-9, 0.0, 1.0,
+                              499.99,   500.0,   500.01,  1999.99, 2000.0, 2000.01};
+  int id = 1;
+  for (double w : weights)
+    for (double d : distances)
+      for (bool u : {false, true})
+        orders.push_back({id++, w, d, u});
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> weight(0.0, 1200.0), distance(-52000.0, 2500.0);
+  for (int i = 0; i < 20000; ++i)
+    orders.push_back({id++, weight(rng), distance(rng), (rng() & 1) != 0});
+
+  int failures = 0;
+  for (int batch = 0; batch < 2; ++batch)
+  {
+    reset_system();
+    if (batch)
+    {
+      std::vector<int> ids;
+      std::vector<double> ws, ds;
+      std::vector<char> us;
+      for (const Order &o : orders)
+      {
+        ids.push_back(o.id);
+        ws.push_back(o.weight);
+        ds.push_back(o.distance);
+        us.push_back(o.urgent);
+      }
+      add_orders_batch(ids.data(), ws.data(), ds.data(), reinterpret_cast<const bool *>(us.data()),
+                       static_cast<int>(ids.size()));
+    }
+    else
+      for (const Order &o : orders)
+        add_order(o.id, o.weight, o.distance, o.urgent);
+    std::vector<std::string> got = lines(get_orders_log());
+    if (got.size() != orders.size())
+    {
+      fprintf(stderr, "FAIL %s path: %zu lines for %zu orders\n", batch ? "batch" : "scalar", got.size(),
+              orders.size());
+      ++failures;
+      continue;
+    }
+    for (size_t i = 0; i < orders.size(); ++i)
+      if (got[i] != baseline_line(orders[i]) && ++failures <= 5)
+        fprintf(stderr, "FAIL %s path: got '%s', baseline '%s'\n", batch ? "batch" : "scalar", got[i].c_str(),
+                baseline_line(orders[i]).c_str());
+  }
+  reset_system();
+  if (failures)
+    return 1;
+  printf("packed text: %zu orders match the baseline\n", orders.size());
+  return 0;
+}
@@ -0,0 +1,208 @@
+// Weight and distance range queries must match a scan of the live orders:
+// counts, lists ordered by value then arrival, and ranges combined with
+// filters, on a book built from bulk loads and single inserts, after count
+// retention expires and purges index entries, and after the store
+// renumbers its segments. The wall clock the library reads is faked here,
+// so 65536 one-millisecond segments take no real time.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/range_index.cpp -o range_index ./logistics.so -pthread
+// Exits non-zero on failure.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+extern "C"
+{
+  void reset_system();
+  void set_retention(int64_t max_orders, double max_hours);
+  void add_order(int id, double weight, double distance, bool urgent);
+  void add_orders_batch(const int *ids, const double *weights, const double *distances, const bool *urgent, int n);
+  int get_order_count();
+  int get_order_kind(int index);
+  int count_orders_by_weight(double min_kg, double max_kg);
+  int count_orders_by_distance(double min_km, double max_km);
+  int list_orders_by_weight(double min_kg, double max_kg, int *out_ids, int max_ids);
+  int list_orders_by_distance(double min_km, double max_km, int *out_ids, int max_ids);
+  int count_orders_matching(int all_of, int any_of, int none_of, double min_kg, double max_kg, double min_km,
+                            double max_km);
+}
+
+// CLOCK_REALTIME as the library sees it; every other clock is the real one
+static int64_t fake_ms = 1700000000000;
+
+extern "C" int clock_gettime(clockid_t clock, timespec *ts)
+{
+  if (clock != CLOCK_REALTIME)
+    return static_cast<int>(::syscall(SYS_clock_gettime, clock, ts));
+  ts->tv_sec = static_cast<time_t>(fake_ms / 1000);
+  ts->tv_nsec = static_cast<long>(fake_ms % 1000 * 1000000);
+  return 0;
+}
+
+constexpr int SEGMENT_ROWS = 65536;
+constexpr int TRUCK = 1, SHIP = 2, AIR = 4, URGENT = 8;
+constexpr double INF = INFINITY;
+
+struct Order
+{
+  int id;
+  double weight;
+  double distance;
+  bool urgent;
+};
+
+// Every order ever added, oldest first; the book holds the newest of them
+static std::vector<Order> added;
+
+// Weights in quarter kilograms up to 2 t and distances in half kilometers up
+// to 3000 km, so every value sits exactly on the index grid; many repeat
+static Order spread(int id)
+{
+  uint32_t h = static_cast<uint32_t>(id) * 2654435761u;
+  return {id, (h >> 4) % 8000 * 0.25, (h >> 13) % 6000 * 0.5, (h >> 27 & 3) == 0};
+}
+
+static void add_all(int first_id, int n)
+{
+  std::vector<int> ids;
+  std::vector<double> weights, distances;
+  std::vector<char> urgent;
+  for (int i = 0; i < n; ++i)
+  {
+    Order o = spread(first_id + i);
+    ids.push_back(o.id);
+    weights.push_back(o.weight);
+    distances.push_back(o.distance);
+    urgent.push_back(o.urgent);
+    added.push_back(o);
+  }
+  add_orders_batch(ids.data(), weights.data(), distances.data(), reinterpret_cast<const bool *>(urgent.data()), n);
+}
+
+static void add_one(int id)
+{
+  Order o = spread(id);
+  added.push_back(o);
+  add_order(o.id, o.weight, o.distance, o.urgent);
+}
+
+int main()
+{
+  int failures = 0;
+  auto check = [&](bool ok, const std::string &what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what.c_str());
+      ++failures;
+    }
+  };
+
+  // Open, closed, single-point, empty and NaN bounds
+  const double ranges[][2] = {{-INF, INF}, {0.0, 0.0},     {100.0, 250.5}, {199.75, 200.25}, {1000.0, INF},
+                              {-INF, 19.99}, {300.0, 299.0}, {NAN, 10.0},    {1999.75, 1999.75}};
+  const int masks[][3] = {{0, 0, 0}, {SHIP, 0, 0}, {URGENT, TRUCK | AIR, 0}, {0, 0, SHIP}};
+
+  // Compares every range, alone and under each mask, with a scan of the live orders
+  auto verify = [&](const char *phase)
+  {
+    int n = get_order_count();
+    check(n >= 0 && static_cast<size_t>(n) <= added.size(), std::string(phase) + ": order count");
+    std::vector<Order> live(added.end() - n, added.end());
+    std::vector<int> flags(live.size());
+    for (int i = 0; i < n; ++i)
+      flags[i] = (1 << get_order_kind(i)) | (live[i].urgent ? URGENT : 0);
+
+    for (int metric = 0; metric < 2; ++metric)
+    {
+      double scale = metric ? 100.0 : 1000.0;
+      auto value = [&](const Order &o) { return metric ? o.distance : o.weight; };
+      for (const auto &r : ranges)
+      {
+        double lo = std::floor(r[0] * scale), hi = std::floor(r[1] * scale);
+        std::vector<Order> hits;
+        for (const Order &o : live)
+          if (value(o) * scale >= lo && value(o) * scale <= hi)
+            hits.push_back(o);
+        std::stable_sort(hits.begin(), hits.end(), [&](const Order &a, const Order &b) { return value(a) < value(b); });
+        std::vector<int> want;
+        for (const Order &o : hits)
+          want.push_back(o.id);
+
+        std::string what = std::string(phase) + (metric ? ": distance [" : ": weight [") + std::to_string(r[0]) +
+                           ", " + std::to_string(r[1]) + "]";
+        int count = metric ? count_orders_by_distance(r[0], r[1]) : count_orders_by_weight(r[0], r[1]);
+        check(count == static_cast<int>(want.size()), what + " count");
+        std::vector<int> got(want.size() + 1, -1);
+        int total = metric ? list_orders_by_distance(r[0], r[1], got.data(), static_cast<int>(got.size()))
+                           : list_orders_by_weight(r[0], r[1], got.data(), static_cast<int>(got.size()));
+        got.resize(want.size());
+        check(total == static_cast<int>(want.size()) && got == want, what + " list");
+
+        for (const auto &m : masks)
+        {
+          int matching = 0;
+          for (int i = 0; i < n; ++i)
+            matching += (flags[i] & m[0]) == m[0] && (!m[1] || flags[i] & m[1]) && !(flags[i] & m[2]) &&
+                        value(live[i]) * scale >= lo && value(live[i]) * scale <= hi;
+          int got_matching = metric ? count_orders_matching(m[0], m[1], m[2], -INF, INF, r[0], r[1])
+                                    : count_orders_matching(m[0], m[1], m[2], r[0], r[1], -INF, INF);
+          check(got_matching == matching, what + " with filter " + std::to_string(m[0]) + "/" +
+                                              std::to_string(m[1]) + "/" + std::to_string(m[2]));
+        }
+      }
+    }
+  };
+
+  // Bulk loads of several sizes with single inserts between them
+  reset_system();
+  int next_id = 1;
+  for (int n : {100000, 3, 50000, 1500, 20000})
+  {
+    add_all(next_id, n);
+    next_id += n;
+    for (int i = 0; i < 700; ++i)
+      add_one(next_id++);
+  }
+  verify("fresh");
+
+  // Count retention expires index entries a segment at a time and purges
+  // them once they outnumber the live ones
+  set_retention(30000, 0);
+  for (int round = 0; round < 3; ++round)
+  {
+    add_all(next_id, 40000);
+    next_id += 40000;
+    verify(("after retention round " + std::to_string(round)).c_str());
+  }
+
+  // One-millisecond segments under a 16 ms age limit: segment 65536 runs
+  // out of 16-bit numbers and the store renumbers the live ones from 0.
+  // Rows from before and after that stay live together for 16 ms.
+  set_retention(0, 16.0 / 3600000.0);
+  reset_system();
+  for (int i = 0; i < SEGMENT_ROWS + 20; ++i)
+  {
+    ++fake_ms;
+    add_one(next_id++);
+    if (i >= SEGMENT_ROWS - 4)
+      verify(("around renumbering, segment " + std::to_string(i)).c_str());
+  }
+  set_retention(0, 0);
+  add_all(next_id, 150000);
+  verify("filled after renumbering");
+
+  reset_system();
+  if (failures)
+    return 1;
+  printf("range index: ok\n");
+  return 0;
+}
@@ -0,0 +1,121 @@
+// Orders submitted through the serving layers while count retention drops
+// the segment they landed in: every caller must still get the decision for
+// its own order. Covers the daemon's pipelined runs, micro-batched groups
+// and submit_order across a segment boundary.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/service_retention.cpp -o service_retention ./logistics.so -pthread
+// Usage: service_retention [TMP_DIR]
+// Exits non-zero on failure.
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+extern "C"
+{
+  void reset_system();
+  void set_retention(int64_t max_orders, double max_hours);
+  void set_micro_batch(int64_t window_us, int max_orders);
+  void add_order(int id, double weight, double distance, bool urgent);
+  void add_orders_batch(const int *ids, const double *weights, const double *distances, const bool *urgent, int n);
+  int get_order_count();
+  int get_order_kind(int index);
+  int submit_order(int64_t client, int id, double weight, double distance, bool urgent);
+  int run_order_daemon(const char *socket_path);
+  void stop_order_daemon();
+  int connect_order_daemon(const char *socket_path);
+  int64_t daemon_add_orders(const int *ids, const double *weights, const double *distances, const bool *urgent,
+                            int64_t n, int *out_kinds);
+}
+
+constexpr int SEGMENT_ROWS = 65536;
+constexpr int ORDERS = 400;
+
+// A spread of trucks, ships and planes
+static double weight_of(int i) { return i % 3 == 0 ? 5.0 : (i % 3 == 1 ? 600.0 : 150.0); }
+static double distance_of(int i) { return i % 4 == 0 ? 2500.0 : 40.0 + i * 7 % 1800; }
+static bool urgent_of(int i) { return i % 5 == 0; }
+
+int main(int argc, char **argv)
+{
+  std::string socket = std::string(argc > 1 ? argv[1] : "/tmp") + "/service_retention-" +
+                       std::to_string(::getpid()) + ".sock";
+  int failures = 0;
+  auto check = [&](bool ok, const char *what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what);
+      ++failures;
+    }
+  };
+
+  // The decisions a plain book makes for the same orders
+  std::vector<int> ids(ORDERS), expected(ORDERS);
+  std::vector<double> weights(ORDERS), distances(ORDERS);
+  std::vector<char> urgent(ORDERS);
+  reset_system();
+  for (int i = 0; i < ORDERS; ++i)
+  {
+    ids[i] = 1000 + i;
+    weights[i] = weight_of(i);
+    distances[i] = distance_of(i);
+    urgent[i] = urgent_of(i);
+    add_order(ids[i], weights[i], distances[i], urgent[i]);
+    expected[i] = get_order_kind(i);
+  }
+
+  // Fill the first segment to a few rows short of full, then keep 5 orders:
+  // each run below crosses into the next segment and drops the one before
+  auto fill = [&]
+  {
+    reset_system();
+    std::vector<int> fill_ids(SEGMENT_ROWS - 6, 7);
+    std::vector<double> fill_weights(fill_ids.size(), 1.0), fill_distances(fill_ids.size(), 10.0);
+    std::vector<char> fill_urgent(fill_ids.size(), 0);
+    add_orders_batch(fill_ids.data(), fill_weights.data(), fill_distances.data(),
+                     reinterpret_cast<const bool *>(fill_urgent.data()), static_cast<int>(fill_ids.size()));
+    set_retention(5, 0);
+  };
+
+  fill();
+  for (int i = 0; i < ORDERS; ++i)
+    check(submit_order(1, ids[i], weights[i], distances[i], urgent[i]) == expected[i], "submit_order kind");
+  check(get_order_count() <= SEGMENT_ROWS + 4, "retention after submit_order");
+
+  std::thread daemon([&] { run_order_daemon(socket.c_str()); });
+  bool connected = false;
+  for (int attempt = 0; attempt < 500 && !connected; ++attempt)
+  {
+    connected = connect_order_daemon(socket.c_str()) == 0;
+    if (!connected)
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  check(connected, "connect_order_daemon");
+
+  for (int batched = 0; connected && batched < 2; ++batched)
+  {
+    fill();
+    set_micro_batch(batched ? 500 : 0, 64);
+    std::vector<int> kinds(ORDERS, -9);
+    for (int i = 0; i < ORDERS; i += 20)
+      check(daemon_add_orders(&ids[i], &weights[i], &distances[i], reinterpret_cast<const bool *>(&urgent[i]), 20,
+                              &kinds[i]) > 0,
+            "daemon_add_orders");
+    check(kinds == expected, batched ? "micro-batched daemon kinds" : "daemon kinds");
+  }
+  set_micro_batch(0, 1);
+
+  stop_order_daemon();
+  daemon.join();
+  set_retention(0, 0);
+  reset_system();
+  if (failures)
+    return 1;
+  printf("service retention: ok\n");
+  return 0;
+}
@@ -0,0 +1,221 @@
+// The shared-memory store with two publishing processes: retention and
+// reset_system() in one must leave the other's rows and the epoch alone,
+// clear_shared_orders() clears for both, and a publisher killed mid-append
+// neither pins the ring nor leaves the totals inconsistent.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/shared_store.cpp -o shared_store ./logistics.so -pthread
+// Exits non-zero on failure.
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct OrderWindow
+{
+  int64_t start_ms;
+  int64_t orders[3];
+  double avg_distance_km[3];
+  double avg_eta_days[3];
+};
+
+extern "C"
+{
+  void reset_system();
+  void set_retention(int64_t max_orders, double max_hours);
+  void add_orders_batch(const int *ids, const double *weights, const double *distances, const bool *urgent, int n);
+  int share_orders(const char *name, int64_t capacity);
+  int clear_shared_orders();
+  int get_share_status(int64_t *unshared);
+  int attach_shared_orders(const char *name);
+  int unlink_shared_orders(const char *name);
+  int64_t get_shared_order_count();
+  int64_t get_shared_first_order();
+  int64_t get_shared_epoch();
+  int64_t read_shared_orders(int64_t first, int64_t count, int *ids, int *kinds, int *eta_days);
+  void get_shared_totals(OrderWindow *out);
+}
+
+constexpr int SEGMENT_ROWS = 65536;
+constexpr int64_t CAPACITY = 200000;
+const char *const NAME = "shared_store_test";
+
+static void add(int first_id, int n)
+{
+  std::vector<int> ids(n);
+  std::vector<double> weights(n), distances(n);
+  std::vector<char> urgent(n);
+  for (int i = 0; i < n; ++i)
+  {
+    ids[i] = first_id + i;
+    weights[i] = (first_id + i) * 37 % 1500;
+    distances[i] = (first_id + i) * 53 % 3000;
+    urgent[i] = i % 3 == 0;
+  }
+  add_orders_batch(ids.data(), weights.data(), distances.data(), reinterpret_cast<const bool *>(urgent.data()), n);
+}
+
+// Live rows of the attached store, or an empty list if a read was cut short
+static std::vector<int> live_ids(bool *totals_match)
+{
+  int64_t first = get_shared_first_order(), n = get_shared_order_count() - first;
+  std::vector<int> ids(static_cast<size_t>(n)), kinds(ids.size());
+  if (n && read_shared_orders(first, n, ids.data(), kinds.data(), nullptr) != n)
+    ids.clear();
+  OrderWindow totals;
+  get_shared_totals(&totals);
+  int64_t counted[3] = {};
+  for (int k : kinds)
+    ++counted[k];
+  *totals_match = counted[0] == totals.orders[0] && counted[1] == totals.orders[1] && counted[2] == totals.orders[2];
+  return ids;
+}
+
+// A second publisher, run by fork(); it acts on one command byte at a time
+// and answers each with one byte
+struct Publisher
+{
+  pid_t pid = -1;
+  int to = -1, from = -1;
+
+  void start()
+  {
+    int down[2], up[2];
+    if (::pipe(down) != 0 || ::pipe(up) != 0)
+      return;
+    pid = ::fork();
+    if (pid == 0)
+    {
+      ::close(down[1]);
+      ::close(up[0]);
+      reset_system();
+      bool ok = share_orders(NAME, CAPACITY) == 0;
+      char command;
+      while (::read(down[0], &command, 1) == 1)
+      {
+        if (command == 'a')
+          add(1, 100);
+        else if (command == 'b')
+          add(500000, 5);
+        else if (command == 'r')
+          reset_system();
+        else if (command == 'l')
+          for (int i = 0;; i += 1000)
+            add(600000 + i % 100000, 1000); // until killed
+        int64_t unshared;
+        char reply = ok && get_share_status(&unshared) == 0 ? '+' : '-';
+        if (::write(up[1], &reply, 1) != 1)
+          break;
+      }
+      _exit(0);
+    }
+    ::close(down[0]);
+    ::close(up[1]);
+    to = down[1];
+    from = up[0];
+  }
+
+  bool run(char command)
+  {
+    char reply = 0;
+    return ::write(to, &command, 1) == 1 && ::read(from, &reply, 1) == 1 && reply == '+';
+  }
+
+  void stop(bool kill)
+  {
+    if (kill)
+      ::kill(pid, SIGKILL);
+    ::close(to);
+    ::close(from);
+    ::waitpid(pid, nullptr, 0);
+  }
+};
+
+int main()
+{
+  int failures = 0;
+  auto check = [&](bool ok, const char *what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what);
+      ++failures;
+    }
+  };
+  bool totals_match = false;
+
+  unlink_shared_orders(NAME);
+  reset_system();
+  check(share_orders(NAME, CAPACITY) == 0 && attach_shared_orders(NAME) == 0, "share and attach");
+  Publisher other;
+  other.start();
+
+  // This process fills a segment, the other adds 100 rows after it, then
+  // retention drops that segment here
+  add(100000, SEGMENT_ROWS);
+  check(other.run('a'), "other publisher appends");
+  set_retention(10, 0);
+  add(200000, 10);
+  int64_t first = get_shared_first_order();
+  std::vector<int> ids = live_ids(&totals_match);
+  check(first == SEGMENT_ROWS, "retention here stops at the other publisher's rows");
+  check(ids.size() == 110 && ids[0] == 1 && ids[99] == 100 && ids[100] == 200000, "both publishers' rows stay");
+  check(totals_match, "totals after retention");
+
+  reset_system();
+  ids = live_ids(&totals_match);
+  check(ids.size() == 110 && ids[0] == 1, "reset_system here keeps the other publisher's rows");
+  check(get_shared_epoch() == 0, "reset_system does not bump the epoch");
+
+  check(other.run('r'), "other publisher resets");
+  ids = live_ids(&totals_match);
+  check(ids.empty() && totals_match, "rows leave once both publishers released them");
+
+  // A store-wide clear, after which both publish again
+  add(300000, 5);
+  check(other.run('b'), "other publisher appends again");
+  check(clear_shared_orders() == 0, "clear_shared_orders");
+  check(get_shared_epoch() == 1, "clear bumps the epoch");
+  ids = live_ids(&totals_match);
+  check(ids.empty() && totals_match, "clear retires every publisher's rows");
+  check(other.run('b'), "other publisher appends after the clear");
+  add(400000, 5);
+  ids = live_ids(&totals_match);
+  check(ids.size() == 10 && ids[0] == 500000 && ids[5] == 400000 && totals_match, "both publish after the clear");
+  other.run('r');
+  other.stop(false);
+  reset_system();
+
+  // Publishers killed mid-append, each after filling much of the ring: the
+  // mutex is recovered, the totals rebuilt, and their rows stop pinning it
+  for (int round = 0; round < 4; ++round)
+  {
+    Publisher doomed;
+    doomed.start();
+    char command = 'l';
+    check(::write(doomed.to, &command, 1) == 1, "start the doomed publisher");
+    ::usleep(static_cast<useconds_t>(20000 + 7000 * round));
+    doomed.stop(true);
+    add(700000 + round * 10, 10);
+    int64_t unshared;
+    check(get_share_status(&unshared) == 0, "publish after a publisher was killed");
+  }
+  ids = live_ids(&totals_match);
+  check(!ids.empty() && totals_match, "totals after killed publishers");
+  reset_system();
+  check(get_shared_first_order() == get_shared_order_count(), "killed publishers do not pin the ring");
+  ids = live_ids(&totals_match);
+  check(ids.empty() && totals_match, "totals after the last release");
+
+  set_retention(0, 0);
+  reset_system();
+  unlink_shared_orders(NAME);
+  if (failures)
+    return 1;
+  printf("shared store: ok\n");
+  return 0;
+}
@@ -0,0 +1,77 @@
+// Top-K answers after count retention drops a segment: the live orders that
+// were crowded out of the heaps by the dropped segment must come back.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/top_orders_retention.cpp -o top_orders_retention ./logistics.so
+// Exits non-zero on failure.
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+extern "C"
+{
+  void reset_system();
+  void set_retention(int64_t max_orders, double max_hours);
+  void add_orders_batch(const int *ids, const double *weights, const double *distances, const bool *urgent, int n);
+  int get_order_count();
+  int get_top_orders(int metric, int kind, int k, int *out_ids, double *out_values);
+}
+
+constexpr int SEGMENT_ROWS = 65536;
+
+static void add(int first_id, const std::vector<double> &weights)
+{
+  int n = static_cast<int>(weights.size());
+  std::vector<int> ids(n);
+  std::vector<double> distances(n, 100.0);
+  std::vector<char> urgent(n, 0);
+  for (int i = 0; i < n; ++i)
+    ids[i] = first_id + i;
+  add_orders_batch(ids.data(), weights.data(), distances.data(), reinterpret_cast<const bool *>(urgent.data()), n);
+}
+
+int main()
+{
+  reset_system();
+  set_retention(SEGMENT_ROWS, 0);
+
+  // Segment 0: nothing but 20 kg, filling every heaviest-order heap
+  add(0, std::vector<double>(SEGMENT_ROWS, 20.0));
+  // Segment 1: five 10-14 kg orders among 1 kg ones
+  std::vector<double> second(SEGMENT_ROWS, 1.0);
+  for (int i = 0; i < 5; ++i)
+    second[i * 1000] = 10.0 + i;
+  add(SEGMENT_ROWS, second);
+  // Segment 2: 3 kg orders; the first one pushes segment 0 out
+  add(2 * SEGMENT_ROWS, std::vector<double>(3, 3.0));
+
+  int failures = 0;
+  if (get_order_count() != SEGMENT_ROWS + 3)
+  {
+    fprintf(stderr, "expected %d live orders, got %d\n", SEGMENT_ROWS + 3, get_order_count());
+    ++failures;
+  }
+
+  int ids[10];
+  double kg[10];
+  int n = get_top_orders(0, -1, 10, ids, kg);
+  const double expected[10] = {14, 13, 12, 11, 10, 3, 3, 3, 1, 1};
+  if (n != 10)
+  {
+    fprintf(stderr, "expected 10 heaviest orders, got %d\n", n);
+    ++failures;
+  }
+  for (int i = 0; i < n && i < 10; ++i)
+    if (kg[i] != expected[i])
+    {
+      fprintf(stderr, "heaviest #%d: expected %.0f kg, got %.3f kg (id %d)\n", i, expected[i], kg[i], ids[i]);
+      ++failures;
+    }
+
+  set_retention(0, 0);
+  reset_system();
+  if (failures)
+    return 1;
+  printf("top orders after retention: ok\n");
+  return 0;
+}
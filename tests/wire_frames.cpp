@@ -0,0 +1,327 @@
+// Order frames built here from the documented layout must ingest exactly like
+// the same orders through add_orders_batch_ex: concatenated frames of odd
+// sizes, empty frames and frames at unaligned addresses, from memory, a file
+// and a pipe. The decision frames that come back must carry each order's id,
+// fixed-point weight and distance and its transport flags, byte for byte the
+// same either way, and write_decision_frames must match them across
+// segments. Malformed frames end the input with -1 and keep the frames before
+// them.
+// Links against the library:
+//   g++ -std=c++17 -O2 tests/wire_frames.cpp -o wire_frames ./logistics.so -pthread
+// Usage: wire_frames [TMP_DIR]
+// Exits non-zero on failure.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+extern "C"
+{
+  void reset_system();
+  void add_orders_batch_ex(const int *ids, const double *weights, const double *distances, const bool *urgent,
+                           const uint64_t *customer_ids, const uint64_t *destination_ids, int n);
+  int get_order_count();
+  int get_order_kind(int index);
+  int list_orders_where(int all_of, int any_of, int none_of, int *out_ids, int max_ids);
+  double get_distinct_count(int what, int kind, int days);
+  int64_t add_order_frames(const void *data, int64_t size);
+  int64_t read_order_frames(int fd);
+  const void *get_decision_frames(int64_t first, int64_t count, int64_t *size);
+  int64_t write_decision_frames(int fd, int64_t first, int64_t count);
+}
+
+struct WireHeader
+{
+  char magic[4];
+  uint16_t version;
+  uint16_t type;
+  uint32_t rows;
+  uint32_t flags;
+  uint64_t body_length;
+};
+
+constexpr uint16_t ORDERS = 1, DECISIONS = 2;
+constexpr int SEGMENT_ROWS = 65536;
+// Decision word bits (the PackedOrder meta layout)
+constexpr uint32_t KIND_MASK = 3, URGENT_BIT = 1u << 2, HEAVY_BIT = 1u << 3, RESERVED_BIT = 1u << 4,
+                   EXPRESS_BIT = 1u << 5;
+
+static size_t padded(size_t n) { return (n + 7) / 8 * 8; }
+
+struct Order
+{
+  int id;
+  double weight;
+  double distance;
+  bool urgent;
+  uint64_t customer;
+  uint64_t destination;
+};
+
+// Quarter kilograms and half kilometers, so weights and distances sit exactly
+// on the stored grid; every kind and flag occurs
+static Order order(int id)
+{
+  uint32_t h = static_cast<uint32_t>(id) * 2654435761u;
+  return {id, (h >> 4) % 8000 * 0.25, (h >> 13) % 6000 * 0.5, (h >> 27 & 1) == 0, (h >> 8) % 5000 + 1,
+          (h >> 16) % 700 + 1};
+}
+
+// One order frame in the documented layout
+static std::string order_frame(const std::vector<Order> &orders)
+{
+  size_t n = orders.size();
+  WireHeader h{{'T', 'O', 'S', 'W'}, 1, ORDERS, static_cast<uint32_t>(n), 0, 32 * n + padded(4 * n) + padded(n)};
+  std::string out(sizeof h + h.body_length, '\0');
+  memcpy(&out[0], &h, sizeof h);
+  char *p = &out[sizeof h];
+  for (size_t i = 0; i < n; ++i)
+  {
+    memcpy(p + 8 * i, &orders[i].weight, 8);
+    memcpy(p + 8 * (n + i), &orders[i].distance, 8);
+    memcpy(p + 8 * (2 * n + i), &orders[i].customer, 8);
+    memcpy(p + 8 * (3 * n + i), &orders[i].destination, 8);
+    memcpy(p + 32 * n + 4 * i, &orders[i].id, 4);
+    p[32 * n + padded(4 * n) + i] = orders[i].urgent;
+  }
+  return out;
+}
+
+struct Decision
+{
+  int32_t id;
+  int32_t weight_g;
+  int32_t distance_dam;
+  uint32_t meta;
+};
+
+// Decisions of a stream of plain decision frames; false if it does not parse
+static bool parse_decisions(const std::string &data, std::vector<Decision> &out, size_t *frames = nullptr)
+{
+  size_t at = 0;
+  while (at < data.size())
+  {
+    WireHeader h;
+    if (data.size() - at < sizeof h)
+      return false;
+    memcpy(&h, &data[at], sizeof h);
+    size_t n = h.rows, column = padded(4 * n);
+    if (memcmp(h.magic, "TOSW", 4) != 0 || h.version != 1 || h.type != DECISIONS || h.flags != 0 ||
+        h.body_length != 4 * column || data.size() - at - sizeof h < h.body_length)
+      return false;
+    const char *body = &data[at + sizeof h];
+    for (size_t i = 0; i < n; ++i)
+    {
+      Decision d;
+      memcpy(&d.id, body + 4 * i, 4);
+      memcpy(&d.weight_g, body + column + 4 * i, 4);
+      memcpy(&d.distance_dam, body + 2 * column + 4 * i, 4);
+      memcpy(&d.meta, body + 3 * column + 4 * i, 4);
+      out.push_back(d);
+    }
+    at += sizeof h + h.body_length;
+    if (frames)
+      ++*frames;
+  }
+  return true;
+}
+
+static std::string decisions(int64_t first, int64_t count)
+{
+  int64_t size = 0;
+  const void *data = get_decision_frames(first, count, &size);
+  return std::string(static_cast<const char *>(data), static_cast<size_t>(size));
+}
+
+static std::string read_file(const std::string &path)
+{
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string &path, const std::string &data)
+{
+  std::ofstream(path, std::ios::binary | std::ios::trunc).write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+int main(int argc, char **argv)
+{
+  std::string dir = argc > 1 ? argv[1] : "/tmp";
+  std::string base = dir + "/wire_frames-" + std::to_string(::getpid());
+  int failures = 0;
+  auto check = [&](bool ok, const std::string &what)
+  {
+    if (!ok)
+    {
+      fprintf(stderr, "FAIL %s\n", what.c_str());
+      ++failures;
+    }
+  };
+
+  // Frames of 1, 3, 0, 4097 and 70000 orders, concatenated
+  std::vector<Order> all;
+  std::string stream;
+  int next_id = 1;
+  for (int n : {1, 3, 0, 4097, 70000})
+  {
+    std::vector<Order> orders;
+    for (int i = 0; i < n; ++i)
+      orders.push_back(order(next_id++));
+    stream += order_frame(orders);
+    all.insert(all.end(), orders.begin(), orders.end());
+  }
+  const int total = static_cast<int>(all.size());
+
+  // The reference: the same orders through batch ingest
+  reset_system();
+  {
+    std::vector<int> ids;
+    std::vector<double> weights, distances;
+    std::vector<char> urgent;
+    std::vector<uint64_t> customers, destinations;
+    for (const Order &o : all)
+    {
+      ids.push_back(o.id);
+      weights.push_back(o.weight);
+      distances.push_back(o.distance);
+      urgent.push_back(o.urgent);
+      customers.push_back(o.customer);
+      destinations.push_back(o.destination);
+    }
+    add_orders_batch_ex(ids.data(), weights.data(), distances.data(), reinterpret_cast<const bool *>(urgent.data()),
+                        customers.data(), destinations.data(), total);
+  }
+  std::string want = decisions(0, total);
+  double want_customers = get_distinct_count(0, -1, 0), want_routes = get_distinct_count(1, -1, 0);
+
+  // Every decision carries the order's id, grid values and flags
+  std::vector<Decision> decided;
+  size_t frames = 0;
+  check(parse_decisions(want, decided, &frames) && decided.size() == all.size(), "decision frames parse");
+  check(frames == (all.size() + SEGMENT_ROWS - 1) / SEGMENT_ROWS, "one decision frame per segment");
+  for (size_t i = 0; i < decided.size() && i < all.size(); ++i)
+  {
+    const Order &o = all[i];
+    const Decision &d = decided[i];
+    int kind = get_order_kind(static_cast<int>(i));
+    uint32_t flags = (o.urgent ? URGENT_BIT : 0) | (kind == 0 && o.weight > 200.0 ? HEAVY_BIT : 0) |
+                     (kind == 1 ? RESERVED_BIT : 0) | (kind == 2 ? EXPRESS_BIT : 0);
+    if (d.id != o.id || d.weight_g != std::lround(o.weight * 1000) || d.distance_dam != std::lround(o.distance * 100) ||
+        (d.meta & KIND_MASK) != static_cast<uint32_t>(kind) ||
+        (d.meta & (URGENT_BIT | HEAVY_BIT | RESERVED_BIT | EXPRESS_BIT)) != flags)
+    {
+      check(false, "decision of order " + std::to_string(o.id));
+      break;
+    }
+  }
+  std::string part = decisions(4000, 200);
+  check(part == decisions(4000, 200) && !part.empty(), "a slice is repeatable");
+  std::vector<Decision> slice;
+  check(parse_decisions(part, slice) && slice.size() == 200 && slice[0].id == all[4000].id &&
+            slice[199].id == all[4199].id,
+        "a slice holds its orders");
+  check(decisions(total, 10).empty() && decisions(-1, 10).empty() && decisions(0, 0).empty(),
+        "no decisions outside the book");
+
+  // Decisions written to a file match the buffer, across segments
+  std::string written = base + ".decisions";
+  int fd = ::open(written.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  check(write_decision_frames(fd, 0, total) == static_cast<int64_t>(want.size()), "write_decision_frames size");
+  ::close(fd);
+  check(read_file(written) == want, "written decisions match");
+
+  // Frames from memory, unaligned; the book and decisions match the reference
+  auto same_book = [&](const std::string &what)
+  {
+    check(get_order_count() == total, what + ": order count");
+    std::vector<int> ids(static_cast<size_t>(total));
+    list_orders_where(0, 0, 0, ids.data(), total);
+    bool in_order = true;
+    for (int i = 0; i < total && in_order; ++i)
+      in_order = ids[i] == all[i].id;
+    check(in_order, what + ": orders in frame order");
+    check(decisions(0, total) == want, what + ": decisions match batch ingest");
+    check(get_distinct_count(0, -1, 0) == want_customers && get_distinct_count(1, -1, 0) == want_routes,
+          what + ": customers and routes match batch ingest");
+  };
+  reset_system();
+  std::string shifted = "x" + stream;
+  check(add_order_frames(shifted.data() + 1, static_cast<int64_t>(stream.size())) == total, "add_order_frames");
+  same_book("from memory");
+
+  // From a file and from a pipe fed by another thread
+  std::string path = base + ".orders";
+  write_file(path, stream);
+  reset_system();
+  fd = ::open(path.c_str(), O_RDONLY);
+  check(read_order_frames(fd) == total, "read_order_frames from a file");
+  ::close(fd);
+  same_book("from a file");
+
+  int pipe_fds[2];
+  check(::pipe(pipe_fds) == 0, "pipe");
+  std::thread writer([&]
+  {
+    for (size_t at = 0; at < stream.size();)
+    {
+      ssize_t n = ::write(pipe_fds[1], stream.data() + at, std::min<size_t>(stream.size() - at, 1000));
+      if (n <= 0)
+        break;
+      at += static_cast<size_t>(n);
+    }
+    ::close(pipe_fds[1]);
+  });
+  reset_system();
+  check(read_order_frames(pipe_fds[0]) == total, "read_order_frames from a pipe");
+  writer.join();
+  ::close(pipe_fds[0]);
+  same_book("from a pipe");
+
+  // Malformed frames: the frames before them stay, the call returns -1
+  std::vector<Order> three = {order(1), order(2), order(3)};
+  std::string good = order_frame(three);
+  std::string bad_magic = good, bad_urgent = good, bad_length = good, decision_type = good;
+  bad_magic[0] = 'X';
+  bad_urgent[sizeof(WireHeader) + 32 * 3 + padded(4 * 3) + 1] = 2;
+  bad_length[16] += 8;
+  decision_type[6] = DECISIONS;
+  const std::pair<std::string, std::string> damaged[] = {{"bad magic", bad_magic},
+                                                         {"urgent not 0 or 1", bad_urgent},
+                                                         {"body length off", bad_length},
+                                                         {"a decision frame", decision_type},
+                                                         {"a cut-off frame", good.substr(0, good.size() - 1)},
+                                                         {"a cut-off header", good.substr(0, 10)}};
+  for (const auto &d : damaged)
+  {
+    reset_system();
+    std::string data = good + d.second;
+    check(add_order_frames(data.data(), static_cast<int64_t>(data.size())) == -1, d.first + " in memory: -1");
+    check(get_order_count() == 3, d.first + " in memory: frames before it kept");
+    write_file(path, data);
+    reset_system();
+    fd = ::open(path.c_str(), O_RDONLY);
+    check(read_order_frames(fd) == -1, d.first + " in a file: -1");
+    ::close(fd);
+    check(get_order_count() == 3, d.first + " in a file: frames before it kept");
+  }
+  reset_system();
+  check(add_order_frames(nullptr, 0) == 0, "no frames: 0 orders");
+
+  ::unlink(path.c_str());
+  ::unlink(written.c_str());
+  reset_system();
+  if (failures)
+    return 1;
+  printf("wire frames: ok\n");
+  return 0;
+}
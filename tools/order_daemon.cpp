@@ -0,0 +1,64 @@
+// Order daemon: owns one order book and serves it over a Unix domain socket
+// to every process that calls connect_order_daemon(), e.g. each Flask
+// worker when LOGISTICS_DAEMON is set. Links against the library:
+//   g++ -std=c++17 -O3 tools/order_daemon.cpp -o order_daemon ./logistics.so
+// Usage: order_daemon SOCKET [JOURNAL] [RATE] [BURST]
+// With JOURNAL ("-" for none) every order is journaled there. RATE > 0
+// limits each client process to that many orders/s with bursts of BURST
+// (default RATE). Stops on SIGINT or SIGTERM.
+
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+struct AdmissionStats
+{
+  int64_t queued;
+  int64_t peak_queued;
+  int64_t admitted;
+  int64_t shed_overloaded;
+  int64_t shed_rate_limited;
+};
+
+extern "C" int run_order_daemon(const char *socket_path);
+extern "C" void stop_order_daemon();
+extern "C" int open_journal(const char *path, int backend);
+extern "C" int close_journal();
+extern "C" void set_admission(int64_t max_queued, double orders_per_sec, double burst);
+extern "C" void get_admission_stats(AdmissionStats *out);
+
+static void on_signal(int) { stop_order_daemon(); }
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s SOCKET [JOURNAL] [RATE] [BURST]\n", argv[0]);
+    return 2;
+  }
+  if (argc > 2 && strcmp(argv[2], "-") != 0 && open_journal(argv[2], 0) < 0)
+  {
+    fprintf(stderr, "cannot open journal %s\n", argv[2]);
+    return 1;
+  }
+  if (argc > 3)
+    set_admission(65536, atof(argv[3]), argc > 4 ? atof(argv[4]) : atof(argv[3]));
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  printf("serving the order book on %s\n", argv[1]);
+  fflush(stdout);
+  if (run_order_daemon(argv[1]) < 0)
+  {
+    fprintf(stderr, "cannot listen on %s\n", argv[1]);
+    return 1;
+  }
+  AdmissionStats admission{};
+  get_admission_stats(&admission);
+  if (admission.shed_overloaded || admission.shed_rate_limited)
+    printf("shed %lld over capacity (peak queue %lld), %lld rate limited\n",
+           static_cast<long long>(admission.shed_overloaded), static_cast<long long>(admission.peak_queued),
+           static_cast<long long>(admission.shed_rate_limited));
+  return close_journal() == 0 ? 0 : 1;
+}
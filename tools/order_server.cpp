@@ -0,0 +1,73 @@
+// Native HTTP/1.1 order service: POST /process_order with the same JSON
+// contract as Factory.py, served by one epoll loop per CPU. Links against
+// the library:
+//   g++ -std=c++17 -O3 tools/order_server.cpp -o order_server ./logistics.so
+// Usage: order_server [PORT] [THREADS] [JOURNAL] [BATCH_US] [BATCH_MAX] [RATE] [BURST]
+// THREADS 0 (the default) runs one pinned loop per CPU; with JOURNAL ("-"
+// for none) every order is journaled there. BATCH_US > 0 merges orders
+// from all loops arriving within that many microseconds, up to BATCH_MAX
+// (default 64), into one batch. RATE > 0 limits each client address to
+// that many orders/s with bursts of BURST (default RATE); the excess gets
+// 429, and 503 once the service holds too many orders. Stops on SIGINT or
+// SIGTERM.
+
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+struct AdmissionStats
+{
+  int64_t queued;
+  int64_t peak_queued;
+  int64_t admitted;
+  int64_t shed_overloaded;
+  int64_t shed_rate_limited;
+};
+
+extern "C" int run_order_server(int port, int threads);
+extern "C" void stop_order_server();
+extern "C" int open_journal(const char *path, int backend);
+extern "C" int close_journal();
+extern "C" void set_micro_batch(int64_t window_us, int max_orders);
+extern "C" void get_micro_batch_stats(int64_t *batches, int64_t *orders);
+extern "C" void set_admission(int64_t max_queued, double orders_per_sec, double burst);
+extern "C" void get_admission_stats(AdmissionStats *out);
+
+static void on_signal(int) { stop_order_server(); }
+
+int main(int argc, char **argv)
+{
+  int port = argc > 1 ? atoi(argv[1]) : 8080;
+  int threads = argc > 2 ? atoi(argv[2]) : 0;
+  if (argc > 3 && strcmp(argv[3], "-") != 0 && open_journal(argv[3], 0) < 0)
+  {
+    fprintf(stderr, "cannot open journal %s\n", argv[3]);
+    return 1;
+  }
+  if (argc > 4)
+    set_micro_batch(atoll(argv[4]), argc > 5 ? atoi(argv[5]) : 64);
+  if (argc > 6)
+    set_admission(65536, atof(argv[6]), argc > 7 ? atof(argv[7]) : atof(argv[6]));
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  printf("serving POST /process_order on port %d\n", port);
+  fflush(stdout);
+  if (run_order_server(port, threads) < 0)
+  {
+    fprintf(stderr, "cannot listen on port %d\n", port);
+    return 1;
+  }
+  int64_t batches = 0, orders = 0;
+  get_micro_batch_stats(&batches, &orders);
+  if (batches)
+    printf("%lld orders in %lld batches\n", static_cast<long long>(orders), static_cast<long long>(batches));
+  AdmissionStats admission{};
+  get_admission_stats(&admission);
+  if (admission.shed_overloaded || admission.shed_rate_limited)
+    printf("shed %lld over capacity (peak queue %lld), %lld rate limited\n",
+           static_cast<long long>(admission.shed_overloaded), static_cast<long long>(admission.peak_queued),
+           static_cast<long long>(admission.shed_rate_limited));
+  return close_journal() == 0 ? 0 : 1;
+}
@@ -0,0 +1,36 @@
+// Sorts an order file (see export_orders) by ETA, then distance, in bounded
+// memory. Links against the library:
+//   g++ -std=c++17 -O3 tools/sort_orders.cpp -o sort_orders ./logistics.so
+// Usage: sort_orders IN OUT [TMP_DIR] [MEMORY_MB] [THREADS]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+extern "C" int64_t sort_order_file(const char *in_path, const char *out_path, const char *tmp_dir, int64_t memory_mb,
+                                   int threads);
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    fprintf(stderr, "usage: %s IN OUT [TMP_DIR] [MEMORY_MB] [THREADS]\n", argv[0]);
+    return 2;
+  }
+  const char *tmp_dir = argc > 3 ? argv[3] : ".";
+  int64_t memory_mb = argc > 4 ? atoll(argv[4]) : 1024;
+  int threads = argc > 5 ? atoi(argv[5]) : 0;
+
+  auto start = std::chrono::steady_clock::now();
+  int64_t rows = sort_order_file(argv[1], argv[2], tmp_dir, memory_mb, threads);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (rows < 0)
+  {
+    fprintf(stderr, "sort failed: cannot read %s or write %s / %s\n", argv[1], argv[2], tmp_dir);
+    return 1;
+  }
+  printf("%lld orders sorted in %.2f s (%.1f M orders/s)\n", static_cast<long long>(rows), seconds,
+         seconds > 0 ? rows / seconds / 1e6 : 0.0);
+  return 0;
+}